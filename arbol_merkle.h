@@ -0,0 +1,202 @@
+// Digest en arbol (Merkle) para archivos grandes (--digest=merkle).
+// El SHA-256 de un archivo es secuencial: un archivo grande ocupa un solo
+// nucleo. Con el arbol el archivo se parte en trozos de tamano fijo, cada
+// trozo tiene su hoja SHA-256(0x00 || trozo) y cada nodo es
+// SHA-256(0x01 || izquierdo || derecho); un nivel impar sube su ultimo nodo
+// sin hashear. Las hojas se calculan en paralelo y al validar se sabe que
+// trozo esta danado. Los prefijos separan las hojas de los nodos (como en
+// RFC 6962): un trozo de 65 bytes 0x01 || L || R no pasa por un nodo.
+//
+// Formato del .sha (texto, una linea por digest):
+//   sha256-merkle <trozo> <tamano> <numTrozos>
+//   <raiz en hex>
+//   <hoja 0 en hex>
+//   ...
+// El .sha plano de siempre (64 digitos hex) sigue siendo el por defecto;
+// parsearSha() reconoce los dos.
+#ifndef ARBOL_MERKLE_H
+#define ARBOL_MERKLE_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <stdint.h>
+#include "sha256.h"
+#include "sha256_multibuffer.h"
+
+static const char* const CABECERA_SHA_MERKLE = "sha256-merkle";
+static const uint8_t PREFIJO_HOJA_MERKLE = 0x00;
+// Cabecera mas larga posible: nombre + tres numeros de 20 digitos
+static const size_t TAM_CABECERA_SHA_MERKLE = 80;
+
+enum FormatoDigest {
+    DIGEST_PLANO,       // un SHA-256 del archivo entero (por defecto)
+    DIGEST_MERKLE       // arbol de SHA-256 por trozo
+};
+
+static inline const char* nombreFormatoDigest(FormatoDigest formato) {
+    return formato == DIGEST_MERKLE ? "merkle" : "plano";
+}
+
+static inline bool parsearFormatoDigest(const std::string& nombre, FormatoDigest& formato) {
+    if (nombre == "plano") formato = DIGEST_PLANO;
+    else if (nombre == "merkle") formato = DIGEST_MERKLE;
+    else return false;
+    return true;
+}
+
+// Un archivo vacio tiene un trozo vacio
+static inline size_t numTrozosMerkle(unsigned long long tamano, size_t trozo) {
+    return tamano == 0 ? 1 : static_cast<size_t>((tamano + trozo - 1) / trozo);
+}
+
+static inline void nodoMerkle(const uint8_t izquierdo[32], const uint8_t derecho[32], uint8_t destino[32]) {
+    static const uint8_t PREFIJO_NODO = 0x01;
+    Sha256 ctx;
+    ctx.update(&PREFIJO_NODO, 1);
+    ctx.update(izquierdo, 32);
+    ctx.update(derecho, 32);
+    ctx.final(destino);
+}
+
+// Raiz de `n` hojas de 32 bytes. Usa `nodos` como espacio de trabajo: lo
+// sobrescribe nivel a nivel (el nodo i se arma con 2i y 2i+1, que ya se
+// leyeron), asi no hace falta memoria extra.
+static inline void raizMerkle(uint8_t* nodos, size_t n, uint8_t raiz[32]) {
+    while (n > 1) {
+        size_t padres = 0;
+        for (size_t i = 0; i + 1 < n; i += 2) {
+            nodoMerkle(nodos + 32 * i, nodos + 32 * (i + 1), nodos + 32 * padres++);
+        }
+        if (n % 2 != 0) {
+            memmove(nodos + 32 * padres++, nodos + 32 * (n - 1), 32);
+        }
+        n = padres;
+    }
+    memcpy(raiz, nodos, 32);
+}
+
+static inline void hojaMerkle(const char* datos, size_t n, uint8_t hoja[32]) {
+    Sha256 ctx;
+    ctx.update(&PREFIJO_HOJA_MERKLE, 1);
+    ctx.update(datos, n);
+    ctx.final(hoja);
+}
+
+// Encola el hash de cada trozo de `datos` en el planificador multi-buffer:
+// las hojas de un archivo (y las de varios) se calculan juntas
+static inline void agregarHojasMerkle(PlanificadorHashes& planificador, const char* datos, size_t tamano,
+                                      size_t trozo, uint8_t* hojas) {
+    const size_t n = numTrozosMerkle(tamano, trozo);
+    for (size_t i = 0; i < n; ++i) {
+        size_t inicio = i * trozo;
+        size_t largo = tamano - inicio < trozo ? tamano - inicio : trozo;
+        planificador.agregar(datos + inicio, largo, hojas + 32 * i, PREFIJO_HOJA_MERKLE);
+    }
+}
+
+// Primer trozo cuya hoja difiere, o `n` si son todas iguales
+static inline size_t primerTrozoDistinto(const uint8_t* hojas, const uint8_t* esperadas, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (memcmp(hojas + 32 * i, esperadas + 32 * i, 32) != 0) return i;
+    }
+    return n;
+}
+
+// Bytes del .sha de un arbol de `numTrozos` hojas (cota superior)
+static inline size_t tamanoShaMerkle(size_t numTrozos) {
+    return TAM_CABECERA_SHA_MERKLE + 65 * (numTrozos + 1);
+}
+
+// Arma el .sha en `destino` (tamanoShaMerkle bytes); devuelve los usados
+static inline size_t escribirShaMerkle(char* destino, size_t trozo, unsigned long long tamano,
+                                       const uint8_t raiz[32], const uint8_t* hojas, size_t numTrozos) {
+    int largo = snprintf(destino, TAM_CABECERA_SHA_MERKLE, "%s %llu %llu %llu\n", CABECERA_SHA_MERKLE,
+                         static_cast<unsigned long long>(trozo), tamano,
+                         static_cast<unsigned long long>(numTrozos));
+    char* p = destino + largo;
+    char hex[65];
+    digestAHex(raiz, hex);
+    memcpy(p, hex, 64);
+    p[64] = '\n';
+    p += 65;
+    for (size_t i = 0; i < numTrozos; ++i) {
+        digestAHex(hojas + 32 * i, hex);
+        memcpy(p, hex, 64);
+        p[64] = '\n';
+        p += 65;
+    }
+    return static_cast<size_t>(p - destino);
+}
+
+// .sha leido, en cualquiera de los dos formatos. Las hojas quedan como
+// texto (apuntan al buffer leido) y se convierten con hojasSha().
+struct ShaLeido {
+    FormatoDigest formato;
+    uint8_t raiz[32];               // el digest plano o la raiz del arbol
+    size_t trozo;                   // solo merkle
+    unsigned long long tamano;
+    size_t numTrozos;
+    const char* hojasHex;           // 65 bytes por hoja (64 hex + '\n')
+};
+
+static inline bool leerDecimalSha(const char*& p, const char* fin, unsigned long long& valor) {
+    const char* inicio = p;
+    valor = 0;
+    while (p < fin && *p >= '0' && *p <= '9') {
+        valor = valor * 10 + static_cast<unsigned>(*p - '0');
+        ++p;
+    }
+    return p != inicio && p - inicio <= 19;
+}
+
+// Reconoce el formato y valida la estructura (no los digests contra datos)
+static inline bool parsearSha(const char* texto, size_t longitud, ShaLeido& sha) {
+    const size_t largoCabecera = strlen(CABECERA_SHA_MERKLE);
+    memset(sha.raiz, 0, sizeof(sha.raiz));
+    if (longitud < largoCabecera || memcmp(texto, CABECERA_SHA_MERKLE, largoCabecera) != 0) {
+        sha.formato = DIGEST_PLANO;
+        sha.trozo = 0;
+        sha.tamano = 0;
+        sha.numTrozos = 0;
+        sha.hojasHex = NULL;
+        return hexADigest(texto, longitud, sha.raiz);
+    }
+    sha.formato = DIGEST_MERKLE;
+    const char* p = texto + largoCabecera;
+    const char* fin = texto + longitud;
+    unsigned long long trozo = 0, numTrozos = 0;
+    if (p >= fin || *p++ != ' ' || !leerDecimalSha(p, fin, trozo) || p >= fin || *p++ != ' ' ||
+        !leerDecimalSha(p, fin, sha.tamano) || p >= fin || *p++ != ' ' || !leerDecimalSha(p, fin, numTrozos) ||
+        p >= fin || *p++ != '\n' || trozo == 0) {
+        return false;
+    }
+    sha.trozo = static_cast<size_t>(trozo);
+    sha.numTrozos = static_cast<size_t>(numTrozos);
+    if (numTrozos != numTrozosMerkle(sha.tamano, sha.trozo) ||
+        static_cast<size_t>(fin - p) / 65 < sha.numTrozos + 1 || !hexADigest(p, 64, sha.raiz)) {
+        return false;
+    }
+    sha.hojasHex = p + 65;
+    return true;
+}
+
+// Convierte las hojas del .sha a binario (32 * numTrozos bytes)
+static inline bool hojasSha(const ShaLeido& sha, uint8_t* hojas) {
+    for (size_t i = 0; i < sha.numTrozos; ++i) {
+        if (!hexADigest(sha.hojasHex + 65 * i, 64, hojas + 32 * i)) return false;
+    }
+    return true;
+}
+
+// "trozo 3 (bytes 786432-1048575)"
+static inline std::string describirTrozoMerkle(size_t indice, size_t trozo, unsigned long long tamano) {
+    unsigned long long inicio = static_cast<unsigned long long>(indice) * trozo;
+    unsigned long long fin = inicio + trozo < tamano ? inicio + trozo : tamano;
+    char texto[96];
+    snprintf(texto, sizeof(texto), "trozo %llu (bytes %llu-%llu)", static_cast<unsigned long long>(indice), inicio,
+             fin > inicio ? fin - 1 : inicio);
+    return texto;
+}
+
+#endif
@@ -0,0 +1,189 @@
+// Lectura de archivos por mapeo en memoria (mmap / MapViewOfFile).
+// El cifrado trabaja sobre las paginas mapeadas (copia privada o mapeo
+// compartido que escribe al archivo) y el hash y la comparacion leen esas
+// paginas directamente: sin el vector intermedio ni la copia de read().
+// Compartido por main_pro.cpp y main_simple.cpp.
+#ifndef ARCHIVO_MAPEADO_H
+#define ARCHIVO_MAPEADO_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Forma de leer los archivos en una ejecucion
+enum ModoLectura {
+    LECTURA_STREAM,         // ifstream + vector/string (camino original)
+    LECTURA_MMAP,           // mapeo prepoblado (MAP_POPULATE) y secuencial
+    LECTURA_MMAP_PEREZOSO   // mapeo sin prepoblar: fallos de pagina al leer
+};
+
+static inline const char* nombreModoLectura(ModoLectura modo) {
+    switch (modo) {
+        case LECTURA_MMAP: return "mmap";
+        case LECTURA_MMAP_PEREZOSO: return "mmap-perezoso";
+        default: return "stream";
+    }
+}
+
+// Acepta los nombres de nombreModoLectura(); false si no lo reconoce
+static inline bool parsearModoLectura(const std::string& nombre, ModoLectura& modo) {
+    if (nombre == "stream") modo = LECTURA_STREAM;
+    else if (nombre == "mmap") modo = LECTURA_MMAP;
+    else if (nombre == "mmap-perezoso") modo = LECTURA_MMAP_PEREZOSO;
+    else return false;
+    return true;
+}
+
+enum AccesoMapeo {
+    MAPEO_LECTURA,          // solo lectura
+    MAPEO_COPIA_PRIVADA,    // escribible, los cambios no llegan al archivo
+    MAPEO_COMPARTIDO        // escribible, los cambios se escriben al archivo
+};
+
+class ArchivoMapeado {
+public:
+    ArchivoMapeado() : base(NULL), longitud(0) {}
+
+    ArchivoMapeado(const std::string& nombre, AccesoMapeo acceso, ModoLectura modo = LECTURA_MMAP)
+        : base(NULL), longitud(0) {
+        abrir(nombre, acceso, modo);
+    }
+
+    ArchivoMapeado(ArchivoMapeado&& otro) noexcept : base(otro.base), longitud(otro.longitud) {
+        otro.base = NULL;
+        otro.longitud = 0;
+    }
+
+    ArchivoMapeado& operator=(ArchivoMapeado&& otro) noexcept {
+        if (this != &otro) {
+            cerrar();
+            base = otro.base;
+            longitud = otro.longitud;
+            otro.base = NULL;
+            otro.longitud = 0;
+        }
+        return *this;
+    }
+
+    ~ArchivoMapeado() {
+        cerrar();
+    }
+
+    // Un archivo vacio queda abierto con datos() == NULL y tamano() == 0
+    void abrir(const std::string& nombre, AccesoMapeo acceso, ModoLectura modo = LECTURA_MMAP) {
+        abrir(nombre.c_str(), acceso, modo);
+    }
+
+    void abrir(const char* nombre, AccesoMapeo acceso, ModoLectura modo = LECTURA_MMAP) {
+        cerrar();
+#ifdef _WIN32
+        // En Windows no hay equivalente directo de MAP_POPULATE/madvise: el
+        // modo solo afecta al camino POSIX
+        (void)modo;
+        DWORD accesoArchivo = (acceso == MAPEO_COMPARTIDO) ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+        HANDLE archivo = CreateFileA(nombre, accesoArchivo, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                     NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (archivo == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error(std::string("No se pudo abrir el archivo: ") + nombre);
+        }
+        LARGE_INTEGER tam;
+        if (!GetFileSizeEx(archivo, &tam)) {
+            CloseHandle(archivo);
+            throw std::runtime_error(std::string("No se pudo leer el tamano de: ") + nombre);
+        }
+        if (tam.QuadPart == 0) {
+            CloseHandle(archivo);
+            return;
+        }
+        DWORD proteccion = PAGE_READONLY;
+        DWORD vista = FILE_MAP_READ;
+        if (acceso == MAPEO_COPIA_PRIVADA) {
+            proteccion = PAGE_WRITECOPY;
+            vista = FILE_MAP_COPY;
+        } else if (acceso == MAPEO_COMPARTIDO) {
+            proteccion = PAGE_READWRITE;
+            vista = FILE_MAP_WRITE;
+        }
+        HANDLE mapeo = CreateFileMappingA(archivo, NULL, proteccion, 0, 0, NULL);
+        CloseHandle(archivo);
+        if (mapeo == NULL) {
+            throw std::runtime_error(std::string("No se pudo mapear el archivo: ") + nombre);
+        }
+        void* p = MapViewOfFile(mapeo, vista, 0, 0, 0);
+        CloseHandle(mapeo);
+        if (p == NULL) {
+            throw std::runtime_error(std::string("No se pudo mapear el archivo: ") + nombre);
+        }
+        base = static_cast<char*>(p);
+        longitud = static_cast<size_t>(tam.QuadPart);
+#else
+        int fd = ::open(nombre, acceso == MAPEO_COMPARTIDO ? O_RDWR : O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("No se pudo abrir el archivo: ") + nombre);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error(std::string("No se pudo leer el tamano de: ") + nombre);
+        }
+        if (st.st_size == 0) {
+            ::close(fd);
+            return;
+        }
+        int proteccion = (acceso == MAPEO_LECTURA) ? PROT_READ : (PROT_READ | PROT_WRITE);
+        int flags = (acceso == MAPEO_COMPARTIDO) ? MAP_SHARED : MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        if (modo == LECTURA_MMAP) flags |= MAP_POPULATE;
+#endif
+        void* p = mmap(NULL, static_cast<size_t>(st.st_size), proteccion, flags, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error(std::string("No se pudo mapear el archivo: ") + nombre);
+        }
+        base = static_cast<char*>(p);
+        longitud = static_cast<size_t>(st.st_size);
+        if (modo == LECTURA_MMAP) {
+            // Lectura anticipada agresiva: las fases recorren todo en orden
+            madvise(base, longitud, MADV_SEQUENTIAL);
+        }
+#endif
+    }
+
+    void cerrar() {
+        if (base != NULL) {
+#ifdef _WIN32
+            UnmapViewOfFile(base);
+#else
+            munmap(base, longitud);
+#endif
+        }
+        base = NULL;
+        longitud = 0;
+    }
+
+    char* datos() const {
+        return base;
+    }
+
+    size_t tamano() const {
+        return longitud;
+    }
+
+private:
+    char* base;
+    size_t longitud;
+
+    ArchivoMapeado(const ArchivoMapeado&);
+    ArchivoMapeado& operator=(const ArchivoMapeado&);
+};
+
+#endif
@@ -0,0 +1,114 @@
+// Arena lineal (bump allocator) para los objetos temporales de cada archivo.
+// Cada hilo del pool tiene una: reservar() solo avanza un puntero y
+// reiniciar() la vacia de golpe al terminar el archivo. Si en una vuelta
+// no alcanza el bloque, lo que falta se pide en bloques de desborde y en
+// el siguiente reiniciar() el bloque principal crece hasta el pico visto,
+// asi despues del primer archivo el bucle ya no toca el heap. El bloque
+// principal es el buffer de trabajo del hilo (llega al doble del archivo):
+// con paginas grandes activas va en un BloqueGrande de paginas de 2 MB.
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "paginas_grandes.h"
+
+class ArenaLineal {
+public:
+    static const size_t ALINEACION_POR_DEFECTO = 64;     // linea de cache
+
+    ArenaLineal() : bloque(NULL), capacidad(0), usado(0), demanda(0), desbordes(NULL), crecimientos(0) {}
+
+    ~ArenaLineal() {
+        liberarDesbordes();
+        liberarBloque();
+    }
+
+    // `alineacion` debe ser potencia de 2
+    void* reservar(size_t bytes, size_t alineacion = ALINEACION_POR_DEFECTO) {
+        demanda += bytes + alineacion;
+        if (bloque != NULL) {
+            uintptr_t base = reinterpret_cast<uintptr_t>(bloque);
+            uintptr_t p = (base + usado + alineacion - 1) & ~static_cast<uintptr_t>(alineacion - 1);
+            size_t fin = static_cast<size_t>(p - base) + bytes;
+            if (fin <= capacidad) {
+                usado = fin;
+                return reinterpret_cast<void*>(p);
+            }
+        }
+        return reservarDesborde(bytes, alineacion);
+    }
+
+    char* reservarChars(size_t bytes) {
+        return static_cast<char*>(reservar(bytes));
+    }
+
+    // Libera todo lo reservado desde el ultimo reiniciar()
+    void reiniciar() {
+        if (desbordes != NULL) {
+            liberarDesbordes();
+            // Crecer hasta cubrir toda la demanda de esta vuelta
+            liberarBloque();
+            capacidad = demanda;
+            bloque = usarPaginasGrandes(capacidad) ? grande.reservar(capacidad)
+                                                   : static_cast<char*>(::operator new(capacidad));
+            ++crecimientos;
+        }
+        usado = 0;
+        demanda = 0;
+    }
+
+    size_t capacidadBloque() const {
+        return capacidad;
+    }
+
+    // Veces que el bloque principal tuvo que crecer
+    unsigned numCrecimientos() const {
+        return crecimientos;
+    }
+
+private:
+    struct Desborde {
+        Desborde* anterior;
+    };
+
+    void* reservarDesborde(size_t bytes, size_t alineacion) {
+        size_t total = sizeof(Desborde) + alineacion + bytes;
+        char* memoria = static_cast<char*>(::operator new(total));
+        Desborde* d = reinterpret_cast<Desborde*>(memoria);
+        d->anterior = desbordes;
+        desbordes = d;
+        uintptr_t p = reinterpret_cast<uintptr_t>(memoria + sizeof(Desborde));
+        p = (p + alineacion - 1) & ~static_cast<uintptr_t>(alineacion - 1);
+        return reinterpret_cast<void*>(p);
+    }
+
+    void liberarBloque() {
+        if (bloque != grande.datos()) ::operator delete(bloque);
+        grande.liberar();
+        bloque = NULL;
+    }
+
+    void liberarDesbordes() {
+        while (desbordes != NULL) {
+            Desborde* anterior = desbordes->anterior;
+            ::operator delete(desbordes);
+            desbordes = anterior;
+        }
+    }
+
+    char* bloque;
+    BloqueGrande grande;    // dueno del bloque si se pidio con paginas grandes
+    size_t capacidad;
+    size_t usado;
+    size_t demanda;         // bytes pedidos en esta vuelta (con alineacion)
+    Desborde* desbordes;
+    unsigned crecimientos;
+
+    ArenaLineal(const ArenaLineal&);
+    ArenaLineal& operator=(const ArenaLineal&);
+};
+
+#endif
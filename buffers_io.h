@@ -0,0 +1,132 @@
+// Buffers de I/O por hilo.
+// Cada hilo tiene su propio buffer, alineado a 2 MB (candidato a pagina
+// grande con MADV_HUGEPAGE) y reutilizado en todos sus archivos: ya no hay
+// un arreglo estatico compartido que varios hilos instalan a la vez en sus
+// streams. El tamano es configurable y se cuentan los usos (buffer ya
+// reservado) y las reservas nuevas para comprobar que se reutilizan. Con
+// paginas grandes activas (paginas_grandes.h) el buffer va en paginas de
+// 2 MB desde el principio en vez de pedirlas con madvise.
+// Compartido por main_pro.cpp y main_simple.cpp.
+#ifndef BUFFERS_IO_H
+#define BUFFERS_IO_H
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "paginas_grandes.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+static const size_t TAMANO_BUFFER_IO_POR_DEFECTO = 8 * 1024 * 1024;
+static const size_t ALINEACION_BUFFER_IO = 2 * 1024 * 1024;
+// El tamano se redondea a esta granularidad (requisito de O_DIRECT)
+static const size_t GRANULARIDAD_BUFFER_IO = 4096;
+
+struct EstadisticasBuffersIo {
+    unsigned long long usos;        // pedidos servidos con el buffer del hilo
+    unsigned long long reservas;    // buffers nuevos (primer uso o cambio de tamano)
+    unsigned long long bytesReservados;
+};
+
+static inline std::atomic<size_t>& tamanoBufferIoConfigurado() {
+    static std::atomic<size_t> tamano(TAMANO_BUFFER_IO_POR_DEFECTO);
+    return tamano;
+}
+
+static inline size_t tamanoBufferIo() {
+    return tamanoBufferIoConfigurado().load();
+}
+
+// Los hilos que ya tienen buffer lo cambian en su siguiente uso
+static inline void configurarTamanoBufferIo(size_t bytes) {
+    size_t redondeado = (bytes + GRANULARIDAD_BUFFER_IO - 1) / GRANULARIDAD_BUFFER_IO * GRANULARIDAD_BUFFER_IO;
+    tamanoBufferIoConfigurado() = redondeado > 0 ? redondeado : GRANULARIDAD_BUFFER_IO;
+}
+
+static inline std::atomic<unsigned long long>* contadoresBuffersIo() {
+    static std::atomic<unsigned long long> contadores[3];
+    return contadores;
+}
+
+static inline EstadisticasBuffersIo estadisticasBuffersIo() {
+    EstadisticasBuffersIo e;
+    e.usos = contadoresBuffersIo()[0].load();
+    e.reservas = contadoresBuffersIo()[1].load();
+    e.bytesReservados = contadoresBuffersIo()[2].load();
+    return e;
+}
+
+static inline void reiniciarEstadisticasBuffersIo() {
+    for (int i = 0; i < 3; ++i) {
+        contadoresBuffersIo()[i] = 0;
+    }
+}
+
+static inline char* reservarBufferIo(size_t tamano) {
+#ifdef _WIN32
+    void* p = _aligned_malloc(tamano, ALINEACION_BUFFER_IO);
+    if (p == NULL) throw std::bad_alloc();
+#else
+    void* p = NULL;
+    if (posix_memalign(&p, ALINEACION_BUFFER_IO, tamano) != 0) throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+    // Pedir paginas grandes transparentes (si THP esta en modo madvise)
+    if (tamano >= ALINEACION_BUFFER_IO) madvise(p, tamano, MADV_HUGEPAGE);
+#endif
+#endif
+    return static_cast<char*>(p);
+}
+
+static inline void liberarBufferIo(char* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+// Dueno del buffer de un hilo: se libera cuando el hilo termina
+struct BufferIoHilo {
+    char* datos;
+    size_t tamano;
+    BloqueGrande grande;    // el bloque de datos si se pidio con paginas grandes
+
+    BufferIoHilo() : datos(NULL), tamano(0) {}
+    ~BufferIoHilo() {
+        liberar();
+    }
+
+    void reservar(size_t bytes) {
+        liberar();
+        datos = usarPaginasGrandes(bytes) ? grande.reservar(bytes) : reservarBufferIo(bytes);
+        tamano = bytes;
+    }
+
+    void liberar() {
+        if (datos != NULL && datos != grande.datos()) liberarBufferIo(datos);
+        grande.liberar();
+        datos = NULL;
+    }
+};
+
+// Buffer de I/O del hilo actual, de tamanoBufferIo() bytes. No debe
+// usarse para dos operaciones anidadas en el mismo hilo.
+static inline char* bufferIoDelHilo() {
+    static thread_local BufferIoHilo buffer;
+    size_t tamano = tamanoBufferIo();
+    if (buffer.datos != NULL && buffer.tamano == tamano) {
+        contadoresBuffersIo()[0]++;
+        return buffer.datos;
+    }
+    buffer.reservar(tamano);
+    contadoresBuffersIo()[1]++;
+    contadoresBuffersIo()[2] += tamano;
+    return buffer.datos;
+}
+
+#endif
@@ -0,0 +1,133 @@
+// Rutas escalares del cifrado (letras +3 mod 26, digitos 9-d): referencia
+// para verificar los kernels SIMD de cifrado_simd.h y fallback cuando el CPU
+// no tiene SSE2/AVX2/AVX-512. Cada programa usa la suya:
+//   - main_simple.cpp: encriptarEscalar, con ramas por clase de caracter
+//   - main_pro.cpp: encriptarInPlaceEscalar, una tabla de 256 bytes
+// Estan aca (y no en cada programa) para que microbench.cpp mida las mismas
+// funciones.
+#ifndef CIFRADO_ESCALAR_H
+#define CIFRADO_ESCALAR_H
+
+#include <cstddef>
+
+// Tablas por clase de caracter (indice = c - 'a', c - 'A', c - '0')
+static const char TABLA_ENCRIPT_LOWER[26] = {
+    'd','e','f','g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v','w','x','y','z','a','b','c'
+};
+static const char TABLA_ENCRIPT_UPPER[26] = {
+    'D','E','F','G','H','I','J','K','L','M','N','O','P','Q','R','S','T','U','V','W','X','Y','Z','A','B','C'
+};
+static const char TABLA_ENCRIPT_DIGITS[10] = {'9','8','7','6','5','4','3','2','1','0'};
+
+static const char TABLA_DECRYPT_LOWER[26] = {
+    'x','y','z','a','b','c','d','e','f','g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v','w'
+};
+static const char TABLA_DECRYPT_UPPER[26] = {
+    'X','Y','Z','A','B','C','D','E','F','G','H','I','J','K','L','M','N','O','P','Q','R','S','T','U','V','W'
+};
+static const char TABLA_DECRYPT_DIGITS[10] = {'9','8','7','6','5','4','3','2','1','0'};
+
+// Tablas de 256 bytes (indice = byte sin signo)
+static const char TABLA_ENCRIPT_BYTE[256] = {
+    '\x00','\x01','\x02','\x03','\x04','\x05','\x06','\x07','\x08','\x09','\x0A','\x0B','\x0C','\x0D','\x0E','\x0F',
+    '\x10','\x11','\x12','\x13','\x14','\x15','\x16','\x17','\x18','\x19','\x1A','\x1B','\x1C','\x1D','\x1E','\x1F',
+    '\x20','\x21','\x22','\x23','\x24','\x25','\x26','\x27','\x28','\x29','\x2A','\x2B','\x2C','\x2D','\x2E','\x2F',
+    '9','8','7','6','5','4','3','2','1','0',
+    '\x3A','\x3B','\x3C','\x3D','\x3E','\x3F','\x40',
+    'D','E','F','G','H','I','J','K','L','M','N','O','P','Q','R','S','T','U','V','W','X','Y','Z','A','B','C',
+    '\x5B','\x5C','\x5D','\x5E','\x5F','\x60',
+    'd','e','f','g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v','w','x','y','z','a','b','c',
+    '\x7B','\x7C','\x7D','\x7E','\x7F','\x80','\x81','\x82','\x83','\x84','\x85','\x86','\x87','\x88','\x89','\x8A','\x8B','\x8C','\x8D','\x8E','\x8F',
+    '\x90','\x91','\x92','\x93','\x94','\x95','\x96','\x97','\x98','\x99','\x9A','\x9B','\x9C','\x9D','\x9E','\x9F',
+    '\xA0','\xA1','\xA2','\xA3','\xA4','\xA5','\xA6','\xA7','\xA8','\xA9','\xAA','\xAB','\xAC','\xAD','\xAE','\xAF',
+    '\xB0','\xB1','\xB2','\xB3','\xB4','\xB5','\xB6','\xB7','\xB8','\xB9','\xBA','\xBB','\xBC','\xBD','\xBE','\xBF',
+    '\xC0','\xC1','\xC2','\xC3','\xC4','\xC5','\xC6','\xC7','\xC8','\xC9','\xCA','\xCB','\xCC','\xCD','\xCE','\xCF',
+    '\xD0','\xD1','\xD2','\xD3','\xD4','\xD5','\xD6','\xD7','\xD8','\xD9','\xDA','\xDB','\xDC','\xDD','\xDE','\xDF',
+    '\xE0','\xE1','\xE2','\xE3','\xE4','\xE5','\xE6','\xE7','\xE8','\xE9','\xEA','\xEB','\xEC','\xED','\xEE','\xEF',
+    '\xF0','\xF1','\xF2','\xF3','\xF4','\xF5','\xF6','\xF7','\xF8','\xF9','\xFA','\xFB','\xFC','\xFD','\xFE','\xFF'
+};
+
+static const char TABLA_DECRYPT_BYTE[256] = {
+    '\x00','\x01','\x02','\x03','\x04','\x05','\x06','\x07','\x08','\x09','\x0A','\x0B','\x0C','\x0D','\x0E','\x0F',
+    '\x10','\x11','\x12','\x13','\x14','\x15','\x16','\x17','\x18','\x19','\x1A','\x1B','\x1C','\x1D','\x1E','\x1F',
+    '\x20','\x21','\x22','\x23','\x24','\x25','\x26','\x27','\x28','\x29','\x2A','\x2B','\x2C','\x2D','\x2E','\x2F',
+    '9','8','7','6','5','4','3','2','1','0',
+    '\x3A','\x3B','\x3C','\x3D','\x3E','\x3F','\x40',
+    'X','Y','Z','A','B','C','D','E','F','G','H','I','J','K','L','M','N','O','P','Q','R','S','T','U','V','W',
+    '\x5B','\x5C','\x5D','\x5E','\x5F','\x60',
+    'x','y','z','a','b','c','d','e','f','g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v','w',
+    '\x7B','\x7C','\x7D','\x7E','\x7F','\x80','\x81','\x82','\x83','\x84','\x85','\x86','\x87','\x88','\x89','\x8A','\x8B','\x8C','\x8D','\x8E','\x8F',
+    '\x90','\x91','\x92','\x93','\x94','\x95','\x96','\x97','\x98','\x99','\x9A','\x9B','\x9C','\x9D','\x9E','\x9F',
+    '\xA0','\xA1','\xA2','\xA3','\xA4','\xA5','\xA6','\xA7','\xA8','\xA9','\xAA','\xAB','\xAC','\xAD','\xAE','\xAF',
+    '\xB0','\xB1','\xB2','\xB3','\xB4','\xB5','\xB6','\xB7','\xB8','\xB9','\xBA','\xBB','\xBC','\xBD','\xBE','\xBF',
+    '\xC0','\xC1','\xC2','\xC3','\xC4','\xC5','\xC6','\xC7','\xC8','\xC9','\xCA','\xCB','\xCC','\xCD','\xCE','\xCF',
+    '\xD0','\xD1','\xD2','\xD3','\xD4','\xD5','\xD6','\xD7','\xD8','\xD9','\xDA','\xDB','\xDC','\xDD','\xDE','\xDF',
+    '\xE0','\xE1','\xE2','\xE3','\xE4','\xE5','\xE6','\xE7','\xE8','\xE9','\xEA','\xEB','\xEC','\xED','\xEE','\xEF',
+    '\xF0','\xF1','\xF2','\xF3','\xF4','\xF5','\xF6','\xF7','\xF8','\xF9','\xFA','\xFB','\xFC','\xFD','\xFE','\xFF'
+};
+
+// Con ramas: solo toca letras y digitos
+static inline void encriptarEscalar(char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        const char c = data[i];
+        if (c >= 'a' && c <= 'z') {
+            data[i] = TABLA_ENCRIPT_LOWER[c - 'a'];
+        } else if (c >= 'A' && c <= 'Z') {
+            data[i] = TABLA_ENCRIPT_UPPER[c - 'A'];
+        } else if (c >= '0' && c <= '9') {
+            data[i] = TABLA_ENCRIPT_DIGITS[c - '0'];
+        }
+    }
+}
+
+static inline void desencriptarEscalar(char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        const char c = data[i];
+        if (c >= 'a' && c <= 'z') {
+            data[i] = TABLA_DECRYPT_LOWER[c - 'a'];
+        } else if (c >= 'A' && c <= 'Z') {
+            data[i] = TABLA_DECRYPT_UPPER[c - 'A'];
+        } else if (c >= '0' && c <= '9') {
+            data[i] = TABLA_DECRYPT_DIGITS[c - '0'];
+        }
+    }
+}
+
+// Por tabla, sin ramas, desenrollado de a 8
+static inline void encriptarInPlaceEscalar(char* data, size_t len) {
+    size_t i = 0;
+    // Desenrollado de bucle para mayor velocidad
+    for (; i + 7 < len; i += 8) {
+        data[i] = TABLA_ENCRIPT_BYTE[static_cast<unsigned char>(data[i])];
+        data[i+1] = TABLA_ENCRIPT_BYTE[static_cast<unsigned char>(data[i+1])];
+        data[i+2] = TABLA_ENCRIPT_BYTE[static_cast<unsigned char>(data[i+2])];
+        data[i+3] = TABLA_ENCRIPT_BYTE[static_cast<unsigned char>(data[i+3])];
+        data[i+4] = TABLA_ENCRIPT_BYTE[static_cast<unsigned char>(data[i+4])];
+        data[i+5] = TABLA_ENCRIPT_BYTE[static_cast<unsigned char>(data[i+5])];
+        data[i+6] = TABLA_ENCRIPT_BYTE[static_cast<unsigned char>(data[i+6])];
+        data[i+7] = TABLA_ENCRIPT_BYTE[static_cast<unsigned char>(data[i+7])];
+    }
+    for (; i < len; ++i) {
+        data[i] = TABLA_ENCRIPT_BYTE[static_cast<unsigned char>(data[i])];
+    }
+}
+
+static inline void desencriptarInPlaceEscalar(char* data, size_t len) {
+    size_t i = 0;
+    // Desenrollado de bucle para mayor velocidad
+    for (; i + 7 < len; i += 8) {
+        data[i] = TABLA_DECRYPT_BYTE[static_cast<unsigned char>(data[i])];
+        data[i+1] = TABLA_DECRYPT_BYTE[static_cast<unsigned char>(data[i+1])];
+        data[i+2] = TABLA_DECRYPT_BYTE[static_cast<unsigned char>(data[i+2])];
+        data[i+3] = TABLA_DECRYPT_BYTE[static_cast<unsigned char>(data[i+3])];
+        data[i+4] = TABLA_DECRYPT_BYTE[static_cast<unsigned char>(data[i+4])];
+        data[i+5] = TABLA_DECRYPT_BYTE[static_cast<unsigned char>(data[i+5])];
+        data[i+6] = TABLA_DECRYPT_BYTE[static_cast<unsigned char>(data[i+6])];
+        data[i+7] = TABLA_DECRYPT_BYTE[static_cast<unsigned char>(data[i+7])];
+    }
+    for (; i < len; ++i) {
+        data[i] = TABLA_DECRYPT_BYTE[static_cast<unsigned char>(data[i])];
+    }
+}
+
+#endif
@@ -0,0 +1,267 @@
+// Kernels SIMD para el cifrado por desplazamiento (letras +3 mod 26,
+// digitos 9-d). Clasifican los bytes con comparaciones de rango y procesan
+// 16/32/64 bytes por instruccion. El nivel se elige al arrancar por CPUID
+// y se verifica byte a byte contra la tabla escalar de cada programa; si
+// no hay kernel disponible o no coincide, se usa la tabla escalar.
+#ifndef CIFRADO_SIMD_H
+#define CIFRADO_SIMD_H
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "deteccion_cpu.h"
+
+enum NivelSimd {
+    NIVEL_ESCALAR = 0,
+    NIVEL_SSE2 = 1,
+    NIVEL_AVX2 = 2,
+    NIVEL_AVX512 = 3
+};
+
+typedef void (*KernelCifrado)(char* data, size_t len);
+
+struct KernelsCifrado {
+    NivelSimd nivel;
+    KernelCifrado encriptar;    // NULL => usar la tabla escalar
+    KernelCifrado desencriptar;
+};
+
+static inline const char* nombreNivelSimd(NivelSimd nivel) {
+    switch (nivel) {
+        case NIVEL_SSE2: return "SSE2";
+        case NIVEL_AVX2: return "AVX2";
+        case NIVEL_AVX512: return "AVX-512BW";
+        default: return "escalar";
+    }
+}
+
+#ifdef SO_X86_GNU
+
+// Constantes comunes:
+//   letra:  (c | 0x20) - 'a' <= 25
+//   cifrar: +3, o -23 si el desplazamiento (c|0x20)-'a' >= 23
+//   descifrar: -3, o +23 si el desplazamiento es < 3
+//   digito: c - '0' <= 9  =>  ('0' + '9') - c
+template <bool DESENCRIPTAR>
+__attribute__((target("sse2")))
+static inline __m128i cifrarVectorSse2(__m128i v) {
+    const __m128i off = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    const __m128i esLetra = _mm_cmpeq_epi8(_mm_min_epu8(off, _mm_set1_epi8(25)), off);
+    __m128i vuelta;
+    __m128i delta;
+    if (DESENCRIPTAR) {
+        vuelta = _mm_cmpeq_epi8(_mm_min_epu8(off, _mm_set1_epi8(2)), off);
+        delta = _mm_add_epi8(_mm_set1_epi8(-3), _mm_and_si128(vuelta, _mm_set1_epi8(26)));
+    } else {
+        vuelta = _mm_cmpeq_epi8(_mm_max_epu8(off, _mm_set1_epi8(23)), off);
+        delta = _mm_sub_epi8(_mm_set1_epi8(3), _mm_and_si128(vuelta, _mm_set1_epi8(26)));
+    }
+    __m128i res = _mm_add_epi8(v, _mm_and_si128(esLetra, delta));
+
+    const __m128i dig = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    const __m128i esDigito = _mm_cmpeq_epi8(_mm_min_epu8(dig, _mm_set1_epi8(9)), dig);
+    const __m128i espejo = _mm_sub_epi8(_mm_set1_epi8('0' + '9'), v);
+    return _mm_or_si128(_mm_and_si128(esDigito, espejo), _mm_andnot_si128(esDigito, res));
+}
+
+template <bool DESENCRIPTAR>
+__attribute__((target("sse2")))
+static void cifrarSse2(char* data, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), cifrarVectorSse2<DESENCRIPTAR>(v));
+    }
+    if (i < len) {
+        char resto[16] = {0};
+        memcpy(resto, data + i, len - i);
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(resto));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(resto), cifrarVectorSse2<DESENCRIPTAR>(v));
+        memcpy(data + i, resto, len - i);
+    }
+}
+
+template <bool DESENCRIPTAR>
+__attribute__((target("avx2")))
+static inline __m256i cifrarVectorAvx2(__m256i v) {
+    const __m256i off = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    const __m256i esLetra = _mm256_cmpeq_epi8(_mm256_min_epu8(off, _mm256_set1_epi8(25)), off);
+    __m256i vuelta;
+    __m256i delta;
+    if (DESENCRIPTAR) {
+        vuelta = _mm256_cmpeq_epi8(_mm256_min_epu8(off, _mm256_set1_epi8(2)), off);
+        delta = _mm256_add_epi8(_mm256_set1_epi8(-3), _mm256_and_si256(vuelta, _mm256_set1_epi8(26)));
+    } else {
+        vuelta = _mm256_cmpeq_epi8(_mm256_max_epu8(off, _mm256_set1_epi8(23)), off);
+        delta = _mm256_sub_epi8(_mm256_set1_epi8(3), _mm256_and_si256(vuelta, _mm256_set1_epi8(26)));
+    }
+    __m256i res = _mm256_add_epi8(v, _mm256_and_si256(esLetra, delta));
+
+    const __m256i dig = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+    const __m256i esDigito = _mm256_cmpeq_epi8(_mm256_min_epu8(dig, _mm256_set1_epi8(9)), dig);
+    const __m256i espejo = _mm256_sub_epi8(_mm256_set1_epi8('0' + '9'), v);
+    return _mm256_blendv_epi8(res, espejo, esDigito);
+}
+
+template <bool DESENCRIPTAR>
+__attribute__((target("avx2")))
+static void cifrarAvx2(char* data, size_t len) {
+    size_t i = 0;
+    // Dos vectores por iteracion para ocultar la latencia de carga
+    for (; i + 64 <= len; i += 64) {
+        __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), cifrarVectorAvx2<DESENCRIPTAR>(v0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i + 32), cifrarVectorAvx2<DESENCRIPTAR>(v1));
+    }
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), cifrarVectorAvx2<DESENCRIPTAR>(v));
+    }
+    if (i < len) {
+        char resto[32] = {0};
+        memcpy(resto, data + i, len - i);
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(resto));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(resto), cifrarVectorAvx2<DESENCRIPTAR>(v));
+        memcpy(data + i, resto, len - i);
+    }
+}
+
+template <bool DESENCRIPTAR>
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i cifrarVectorAvx512(__m512i v) {
+    const __m512i off = _mm512_sub_epi8(_mm512_or_si512(v, _mm512_set1_epi8(0x20)), _mm512_set1_epi8('a'));
+    const __mmask64 esLetra = _mm512_cmple_epu8_mask(off, _mm512_set1_epi8(25));
+    __m512i res;
+    if (DESENCRIPTAR) {
+        const __mmask64 vuelta = esLetra & _mm512_cmplt_epu8_mask(off, _mm512_set1_epi8(3));
+        res = _mm512_mask_sub_epi8(v, esLetra, v, _mm512_set1_epi8(3));
+        res = _mm512_mask_add_epi8(res, vuelta, res, _mm512_set1_epi8(26));
+    } else {
+        const __mmask64 vuelta = esLetra & _mm512_cmpge_epu8_mask(off, _mm512_set1_epi8(23));
+        res = _mm512_mask_add_epi8(v, esLetra, v, _mm512_set1_epi8(3));
+        res = _mm512_mask_sub_epi8(res, vuelta, res, _mm512_set1_epi8(26));
+    }
+    const __mmask64 esDigito = _mm512_cmple_epu8_mask(_mm512_sub_epi8(v, _mm512_set1_epi8('0')), _mm512_set1_epi8(9));
+    return _mm512_mask_sub_epi8(res, esDigito, _mm512_set1_epi8('0' + '9'), v);
+}
+
+template <bool DESENCRIPTAR>
+__attribute__((target("avx512f,avx512bw")))
+static void cifrarAvx512(char* data, size_t len) {
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i v = _mm512_loadu_si512(data + i);
+        _mm512_storeu_si512(data + i, cifrarVectorAvx512<DESENCRIPTAR>(v));
+    }
+    if (i < len) {
+        // La cola se resuelve con carga/escritura enmascarada
+        const __mmask64 m = (~0ULL) >> (64 - (len - i));
+        __m512i v = _mm512_maskz_loadu_epi8(m, data + i);
+        _mm512_mask_storeu_epi8(data + i, m, cifrarVectorAvx512<DESENCRIPTAR>(v));
+    }
+}
+
+#endif // SO_X86_GNU
+
+// Nivel maximo que soportan el CPU y el sistema operativo
+static inline NivelSimd nivelSimdDisponible() {
+#ifdef SO_X86_GNU
+    const CaracteristicasCpu& cpu = caracteristicasCpu();
+    if (cpu.avx512bw) return NIVEL_AVX512;
+    if (cpu.avx2) return NIVEL_AVX2;
+    if (cpu.sse2) return NIVEL_SSE2;
+#endif
+    return NIVEL_ESCALAR;
+}
+
+static inline KernelsCifrado kernelsCifradoParaNivel(NivelSimd nivel) {
+    KernelsCifrado k = {NIVEL_ESCALAR, NULL, NULL};
+#ifdef SO_X86_GNU
+    switch (nivel) {
+        case NIVEL_AVX512:
+            k.nivel = NIVEL_AVX512;
+            k.encriptar = cifrarAvx512<false>;
+            k.desencriptar = cifrarAvx512<true>;
+            break;
+        case NIVEL_AVX2:
+            k.nivel = NIVEL_AVX2;
+            k.encriptar = cifrarAvx2<false>;
+            k.desencriptar = cifrarAvx2<true>;
+            break;
+        case NIVEL_SSE2:
+            k.nivel = NIVEL_SSE2;
+            k.encriptar = cifrarSse2<false>;
+            k.desencriptar = cifrarSse2<true>;
+            break;
+        default:
+            break;
+    }
+#else
+    (void)nivel;
+#endif
+    return k;
+}
+
+// Compara un kernel contra la referencia escalar con los 256 valores de
+// byte en todas las longitudes 0..300 y desplazamientos 0..63, para cubrir
+// el bucle principal, el desenrollado y la cola de cada ancho de vector
+static inline bool verificarKernelCifrado(KernelCifrado kernel, KernelCifrado referencia) {
+    const size_t MAX_LEN = 300;
+    const size_t MAX_DESPL = 64;
+    std::vector<char> patron(MAX_LEN + MAX_DESPL);
+    for (size_t i = 0; i < patron.size(); ++i) {
+        patron[i] = static_cast<char>((i * 167 + 13) & 0xFF);
+    }
+    std::vector<char> esperado(patron.size());
+    std::vector<char> obtenido(patron.size());
+
+    for (size_t despl = 0; despl < MAX_DESPL; despl += 7) {
+        for (size_t len = 0; len <= MAX_LEN; ++len) {
+            esperado = patron;
+            obtenido = patron;
+            referencia(&esperado[despl], len);
+            kernel(&obtenido[despl], len);
+            if (esperado != obtenido) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static inline KernelsCifrado& kernelsCifradoActivos() {
+    static KernelsCifrado activos = {NIVEL_ESCALAR, NULL, NULL};
+    return activos;
+}
+
+// Resultado de la verificacion de cada nivel (indice = NivelSimd)
+static inline bool* nivelesSimdVerificados() {
+    static bool verificados[NIVEL_AVX512 + 1] = {true, false, false, false};
+    return verificados;
+}
+
+// Verifica bit a bit todos los niveles disponibles contra la tabla escalar
+// del programa y activa el mejor que pase (sin superar nivelMaximo). Debe
+// llamarse una vez al arrancar, antes de lanzar threads; hasta entonces se
+// usa la tabla escalar.
+static inline NivelSimd inicializarCifradoSimd(KernelCifrado refEncriptar, KernelCifrado refDesencriptar,
+                                               NivelSimd nivelMaximo = NIVEL_AVX512) {
+    bool* verificados = nivelesSimdVerificados();
+    NivelSimd elegido = NIVEL_ESCALAR;
+
+    for (int n = NIVEL_SSE2; n <= nivelSimdDisponible(); ++n) {
+        NivelSimd nivel = static_cast<NivelSimd>(n);
+        KernelsCifrado k = kernelsCifradoParaNivel(nivel);
+        verificados[n] = k.encriptar != NULL &&
+                         verificarKernelCifrado(k.encriptar, refEncriptar) &&
+                         verificarKernelCifrado(k.desencriptar, refDesencriptar);
+        if (verificados[n] && nivel <= nivelMaximo) {
+            elegido = nivel;
+        }
+    }
+    kernelsCifradoActivos() = kernelsCifradoParaNivel(elegido);
+    return elegido;
+}
+
+#endif
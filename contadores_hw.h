@@ -0,0 +1,450 @@
+// Contadores de hardware por hilo con perf_event_open (solo Linux).
+// Cada hilo de trabajo abre un grupo propio (ciclos, instrucciones, fallos
+// de L1d y de LLC, fallos de prediccion de saltos, cambios de contexto y
+// fallos de pagina) que el kernel cuenta solo mientras ese hilo corre. Al
+// terminar una ejecucion combinarContadoresHw() lee el grupo de cada hilo
+// y suma lo contado desde la lectura anterior. Si el kernel multiplexa los
+// contadores (mas eventos que registros) los valores se escalan por
+// tiempo habilitado / tiempo contando.
+//
+// Los eventos que el kernel rechaza (perf_event_paranoid, sin PMU en una
+// VM, seccomp) quedan marcados como no disponibles y el resto sigue; si no
+// se abre ninguno, o fuera de Linux, todo es un no-op y el llamador solo
+// muestra el motivo.
+#ifndef CONTADORES_HW_H
+#define CONTADORES_HW_H
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/perf_event.h>)
+#define SO_PERF_EVENTS 1
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+enum ContadorHw {
+    HW_CICLOS,
+    HW_INSTRUCCIONES,
+    HW_FALLOS_L1D,          // lecturas de L1 de datos que fallan
+    HW_FALLOS_LLC,          // fallos del ultimo nivel de cache
+    HW_FALLOS_RAMAS,        // saltos mal predichos
+    HW_CAMBIOS_CONTEXTO,
+    HW_FALLOS_PAGINA,
+    NUM_CONTADORES_HW
+};
+
+static inline const char* nombreContadorHw(int contador) {
+    static const char* const NOMBRES[NUM_CONTADORES_HW] = {
+        "ciclos", "instrucciones", "fallos L1d", "fallos LLC", "fallos ramas", "cambios ctx", "fallos pag"};
+    return contador >= 0 && contador < NUM_CONTADORES_HW ? NOMBRES[contador] : "?";
+}
+
+// Lo contado en un intervalo, ya escalado
+struct LecturaContadoresHw {
+    uint64_t valores[NUM_CONTADORES_HW];
+
+    LecturaContadoresHw() {
+        reiniciar();
+    }
+
+    void reiniciar() {
+        memset(valores, 0, sizeof(valores));
+    }
+
+    void combinar(const LecturaContadoresHw& otra) {
+        for (int c = 0; c < NUM_CONTADORES_HW; ++c) {
+            valores[c] += otra.valores[c];
+        }
+    }
+
+    bool vacia() const {
+        for (int c = 0; c < NUM_CONTADORES_HW; ++c) {
+            if (valores[c] != 0) return false;
+        }
+        return true;
+    }
+};
+
+// Valores crudos del grupo en un instante (acumulados desde que se abrio)
+struct MuestraContadoresHw {
+    uint64_t valores[NUM_CONTADORES_HW];
+    uint64_t habilitado;    // ns con el grupo habilitado
+    uint64_t contando;      // ns con el grupo en los registros de la PMU
+
+    MuestraContadoresHw() : habilitado(0), contando(0) {
+        memset(valores, 0, sizeof(valores));
+    }
+};
+
+// Suma a `destino` lo contado entre `anterior` y `actual`. Con
+// multiplexado el grupo solo cuenta parte del intervalo: se extrapola.
+static inline void acumularDiferenciaHw(LecturaContadoresHw& destino, const MuestraContadoresHw& actual,
+                                        const MuestraContadoresHw& anterior) {
+    uint64_t habilitado = actual.habilitado - anterior.habilitado;
+    uint64_t contando = actual.contando - anterior.contando;
+    if (contando == 0) return;
+    double escala = habilitado > contando ? static_cast<double>(habilitado) / contando : 1.0;
+    for (int c = 0; c < NUM_CONTADORES_HW; ++c) {
+        uint64_t delta = actual.valores[c] - anterior.valores[c];
+        destino.valores[c] += static_cast<uint64_t>(delta * escala + 0.5);
+    }
+}
+
+#ifdef SO_PERF_EVENTS
+
+// Grupo de eventos de un hilo: el primero que se abre es el lider y una
+// sola read() devuelve todos los valores
+class GrupoContadoresHw {
+public:
+    GrupoContadoresHw() : lider(-1), numAbiertos(0) {
+        for (int c = 0; c < NUM_CONTADORES_HW; ++c) {
+            fds[c] = -1;
+            posicion[c] = -1;
+        }
+    }
+
+    ~GrupoContadoresHw() {
+        cerrar();
+    }
+
+    // Abre los contadores de `pedidos` para el hilo que llama. Devuelve el
+    // errno de un evento que fallo, con preferencia los de permisos (0 si
+    // se abrieron todos).
+    int abrir(const bool pedidos[NUM_CONTADORES_HW], bool soloUsuario) {
+        int primerError = 0;
+        for (int c = 0; c < NUM_CONTADORES_HW; ++c) {
+            if (!pedidos[c]) continue;
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            configurarEvento(static_cast<ContadorHw>(c), attr);
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.exclude_kernel = soloUsuario ? 1 : 0;
+            attr.exclude_hv = 1;
+            // pid 0, cpu -1: este hilo en cualquier CPU
+            int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, lider, 0));
+            if (fd < 0) {
+                if (primerError == 0 || errno == EACCES || errno == EPERM) primerError = errno;
+                continue;
+            }
+            if (lider < 0) lider = fd;
+            fds[c] = fd;
+            posicion[c] = numAbiertos++;
+        }
+        return primerError;
+    }
+
+    void cerrar() {
+        // Los miembros antes que el lider
+        for (int c = NUM_CONTADORES_HW - 1; c >= 0; --c) {
+            if (fds[c] >= 0 && fds[c] != lider) close(fds[c]);
+            fds[c] = -1;
+            posicion[c] = -1;
+        }
+        if (lider >= 0) close(lider);
+        lider = -1;
+        numAbiertos = 0;
+    }
+
+    bool abierto(int contador) const {
+        return fds[contador] >= 0;
+    }
+
+    bool leer(MuestraContadoresHw& muestra) const {
+        if (lider < 0) return false;
+        // nr, time_enabled, time_running, valores[nr]
+        uint64_t datos[3 + NUM_CONTADORES_HW];
+        ssize_t leidos = read(lider, datos, sizeof(datos));
+        if (leidos < static_cast<ssize_t>(3 * sizeof(uint64_t)) || datos[0] != static_cast<uint64_t>(numAbiertos)) {
+            return false;
+        }
+        muestra.habilitado = datos[1];
+        muestra.contando = datos[2];
+        for (int c = 0; c < NUM_CONTADORES_HW; ++c) {
+            muestra.valores[c] = posicion[c] >= 0 ? datos[3 + posicion[c]] : 0;
+        }
+        return true;
+    }
+
+private:
+    static void configurarEvento(ContadorHw contador, struct perf_event_attr& attr) {
+        attr.type = PERF_TYPE_HARDWARE;
+        switch (contador) {
+            case HW_CICLOS: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+            case HW_INSTRUCCIONES: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+            case HW_FALLOS_L1D:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            case HW_FALLOS_LLC: attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+            case HW_FALLOS_RAMAS: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+            case HW_CAMBIOS_CONTEXTO:
+                attr.type = PERF_TYPE_SOFTWARE;
+                attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+                break;
+            default:
+                attr.type = PERF_TYPE_SOFTWARE;
+                attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+                break;
+        }
+    }
+
+    int fds[NUM_CONTADORES_HW];
+    int posicion[NUM_CONTADORES_HW];    // indice del valor en la read() del grupo
+    int lider;
+    int numAbiertos;
+
+    GrupoContadoresHw(const GrupoContadoresHw&);
+    GrupoContadoresHw& operator=(const GrupoContadoresHw&);
+};
+
+// Un grupo abierto y la ultima muestra ya sumada
+struct ContadoresHilo {
+    GrupoContadoresHw grupo;
+    MuestraContadoresHw ultima;
+};
+
+struct EstadoContadoresHw {
+    bool activos;
+    bool soloUsuario;                       // perf_event_paranoid >= 2
+    bool disponibles[NUM_CONTADORES_HW];
+    std::mutex cerrojo;
+    std::vector<ContadoresHilo*> registro;  // hilos con el grupo abierto
+    LecturaContadoresHw retirados;          // lo ultimo de los hilos que terminaron
+
+    EstadoContadoresHw() : activos(false), soloUsuario(false) {
+        for (int c = 0; c < NUM_CONTADORES_HW; ++c) {
+            disponibles[c] = false;
+        }
+    }
+};
+
+static inline EstadoContadoresHw& estadoContadoresHw() {
+    static EstadoContadoresHw estado;
+    return estado;
+}
+
+// Al terminar el hilo se suma lo que falto leer y se cierra el grupo
+class TitularContadoresHilo {
+public:
+    TitularContadoresHilo() : contadores(NULL) {}
+
+    ~TitularContadoresHilo() {
+        if (contadores == NULL) return;
+        EstadoContadoresHw& estado = estadoContadoresHw();
+        std::lock_guard<std::mutex> lock(estado.cerrojo);
+        MuestraContadoresHw muestra;
+        if (contadores->grupo.leer(muestra)) {
+            acumularDiferenciaHw(estado.retirados, muestra, contadores->ultima);
+        }
+        for (size_t i = 0; i < estado.registro.size(); ++i) {
+            if (estado.registro[i] == contadores) {
+                estado.registro.erase(estado.registro.begin() + i);
+                break;
+            }
+        }
+        delete contadores;
+    }
+
+    ContadoresHilo* contadores;
+};
+
+static inline TitularContadoresHilo& titularContadoresHilo() {
+    static thread_local TitularContadoresHilo titular;
+    return titular;
+}
+
+// Grupo del hilo que llama (NULL si no se activaron o no se abrio nada)
+static inline GrupoContadoresHw* grupoContadoresDelHilo() {
+    ContadoresHilo* contadores = titularContadoresHilo().contadores;
+    return contadores != NULL ? &contadores->grupo : NULL;
+}
+
+// Abre el grupo del hilo que llama con los eventos disponibles. Llamar al
+// arrancar cada hilo de trabajo, despues de activarContadoresHw().
+static inline void iniciarContadoresHilo() {
+    EstadoContadoresHw& estado = estadoContadoresHw();
+    TitularContadoresHilo& titular = titularContadoresHilo();
+    if (!estado.activos || titular.contadores != NULL) return;
+    ContadoresHilo* contadores = new ContadoresHilo();
+    contadores->grupo.abrir(estado.disponibles, estado.soloUsuario);
+    if (!contadores->grupo.leer(contadores->ultima)) {
+        delete contadores;
+        return;
+    }
+    titular.contadores = contadores;
+    std::lock_guard<std::mutex> lock(estado.cerrojo);
+    estado.registro.push_back(contadores);
+}
+
+static inline int perfEventParanoid() {
+    int valor = -100;
+    FILE* f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+    if (f != NULL) {
+        if (fscanf(f, "%d", &valor) != 1) valor = -100;
+        fclose(f);
+    }
+    return valor;
+}
+
+// Prueba cada evento en el hilo que llama (que queda contando tambien) y
+// devuelve una linea para la cabecera: los disponibles o por que no hay.
+static inline std::string activarContadoresHw() {
+    EstadoContadoresHw& estado = estadoContadoresHw();
+    bool pedidos[NUM_CONTADORES_HW];
+    for (int c = 0; c < NUM_CONTADORES_HW; ++c) {
+        pedidos[c] = true;
+    }
+    // Primero usuario + kernel; si el kernel no lo deja (perf_event_paranoid
+    // sin privilegios) solo usuario. Ahi los cambios de contexto, que
+    // ocurren en el kernel, darian siempre 0: no se piden.
+    int primerError = 0;
+    bool alguno = false;
+    for (int intento = 0; intento < 2 && !alguno; ++intento) {
+        estado.soloUsuario = intento > 0;
+        if (estado.soloUsuario) {
+            if (primerError != EACCES && primerError != EPERM) break;
+            pedidos[HW_CAMBIOS_CONTEXTO] = false;
+        }
+        GrupoContadoresHw prueba;
+        primerError = prueba.abrir(pedidos, estado.soloUsuario);
+        for (int c = 0; c < NUM_CONTADORES_HW; ++c) {
+            estado.disponibles[c] = prueba.abierto(c);
+            alguno = alguno || estado.disponibles[c];
+        }
+    }
+    std::string faltan;
+    for (int c = 0; c < NUM_CONTADORES_HW; ++c) {
+        if (estado.disponibles[c]) continue;
+        faltan += faltan.empty() ? "" : ", ";
+        faltan += nombreContadorHw(c);
+    }
+    const char* motivo = strerror(primerError);
+    if (primerError == EACCES || primerError == EPERM || primerError == 0) {
+        motivo = "sin permiso";
+    } else if (primerError == ENOENT || primerError == EOPNOTSUPP) {
+        motivo = "el CPU (o la VM) no expone esos eventos";
+    }
+    char texto[128];
+    snprintf(texto, sizeof(texto), "perf_event_paranoid=%d, %s", perfEventParanoid(), motivo);
+    if (!alguno) {
+        return std::string("no disponibles (") + texto + ")";
+    }
+    estado.activos = true;
+    iniciarContadoresHilo();
+    std::string linea = estado.soloUsuario ? "perf_event_open, solo espacio de usuario" : "perf_event_open";
+    if (!faltan.empty()) {
+        linea += " (sin " + faltan + "; " + texto + ")";
+    }
+    return linea;
+}
+
+// Suma en `destino` lo contado por todos los hilos desde la ultima
+// combinacion. Lee los grupos de otros hilos: llamar con ellos parados.
+static inline void combinarContadoresHw(LecturaContadoresHw& destino) {
+    EstadoContadoresHw& estado = estadoContadoresHw();
+    std::lock_guard<std::mutex> lock(estado.cerrojo);
+    for (size_t i = 0; i < estado.registro.size(); ++i) {
+        ContadoresHilo& hilo = *estado.registro[i];
+        MuestraContadoresHw muestra;
+        if (hilo.grupo.leer(muestra)) {
+            acumularDiferenciaHw(destino, muestra, hilo.ultima);
+            hilo.ultima = muestra;
+        }
+    }
+    destino.combinar(estado.retirados);
+    estado.retirados.reiniciar();
+}
+
+#else
+
+class GrupoContadoresHw {
+public:
+    bool leer(MuestraContadoresHw&) const {
+        return false;
+    }
+};
+
+static inline GrupoContadoresHw* grupoContadoresDelHilo() {
+    return NULL;
+}
+
+static inline void iniciarContadoresHilo() {}
+
+static inline std::string activarContadoresHw() {
+    return "no disponibles (perf_event_open es solo de Linux)";
+}
+
+static inline void combinarContadoresHw(LecturaContadoresHw&) {}
+
+#endif // SO_PERF_EVENTS
+
+static inline bool contadoresHwActivos() {
+#ifdef SO_PERF_EVENTS
+    return estadoContadoresHw().activos;
+#else
+    return false;
+#endif
+}
+
+static inline bool contadorHwDisponible(int contador) {
+#ifdef SO_PERF_EVENTS
+    return estadoContadoresHw().activos && estadoContadoresHw().disponibles[contador];
+#else
+    (void)contador;
+    return false;
+#endif
+}
+
+static inline void descartarContadoresHw() {
+    LecturaContadoresHw descartados;
+    combinarContadoresHw(descartados);
+}
+
+// Dos lineas para el bloque TT/TPPA: ciclos, IPC y ciclos por byte
+// procesado (`bytes` > 0), luego los fallos y eventos del sistema. Solo
+// aparecen los contadores disponibles.
+static inline std::string resumenContadoresHw(const LecturaContadoresHw& lectura, double bytes) {
+    std::string texto;
+    char campo[96];
+    const uint64_t* v = lectura.valores;
+    if (contadorHwDisponible(HW_CICLOS)) {
+        snprintf(campo, sizeof(campo), "%.2f Mciclos", v[HW_CICLOS] / 1e6);
+        texto += campo;
+        if (bytes > 0) {
+            snprintf(campo, sizeof(campo), " (%.2f ciclos/B)", v[HW_CICLOS] / bytes);
+            texto += campo;
+        }
+        if (contadorHwDisponible(HW_INSTRUCCIONES) && v[HW_CICLOS] > 0) {
+            snprintf(campo, sizeof(campo), "  IPC %.2f", static_cast<double>(v[HW_INSTRUCCIONES]) / v[HW_CICLOS]);
+            texto += campo;
+        }
+    } else if (contadorHwDisponible(HW_INSTRUCCIONES)) {
+        snprintf(campo, sizeof(campo), "%.2f Minstrucciones", v[HW_INSTRUCCIONES] / 1e6);
+        texto += campo;
+    }
+    std::string eventos;
+    for (int c = HW_FALLOS_L1D; c < NUM_CONTADORES_HW; ++c) {
+        if (!contadorHwDisponible(c)) continue;
+        snprintf(campo, sizeof(campo), "%s%s %llu", eventos.empty() ? "" : "  ", nombreContadorHw(c),
+                 static_cast<unsigned long long>(v[c]));
+        eventos += campo;
+    }
+    if (texto.empty() && eventos.empty()) return "HW: sin contadores\n";
+    std::string resultado;
+    if (!texto.empty()) resultado += "HW: " + texto + "\n";
+    if (!eventos.empty()) resultado += "HW: " + eventos + "\n";
+    return resultado;
+}
+
+#endif
@@ -0,0 +1,227 @@
+// Copia de archivos del lado del kernel para generar las copias.
+// Se prueba, en orden: reflink (ioctl FICLONE, XFS/Btrfs: la copia es solo
+// metadatos), copy_file_range (el kernel copia sin pasar por espacio de
+// usuario, ext4 incluido), sendfile y, si nada de eso funciona, el bucle
+// read/write de siempre. Una estrategia que falla por no estar soportada
+// se descarta para el resto de la ejecucion. En Windows se usa CopyFile.
+// Compartido por main_pro.cpp y main_simple.cpp.
+#ifndef COPIA_ARCHIVOS_H
+#define COPIA_ARCHIVOS_H
+
+#include <atomic>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "buffers_io.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+#endif
+#endif
+
+// Forma de generar cada copia N.txt
+enum ModoCopia {
+    COPIA_MEMORIA,      // escribir desde el original en memoria (camino original)
+    COPIA_KERNEL        // copiarArchivo(): reflink / copy_file_range / sendfile
+};
+
+static inline const char* nombreModoCopia(ModoCopia modo) {
+    return modo == COPIA_KERNEL ? "kernel" : "memoria";
+}
+
+static inline bool parsearModoCopia(const std::string& nombre, ModoCopia& modo) {
+    if (nombre == "memoria") modo = COPIA_MEMORIA;
+    else if (nombre == "kernel") modo = COPIA_KERNEL;
+    else return false;
+    return true;
+}
+
+enum EstrategiaCopia {
+    COPIA_REFLINK,
+    COPIA_COPY_FILE_RANGE,
+    COPIA_SENDFILE,
+    COPIA_ESPACIO_USUARIO,
+    COPIA_COPYFILE,         // Windows
+    NUM_ESTRATEGIAS_COPIA
+};
+
+static inline const char* nombreEstrategiaCopia(EstrategiaCopia e) {
+    switch (e) {
+        case COPIA_REFLINK: return "reflink";
+        case COPIA_COPY_FILE_RANGE: return "copy_file_range";
+        case COPIA_SENDFILE: return "sendfile";
+        case COPIA_COPYFILE: return "CopyFile";
+        default: return "read/write";
+    }
+}
+
+// Copias hechas con cada estrategia (para el reporte)
+static inline std::atomic<unsigned>* contadoresCopia() {
+    static std::atomic<unsigned> contadores[NUM_ESTRATEGIAS_COPIA];
+    return contadores;
+}
+
+// Estrategias descartadas porque el sistema de archivos no las soporta
+static inline std::atomic<bool>* estrategiasDescartadas() {
+    static std::atomic<bool> descartadas[NUM_ESTRATEGIAS_COPIA];
+    return descartadas;
+}
+
+static inline void reiniciarContadoresCopia() {
+    for (int i = 0; i < NUM_ESTRATEGIAS_COPIA; ++i) {
+        contadoresCopia()[i] = 0;
+    }
+}
+
+// "reflink x50" o "copy_file_range x30, read/write x2"
+static inline std::string resumenEstrategiasCopia() {
+    std::stringstream ss;
+    for (int i = 0; i < NUM_ESTRATEGIAS_COPIA; ++i) {
+        unsigned n = contadoresCopia()[i].load();
+        if (n == 0) continue;
+        if (ss.tellp() > 0) ss << ", ";
+        ss << nombreEstrategiaCopia(static_cast<EstrategiaCopia>(i)) << " x" << n;
+    }
+    return ss.tellp() > 0 ? ss.str() : "ninguna";
+}
+
+#ifndef _WIN32
+// Errores que significan "esta estrategia no sirve aqui", no fallo de I/O
+static inline bool errorNoSoportado(int e) {
+    return e == EOPNOTSUPP || e == ENOTTY || e == EXDEV || e == EINVAL || e == ENOSYS || e == EBADF;
+}
+
+static inline bool copiarEspacioUsuario(int in, int out, size_t tamano) {
+    char* buffer = bufferIoDelHilo();
+    const size_t capacidad = tamanoBufferIo();
+    size_t copiados = 0;
+    while (copiados < tamano) {
+        ssize_t leidos = read(in, buffer, capacidad);
+        if (leidos < 0 && errno == EINTR) continue;
+        if (leidos <= 0) return leidos == 0;
+        ssize_t hechos = 0;
+        while (hechos < leidos) {
+            ssize_t r = write(out, buffer + hechos, static_cast<size_t>(leidos - hechos));
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) return false;
+            hechos += r;
+        }
+        copiados += static_cast<size_t>(leidos);
+    }
+    return true;
+}
+#endif
+
+// Copia `origen` en `destino` (lo crea o trunca) y devuelve la estrategia
+// que funciono. Lanza runtime_error si la copia falla.
+static inline EstrategiaCopia copiarArchivo(const char* origen, const char* destino) {
+#ifdef _WIN32
+    if (!CopyFileA(origen, destino, FALSE)) {
+        throw std::runtime_error(std::string("No se pudo copiar ") + origen + " a " + destino);
+    }
+    contadoresCopia()[COPIA_COPYFILE]++;
+    return COPIA_COPYFILE;
+#else
+    int in = ::open(origen, O_RDONLY);
+    if (in < 0) {
+        throw std::runtime_error(std::string("No se pudo abrir el archivo: ") + origen);
+    }
+    struct stat st;
+    if (fstat(in, &st) != 0) {
+        ::close(in);
+        throw std::runtime_error(std::string("No se pudo leer el tamano de: ") + origen);
+    }
+    int out = ::open(destino, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        ::close(in);
+        throw std::runtime_error(std::string("No se pudo crear el archivo: ") + destino);
+    }
+    const size_t tamano = static_cast<size_t>(st.st_size);
+    std::atomic<bool>* descartadas = estrategiasDescartadas();
+    EstrategiaCopia usada = COPIA_ESPACIO_USUARIO;
+    bool ok = false;
+
+#ifdef __linux__
+    // 1. Reflink: comparte los extents del original (copia en escritura)
+    if (!descartadas[COPIA_REFLINK]) {
+        if (ioctl(out, FICLONE, in) == 0) {
+            ok = true;
+            usada = COPIA_REFLINK;
+        } else if (errorNoSoportado(errno)) {
+            descartadas[COPIA_REFLINK] = true;
+        }
+    }
+
+    // 2. copy_file_range: copia dentro del kernel (o delegada al servidor)
+    if (!ok && !descartadas[COPIA_COPY_FILE_RANGE]) {
+        loff_t offIn = 0, offOut = 0;
+        bool fallo = false;
+        while (static_cast<size_t>(offIn) < tamano) {
+            ssize_t r = copy_file_range(in, &offIn, out, &offOut, tamano - static_cast<size_t>(offIn), 0);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) {
+                fallo = true;
+                if (r < 0 && offIn == 0 && errorNoSoportado(errno)) descartadas[COPIA_COPY_FILE_RANGE] = true;
+                break;
+            }
+        }
+        // Si falla a mitad, la siguiente estrategia reescribe desde el inicio
+        if (!fallo) {
+            ok = true;
+            usada = COPIA_COPY_FILE_RANGE;
+        }
+    }
+
+    // 3. sendfile: archivo a archivo sin pasar por un buffer de usuario
+    if (!ok && !descartadas[COPIA_SENDFILE]) {
+        off_t off = 0;
+        bool fallo = false;
+        while (static_cast<size_t>(off) < tamano) {
+            ssize_t r = sendfile(out, in, &off, tamano - static_cast<size_t>(off));
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) {
+                fallo = true;
+                if (r < 0 && off == 0 && errorNoSoportado(errno)) descartadas[COPIA_SENDFILE] = true;
+                break;
+            }
+        }
+        if (!fallo) {
+            ok = true;
+            usada = COPIA_SENDFILE;
+        }
+    }
+#endif
+
+    // 4. Bucle read/write
+    if (!ok) {
+        ok = lseek(in, 0, SEEK_SET) == 0 && lseek(out, 0, SEEK_SET) == 0 && copiarEspacioUsuario(in, out, tamano);
+        usada = COPIA_ESPACIO_USUARIO;
+    }
+
+    ok = (::close(out) == 0) && ok;
+    ::close(in);
+    if (!ok) {
+        throw std::runtime_error(std::string("No se pudo copiar ") + origen + " a " + destino);
+    }
+    contadoresCopia()[usada]++;
+    return usada;
+#endif
+}
+
+static inline EstrategiaCopia copiarArchivo(const std::string& origen, const std::string& destino) {
+    return copiarArchivo(origen.c_str(), destino.c_str());
+}
+
+#endif
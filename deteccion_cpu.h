@@ -0,0 +1,63 @@
+// Deteccion de caracteristicas del CPU en tiempo de ejecucion (CPUID)
+// Compartido por main_pro.cpp y main_simple.cpp para elegir los kernels
+// SIMD una sola vez al arrancar.
+#ifndef DETECCION_CPU_H
+#define DETECCION_CPU_H
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SO_X86_GNU 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+struct CaracteristicasCpu {
+    bool sse2;
+    bool ssse3;
+    bool sse41;
+    bool avx2;
+    bool avx512bw;
+    bool sha;
+};
+
+#ifdef SO_X86_GNU
+// XCR0: el sistema operativo debe guardar los registros YMM/ZMM en cada
+// cambio de contexto, si no las instrucciones AVX no son utilizables
+static inline unsigned long long leerXcr0() {
+    unsigned int eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+}
+#endif
+
+static inline CaracteristicasCpu detectarCaracteristicasCpu() {
+    CaracteristicasCpu cpu = {false, false, false, false, false, false};
+#ifdef SO_X86_GNU
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return cpu;
+    }
+    cpu.sse2 = (edx & bit_SSE2) != 0;
+    cpu.ssse3 = (ecx & bit_SSSE3) != 0;
+    cpu.sse41 = (ecx & bit_SSE4_1) != 0;
+
+    bool osxsave = (ecx & bit_OSXSAVE) != 0;
+    unsigned long long xcr0 = osxsave ? leerXcr0() : 0;
+    bool ymmHabilitado = (xcr0 & 0x6) == 0x6;
+    bool zmmHabilitado = (xcr0 & 0xE6) == 0xE6;
+
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        cpu.avx2 = ymmHabilitado && (ebx & bit_AVX2) != 0;
+        cpu.avx512bw = zmmHabilitado && (ebx & bit_AVX512F) != 0 && (ebx & bit_AVX512BW) != 0;
+        cpu.sha = (ebx & bit_SHA) != 0;
+    }
+#endif
+    return cpu;
+}
+
+// Se detecta una sola vez (inicializacion estatica thread-safe en C++11)
+static inline const CaracteristicasCpu& caracteristicasCpu() {
+    static const CaracteristicasCpu cpu = detectarCaracteristicasCpu();
+    return cpu;
+}
+
+#endif
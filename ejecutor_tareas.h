@@ -0,0 +1,107 @@
+// Ejecutor de tareas de tamano fijo con cola acotada y futures.
+// Los hilos se crean una sola vez y atienden todas las fases del proceso;
+// cuando la cola esta llena, enviar() bloquea al productor en lugar de
+// crear mas hilos, asi el numero de hilos vivos nunca supera el del CPU.
+#ifndef EJECUTOR_TAREAS_H
+#define EJECUTOR_TAREAS_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class EjecutorTareas {
+public:
+    // numHilos = 0 usa std::thread::hardware_concurrency(); capacidad = 0
+    // deja la cola en el doble del numero de hilos
+    explicit EjecutorTareas(size_t numHilos = 0, size_t capacidad = 0)
+        : capacidadCola(0), detener(false) {
+        if (numHilos == 0) {
+            numHilos = std::thread::hardware_concurrency();
+            if (numHilos == 0) numHilos = 1;
+        }
+        capacidadCola = capacidad > 0 ? capacidad : 2 * numHilos;
+        for (size_t i = 0; i < numHilos; ++i) {
+            hilos.push_back(std::thread(&EjecutorTareas::bucleHilo, this));
+        }
+    }
+
+    ~EjecutorTareas() {
+        {
+            std::lock_guard<std::mutex> lock(mutexCola);
+            detener = true;
+        }
+        cvHayTarea.notify_all();
+        cvHayEspacio.notify_all();
+        for (size_t i = 0; i < hilos.size(); ++i) {
+            hilos[i].join();
+        }
+    }
+
+    size_t numHilos() const {
+        return hilos.size();
+    }
+
+    size_t capacidad() const {
+        return capacidadCola;
+    }
+
+    // Encola f y devuelve su future; las excepciones de f salen en get().
+    // Bloquea mientras la cola esta llena. No llamar desde una tarea del
+    // mismo ejecutor: con la cola llena se bloquearia a si mismo.
+    template <class F>
+    std::future<typename std::result_of<F()>::type> enviar(F f) {
+        typedef typename std::result_of<F()>::type Resultado;
+        std::shared_ptr<std::packaged_task<Resultado()> > tarea =
+            std::make_shared<std::packaged_task<Resultado()> >(f);
+        std::future<Resultado> resultado = tarea->get_future();
+        {
+            std::unique_lock<std::mutex> lock(mutexCola);
+            while (!detener && cola.size() >= capacidadCola) {
+                cvHayEspacio.wait(lock);
+            }
+            cola.push_back([tarea]() { (*tarea)(); });
+        }
+        cvHayTarea.notify_one();
+        return resultado;
+    }
+
+private:
+    void bucleHilo() {
+        while (true) {
+            std::function<void()> tarea;
+            {
+                std::unique_lock<std::mutex> lock(mutexCola);
+                while (!detener && cola.empty()) {
+                    cvHayTarea.wait(lock);
+                }
+                if (cola.empty()) {
+                    return;
+                }
+                tarea.swap(cola.front());
+                cola.pop_front();
+            }
+            cvHayEspacio.notify_one();
+            tarea();
+        }
+    }
+
+    std::vector<std::thread> hilos;
+    std::deque<std::function<void()> > cola;
+    size_t capacidadCola;
+    bool detener;
+
+    std::mutex mutexCola;
+    std::condition_variable cvHayTarea;
+    std::condition_variable cvHayEspacio;
+
+    EjecutorTareas(const EjecutorTareas&);
+    EjecutorTareas& operator=(const EjecutorTareas&);
+};
+
+#endif
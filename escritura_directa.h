@@ -0,0 +1,115 @@
+// Escritura directa (O_DIRECT / FILE_FLAG_NO_BUFFERING) que no pasa por la
+// cache de paginas. Los datos se copian al buffer de I/O del hilo
+// (buffers_io.h, alineado a 2 MB) y se escriben en extensiones del tamano
+// de ese buffer; la cola sin alinear se escribe rellenada hasta el bloque
+// y luego se recorta el archivo a su tamano real (ftruncate /
+// SetEndOfFile). Asi el tiempo de cada archivo refleja el dispositivo y no
+// el writeback, y las copias no desalojan de la cache al resto de datos.
+// Compartido por main_pro.cpp y main_simple.cpp.
+#ifndef ESCRITURA_DIRECTA_H
+#define ESCRITURA_DIRECTA_H
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "buffers_io.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+enum ModoEscritura {
+    ESCRITURA_CACHE,        // a traves de la cache de paginas (camino original)
+    ESCRITURA_DIRECTA       // O_DIRECT con buffers alineados
+};
+
+static inline const char* nombreModoEscritura(ModoEscritura modo) {
+    return modo == ESCRITURA_DIRECTA ? "directa" : "cache";
+}
+
+static inline bool parsearModoEscritura(const std::string& nombre, ModoEscritura& modo) {
+    if (nombre == "cache") modo = ESCRITURA_CACHE;
+    else if (nombre == "directa") modo = ESCRITURA_DIRECTA;
+    else return false;
+    return true;
+}
+
+// Alineacion de direcciones, offsets y longitudes para O_DIRECT: una pagina
+// cubre el tamano de bloque logico de cualquier disco comun (512 o 4096)
+static const size_t ALINEACION_DIRECTA = 4096;
+// Escribe [datos, datos + tamano) en `nombre` sin cache de paginas.
+// Devuelve false si el sistema de archivos no admite escritura directa
+// (tmpfs, algunos montajes de red): el llamador escribe por el camino
+// normal. Lanza runtime_error si falla una escritura.
+static inline bool escribirArchivoDirecto(const char* nombre, const char* datos, size_t tamano) {
+#ifdef _WIN32
+    HANDLE h = CreateFileA(nombre, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH, NULL);
+    if (h == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+#else
+    int fd = ::open(nombre, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if (fd < 0) {
+        if (errno == EINVAL) return false;
+        throw std::runtime_error(std::string("No se pudo crear el archivo: ") + nombre);
+    }
+#endif
+
+    char* buffer = bufferIoDelHilo();
+    const size_t extension = tamanoBufferIo();   // multiplo de ALINEACION_DIRECTA
+    size_t escritos = 0;
+    bool ok = true;
+    while (ok && escritos < tamano) {
+        size_t n = std::min(extension, tamano - escritos);
+        memcpy(buffer, datos + escritos, n);
+        // Cola: rellenar hasta el siguiente bloque; se recorta al final
+        size_t alineado = (n + ALINEACION_DIRECTA - 1) & ~(ALINEACION_DIRECTA - 1);
+        if (alineado > n) {
+            memset(buffer + n, 0, alineado - n);
+        }
+#ifdef _WIN32
+        DWORD hechos = 0;
+        ok = WriteFile(h, buffer, static_cast<DWORD>(alineado), &hechos, NULL) && hechos == alineado;
+#else
+        size_t hechos = 0;
+        while (ok && hechos < alineado) {
+            ssize_t r = pwrite(fd, buffer + hechos, alineado - hechos, static_cast<off_t>(escritos + hechos));
+            if (r < 0 && errno == EINTR) continue;
+            ok = r > 0;
+            if (ok) hechos += static_cast<size_t>(r);
+        }
+#endif
+        escritos += n;
+    }
+
+#ifdef _WIN32
+    if (ok && tamano % ALINEACION_DIRECTA != 0) {
+        LARGE_INTEGER fin;
+        fin.QuadPart = static_cast<LONGLONG>(tamano);
+        ok = SetFilePointerEx(h, fin, NULL, FILE_BEGIN) && SetEndOfFile(h);
+    }
+    CloseHandle(h);
+#else
+    if (ok && tamano % ALINEACION_DIRECTA != 0) {
+        ok = ftruncate(fd, static_cast<off_t>(tamano)) == 0;
+    }
+    ok = (::close(fd) == 0) && ok;
+#endif
+    if (!ok) {
+        throw std::runtime_error(std::string("No se pudo escribir el archivo: ") + nombre);
+    }
+    return true;
+}
+
+static inline bool escribirArchivoDirecto(const std::string& nombre, const char* datos, size_t tamano) {
+    return escribirArchivoDirecto(nombre.c_str(), datos, tamano);
+}
+
+#endif
@@ -0,0 +1,54 @@
+// Exporta un manifiesto binario (--sha=manifiesto) a un N.sha por registro,
+// con los 64 dígitos hex de siempre, para las herramientas que esperan el
+// formato de un archivo por copia.
+//
+// Uso: exportar_manifiesto [manifiesto] [directorio]
+//      (por defecto hashes.manifiesto y el directorio actual)
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include "sha256.h"
+#include "manifiesto.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if (argc > 3) {
+        cout << "Uso: " << argv[0] << " [manifiesto] [directorio]\n";
+        return 1;
+    }
+    string ruta = argc > 1 ? argv[1] : RUTA_MANIFIESTO;
+    string directorio = argc > 2 ? argv[2] : ".";
+
+    try {
+        ManifiestoMapeado manifiesto;
+        manifiesto.abrir(ruta, LECTURA_MMAP);
+
+        // Si un número aparece más de una vez queda el último registro
+        size_t exportados = 0;
+        for (size_t i = 0; i < manifiesto.numRegistros(); ++i) {
+            const RegistroManifiesto& registro = manifiesto.registro(i);
+            char nombre[TAM_RUTA_FRAGMENTADA];
+            snprintf(nombre, sizeof(nombre), "%s/%llu.sha", directorio.c_str(),
+                     static_cast<unsigned long long>(registro.numero));
+            char hex[65];
+            digestAHex(registro.digest, hex);
+
+            int fd = abrirArchivoFd(nombre, O_WRONLY | O_CREAT | O_TRUNC);
+            bool ok = fd >= 0 && escribirCompletoFd(fd, hex, 64);
+            if (fd >= 0) {
+                cerrarFd(fd);
+            }
+            if (!ok) {
+                cout << "ERROR: no se pudo escribir " << nombre << "\n";
+                return 1;
+            }
+            ++exportados;
+        }
+        cout << exportados << " archivos .sha exportados de " << ruta << " a " << directorio << "/\n";
+    } catch (const exception& e) {
+        cout << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,465 @@
+// Backend de I/O por lotes con io_uring (Linux 5.6+).
+// Las operaciones openat/write/read/close de muchos archivos se encolan
+// juntas en el anillo de envio y se completan de forma asincrona: un solo
+// hilo mantiene la cola del dispositivo llena en lugar de que cada hilo
+// bloquee en su propio open/write/close. Usa buffers registrados
+// (READ_FIXED/WRITE_FIXED) y archivos fijos cuando el kernel lo permite.
+// Se habla con el kernel por syscalls directas, sin liburing. Fuera de
+// Linux, o si el kernel/seccomp no deja crear el anillo, activo() es false
+// y el llamador usa el camino de streams de siempre.
+#ifndef IO_URING_LOTES_H
+#define IO_URING_LOTES_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SO_IO_URING 1
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif
+#endif
+#endif
+
+// Forma de hacer el I/O de las copias
+enum ModoIo {
+    IO_STREAM,      // ifstream/ofstream por archivo (camino original)
+    IO_URING        // lotes asincronos con io_uring
+};
+
+static inline const char* nombreModoIo(ModoIo modo) {
+    return modo == IO_URING ? "io_uring" : "stream";
+}
+
+static inline bool parsearModoIo(const std::string& nombre, ModoIo& modo) {
+    if (nombre == "stream") modo = IO_STREAM;
+    else if (nombre == "uring") modo = IO_URING;
+    else return false;
+    return true;
+}
+
+// Una escritura: crea/trunca `nombre` con [datos, datos + tamano)
+struct EscrituraLote {
+    std::string nombre;
+    const char* datos;
+    size_t tamano;
+};
+
+class MotorIoUring {
+public:
+    // profundidad = operaciones en vuelo por lote (entradas del anillo)
+    explicit MotorIoUring(unsigned profundidad = 128)
+        : fdAnillo(-1), entradas(0), archivosFijos(false), buffersFijos(true),
+          anilloSq(NULL), anilloCq(NULL), tamSq(0), tamCq(0), sqes(NULL), tamSqes(0) {
+#ifdef SO_IO_URING
+        iniciar(profundidad);
+#else
+        (void)profundidad;
+#endif
+    }
+
+    ~MotorIoUring() {
+#ifdef SO_IO_URING
+        if (sqes != NULL) munmap(sqes, tamSqes);
+        if (anilloCq != NULL && anilloCq != anilloSq) munmap(anilloCq, tamCq);
+        if (anilloSq != NULL) munmap(anilloSq, tamSq);
+        if (fdAnillo >= 0) close(fdAnillo);
+#endif
+    }
+
+    bool activo() const {
+        return fdAnillo >= 0;
+    }
+
+    // Descripcion de lo que se obtuvo (para imprimir al arrancar)
+    std::string descripcion() const {
+        if (!activo()) return "no disponible";
+        std::string d = "profundidad " + std::to_string(entradas);
+        d += archivosFijos ? ", archivos fijos" : "";
+        d += buffersFijos ? ", buffers registrados" : "";
+        return d;
+    }
+
+    // Escribe todos los archivos en lotes de `entradas`. Lanza
+    // runtime_error si alguna operacion falla.
+    void escribirArchivos(const std::vector<EscrituraLote>& escrituras) {
+#ifdef SO_IO_URING
+        for (size_t inicio = 0; inicio < escrituras.size(); inicio += entradas) {
+            size_t n = std::min<size_t>(entradas, escrituras.size() - inicio);
+            std::vector<Transferencia> lote(n);
+            for (size_t i = 0; i < n; ++i) {
+                const EscrituraLote& e = escrituras[inicio + i];
+                lote[i].nombre = &e.nombre;
+                lote[i].datos = const_cast<char*>(e.datos);
+                lote[i].tamano = e.tamano;
+            }
+            procesarLote(lote, true);
+        }
+#else
+        (void)escrituras;
+        throw std::runtime_error("io_uring no disponible");
+#endif
+    }
+
+    // Lee cada archivo completo en contenidos[i] (mismo orden que nombres)
+    void leerArchivos(const std::vector<std::string>& nombres, std::vector<std::string>& contenidos) {
+#ifdef SO_IO_URING
+        contenidos.resize(nombres.size());
+        for (size_t inicio = 0; inicio < nombres.size(); inicio += entradas) {
+            size_t n = std::min<size_t>(entradas, nombres.size() - inicio);
+            std::vector<Transferencia> lote(n);
+            for (size_t i = 0; i < n; ++i) {
+                lote[i].nombre = &nombres[inicio + i];
+                lote[i].destino = &contenidos[inicio + i];
+            }
+            procesarLote(lote, false);
+        }
+#else
+        (void)nombres;
+        (void)contenidos;
+        throw std::runtime_error("io_uring no disponible");
+#endif
+    }
+
+private:
+    int fdAnillo;
+    unsigned entradas;
+    bool archivosFijos;
+    bool buffersFijos;
+
+    void* anilloSq;
+    void* anilloCq;
+    size_t tamSq;
+    size_t tamCq;
+    void* sqes;
+    size_t tamSqes;
+
+#ifdef SO_IO_URING
+    unsigned* sqCabeza;
+    unsigned* sqCola;
+    unsigned sqMascara;
+    unsigned* sqArreglo;
+    unsigned* cqCabeza;
+    unsigned* cqCola;
+    unsigned cqMascara;
+    io_uring_cqe* cqes;
+    unsigned colaLocal;         // sqes preparados y aun no publicados
+
+    struct Transferencia {
+        const std::string* nombre;
+        char* datos;
+        size_t tamano;
+        std::string* destino;   // lectura: donde queda el contenido
+        int fd;
+        size_t hechos;
+        int buffer;             // indice de buffer registrado, -1 si no
+
+        Transferencia() : nombre(NULL), datos(NULL), tamano(0), destino(NULL), fd(-1), hechos(0), buffer(-1) {}
+    };
+
+    int registrar(unsigned opcode, const void* arg, unsigned nrArgs) {
+        return static_cast<int>(syscall(__NR_io_uring_register, fdAnillo, opcode, arg, nrArgs));
+    }
+
+    void iniciar(unsigned profundidad) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, profundidad, &p));
+        if (fd < 0) return;
+
+        tamSq = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        tamCq = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool unSoloMapeo = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (unSoloMapeo) {
+            tamSq = tamCq = std::max(tamSq, tamCq);
+        }
+        void* sq = mmap(NULL, tamSq, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq == MAP_FAILED) {
+            close(fd);
+            return;
+        }
+        void* cq = sq;
+        if (!unSoloMapeo) {
+            cq = mmap(NULL, tamCq, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cq == MAP_FAILED) {
+                munmap(sq, tamSq);
+                close(fd);
+                return;
+            }
+        }
+        tamSqes = p.sq_entries * sizeof(io_uring_sqe);
+        void* s = mmap(NULL, tamSqes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (s == MAP_FAILED) {
+            if (cq != sq) munmap(cq, tamCq);
+            munmap(sq, tamSq);
+            close(fd);
+            return;
+        }
+
+        fdAnillo = fd;
+        anilloSq = sq;
+        anilloCq = cq;
+        sqes = s;
+        entradas = p.sq_entries;
+        char* bsq = static_cast<char*>(sq);
+        char* bcq = static_cast<char*>(cq);
+        sqCabeza = reinterpret_cast<unsigned*>(bsq + p.sq_off.head);
+        sqCola = reinterpret_cast<unsigned*>(bsq + p.sq_off.tail);
+        sqMascara = *reinterpret_cast<unsigned*>(bsq + p.sq_off.ring_mask);
+        sqArreglo = reinterpret_cast<unsigned*>(bsq + p.sq_off.array);
+        cqCabeza = reinterpret_cast<unsigned*>(bcq + p.cq_off.head);
+        cqCola = reinterpret_cast<unsigned*>(bcq + p.cq_off.tail);
+        cqMascara = *reinterpret_cast<unsigned*>(bcq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(bcq + p.cq_off.cqes);
+        colaLocal = *sqCola;
+
+        if (!soportaOperaciones()) {
+            desactivar();
+            return;
+        }
+
+        // Tabla de archivos fijos vacia (-1): se llena por lote con
+        // IORING_REGISTER_FILES_UPDATE
+        std::vector<int> vacios(entradas, -1);
+        archivosFijos = registrar(IORING_REGISTER_FILES, &vacios[0], entradas) == 0;
+    }
+
+    // openat/close/read/write por io_uring requieren Linux 5.6
+    bool soportaOperaciones() {
+        const unsigned numOps = 256;
+        std::vector<char> memoria(sizeof(io_uring_probe) + numOps * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(&memoria[0]);
+        if (registrar(IORING_REGISTER_PROBE, probe, numOps) != 0) return false;
+        const unsigned necesarias[] = {IORING_OP_OPENAT, IORING_OP_CLOSE, IORING_OP_READ, IORING_OP_WRITE,
+                                       IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED};
+        for (size_t i = 0; i < sizeof(necesarias) / sizeof(necesarias[0]); ++i) {
+            unsigned op = necesarias[i];
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    void desactivar() {
+        munmap(sqes, tamSqes);
+        if (anilloCq != anilloSq) munmap(anilloCq, tamCq);
+        munmap(anilloSq, tamSq);
+        close(fdAnillo);
+        sqes = anilloSq = anilloCq = NULL;
+        fdAnillo = -1;
+    }
+
+    io_uring_sqe* siguienteSqe() {
+        unsigned indice = colaLocal & sqMascara;
+        io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes) + indice;
+        memset(sqe, 0, sizeof(*sqe));
+        sqArreglo[indice] = indice;
+        ++colaLocal;
+        return sqe;
+    }
+
+    // Publica los sqes preparados y espera `esperadas` completaciones;
+    // resultados[user_data] recibe el res de cada una
+    void enviarYEsperar(unsigned esperadas, std::vector<int>& resultados) {
+        unsigned aEnviar = colaLocal - *sqCola;
+        __atomic_store_n(sqCola, colaLocal, __ATOMIC_RELEASE);
+        unsigned completadas = 0;
+        while (completadas < esperadas) {
+            int r = static_cast<int>(syscall(__NR_io_uring_enter, fdAnillo, aEnviar, 1,
+                                             IORING_ENTER_GETEVENTS, NULL, 0));
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("io_uring_enter: ") + strerror(errno));
+            }
+            aEnviar -= std::min<unsigned>(aEnviar, static_cast<unsigned>(r));
+            unsigned cabeza = *cqCabeza;
+            unsigned cola = __atomic_load_n(cqCola, __ATOMIC_ACQUIRE);
+            for (; cabeza != cola; ++cabeza) {
+                const io_uring_cqe& cqe = cqes[cabeza & cqMascara];
+                resultados[cqe.user_data] = cqe.res;
+                ++completadas;
+            }
+            __atomic_store_n(cqCabeza, cabeza, __ATOMIC_RELEASE);
+        }
+    }
+
+    // Tres rondas por lote: abrir todos, transferir (reenviando las
+    // transferencias parciales) y cerrar todos
+    void procesarLote(std::vector<Transferencia>& lote, bool escribir) {
+        const unsigned n = static_cast<unsigned>(lote.size());
+        std::vector<int> res(n, 0);
+
+        // 1. openat de todo el lote
+        for (unsigned i = 0; i < n; ++i) {
+            io_uring_sqe* sqe = siguienteSqe();
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<unsigned long>(lote[i].nombre->c_str());
+            sqe->len = 0644;
+            sqe->open_flags = escribir ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+            sqe->user_data = i;
+        }
+        enviarYEsperar(n, res);
+        std::string error;
+        for (unsigned i = 0; i < n; ++i) {
+            if (res[i] < 0) {
+                if (error.empty()) error = std::string(escribir ? "No se pudo crear " : "No se pudo abrir ") +
+                                           *lote[i].nombre + ": " + strerror(-res[i]);
+                continue;
+            }
+            lote[i].fd = res[i];
+            if (!escribir) {
+                struct stat st;
+                if (fstat(lote[i].fd, &st) != 0) {
+                    if (error.empty()) error = std::string("No se pudo leer ") + *lote[i].nombre + ": " +
+                                               strerror(errno);
+                    continue;
+                }
+                lote[i].destino->resize(static_cast<size_t>(st.st_size));
+                lote[i].tamano = lote[i].destino->size();
+                lote[i].datos = lote[i].tamano > 0 ? &(*lote[i].destino)[0] : NULL;
+            }
+        }
+
+        if (error.empty()) {
+            transferir(lote, escribir, res, error);
+        }
+
+        // 3. close de todo lo abierto
+        unsigned abiertos = 0;
+        for (unsigned i = 0; i < n; ++i) {
+            if (lote[i].fd < 0) continue;
+            io_uring_sqe* sqe = siguienteSqe();
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = lote[i].fd;
+            sqe->user_data = i;
+            ++abiertos;
+        }
+        enviarYEsperar(abiertos, res);
+        if (!error.empty()) throw std::runtime_error(error);
+    }
+
+    void transferir(std::vector<Transferencia>& lote, bool escribir, std::vector<int>& res, std::string& error) {
+        const unsigned n = static_cast<unsigned>(lote.size());
+
+        // Archivos fijos: el kernel no busca el fd en la tabla del proceso
+        // en cada operacion
+        bool fijos = false;
+        if (archivosFijos) {
+            std::vector<int> fds(n);
+            for (unsigned i = 0; i < n; ++i) fds[i] = lote[i].fd;
+            io_uring_files_update act;
+            memset(&act, 0, sizeof(act));
+            act.offset = 0;
+            act.fds = reinterpret_cast<unsigned long>(&fds[0]);
+            fijos = registrar(IORING_REGISTER_FILES_UPDATE, &act, n) == static_cast<int>(n);
+        }
+
+        // Buffers registrados: las paginas quedan fijadas una vez por lote
+        // en vez de en cada operacion. Los buffers repetidos (todas las
+        // copias del mismo original) se registran una sola vez.
+        bool registrados = false;
+        if (buffersFijos) {
+            std::vector<iovec> iovs;
+            for (unsigned i = 0; i < n; ++i) {
+                if (lote[i].tamano == 0) continue;
+                for (size_t b = 0; b < iovs.size() && lote[i].buffer < 0; ++b) {
+                    if (iovs[b].iov_base == lote[i].datos && iovs[b].iov_len == lote[i].tamano) {
+                        lote[i].buffer = static_cast<int>(b);
+                    }
+                }
+                if (lote[i].buffer < 0) {
+                    iovec v;
+                    v.iov_base = lote[i].datos;
+                    v.iov_len = lote[i].tamano;
+                    lote[i].buffer = static_cast<int>(iovs.size());
+                    iovs.push_back(v);
+                }
+            }
+            if (!iovs.empty()) {
+                registrados = registrar(IORING_REGISTER_BUFFERS, &iovs[0], static_cast<unsigned>(iovs.size())) == 0;
+                // Sin memlock suficiente (kernels viejos) no se vuelve a intentar
+                if (!registrados) buffersFijos = false;
+            }
+        }
+
+        // 2. read/write hasta completar todos (las parciales se reenvian)
+        while (true) {
+            unsigned enVuelo = 0;
+            for (unsigned i = 0; i < n; ++i) {
+                Transferencia& t = lote[i];
+                if (t.hechos >= t.tamano) continue;
+                size_t resto = std::min<size_t>(t.tamano - t.hechos, 1u << 30);
+                io_uring_sqe* sqe = siguienteSqe();
+                if (registrados) {
+                    sqe->opcode = escribir ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+                    sqe->buf_index = static_cast<unsigned short>(t.buffer);
+                } else {
+                    sqe->opcode = escribir ? IORING_OP_WRITE : IORING_OP_READ;
+                }
+                if (fijos) {
+                    sqe->fd = static_cast<int>(i);
+                    sqe->flags = IOSQE_FIXED_FILE;
+                } else {
+                    sqe->fd = t.fd;
+                }
+                sqe->addr = reinterpret_cast<unsigned long>(t.datos + t.hechos);
+                sqe->len = static_cast<unsigned>(resto);
+                sqe->off = t.hechos;
+                sqe->user_data = i;
+                ++enVuelo;
+            }
+            if (enVuelo == 0) break;
+            for (unsigned i = 0; i < n; ++i) res[i] = 1;
+            enviarYEsperar(enVuelo, res);
+            for (unsigned i = 0; i < n; ++i) {
+                Transferencia& t = lote[i];
+                if (t.hechos >= t.tamano) continue;
+                if (res[i] == -EAGAIN || res[i] == -EINTR) continue;
+                if (res[i] < 0) {
+                    if (error.empty()) error = std::string(escribir ? "No se pudo escribir " : "No se pudo leer ") +
+                                               *t.nombre + ": " + strerror(-res[i]);
+                    t.hechos = t.tamano;
+                } else if (res[i] == 0) {
+                    // Fin de archivo antes de lo esperado (el archivo se acorto)
+                    if (!escribir) t.destino->resize(t.hechos);
+                    t.tamano = t.hechos;
+                } else {
+                    t.hechos += static_cast<size_t>(res[i]);
+                }
+            }
+        }
+
+        if (registrados) registrar(IORING_UNREGISTER_BUFFERS, NULL, 0);
+        if (fijos) {
+            std::vector<int> vacios(n, -1);
+            io_uring_files_update act;
+            memset(&act, 0, sizeof(act));
+            act.fds = reinterpret_cast<unsigned long>(&vacios[0]);
+            registrar(IORING_REGISTER_FILES_UPDATE, &act, n);
+        }
+    }
+#endif
+
+    MotorIoUring(const MotorIoUring&);
+    MotorIoUring& operator=(const MotorIoUring&);
+};
+
+#endif
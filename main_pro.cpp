@@ -7,238 +7,198 @@
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <cstdio>
 #include <ctime>
-#include <windows.h>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include "paginas_grandes.h"
+#include "plataforma.h"
+#include "topologia.h"
+#include "cifrado_simd.h"
+#include "cifrado_escalar.h"
+#include "sha256_multibuffer.h"
+#include "pool_hilos.h"
+#include "archivo_mapeado.h"
+#include "escritura_directa.h"
+#include "copia_archivos.h"
+#include "buffers_io.h"
+#include "arena.h"
+#include "salida_fragmentada.h"
+#include "arbol_merkle.h"
+#include "manifiesto.h"
+#include "contadores_hw.h"
+#include "traza_eventos.h"
+#include "medicion_etapas.h"
 
 using namespace std;
 
 // CONSTANTES
-static const size_t MAX_THREADS = 12;
 static const size_t MEGA_BUFFER_SIZE = 8 * 1024 * 1024;
 static const size_t WARMUP_ITERATIONS = 2;
 static const size_t BENCHMARK_RUNS = 3;
+// Bloque del modo fusionado: el bloque en curso (y su copia original)
+// caben en la L2, asi encriptar, hashear y escribir lo leen en caliente
+static const size_t BLOQUE_FUSION = 256 * 1024;
+// Trozo del .sha en árbol (--digest=merkle): igual al bloque fusionado para
+// que cada trozo entre en el bloque del hilo
+static const size_t TROZO_MERKLE = BLOQUE_FUSION;
+// Directorio del árbol de fragmentos con --escala
+static const char* const RAIZ_ESCALA = "copias";
 
-// TABLAS DE LOOKUP
-static const char TABLA_ENCRIPT_LOWER[256] = {
-    '\x00','\x01','\x02','\x03','\x04','\x05','\x06','\x07','\x08','\x09','\x0A','\x0B','\x0C','\x0D','\x0E','\x0F',
-    '\x10','\x11','\x12','\x13','\x14','\x15','\x16','\x17','\x18','\x19','\x1A','\x1B','\x1C','\x1D','\x1E','\x1F',
-    '\x20','\x21','\x22','\x23','\x24','\x25','\x26','\x27','\x28','\x29','\x2A','\x2B','\x2C','\x2D','\x2E','\x2F',
-    '9','8','7','6','5','4','3','2','1','0',
-    '\x3A','\x3B','\x3C','\x3D','\x3E','\x3F','\x40',
-    'D','E','F','G','H','I','J','K','L','M','N','O','P','Q','R','S','T','U','V','W','X','Y','Z','A','B','C',
-    '\x5B','\x5C','\x5D','\x5E','\x5F','\x60',
-    'd','e','f','g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v','w','x','y','z','a','b','c',
-    '\x7B','\x7C','\x7D','\x7E','\x7F','\x80','\x81','\x82','\x83','\x84','\x85','\x86','\x87','\x88','\x89','\x8A','\x8B','\x8C','\x8D','\x8E','\x8F',
-    '\x90','\x91','\x92','\x93','\x94','\x95','\x96','\x97','\x98','\x99','\x9A','\x9B','\x9C','\x9D','\x9E','\x9F',
-    '\xA0','\xA1','\xA2','\xA3','\xA4','\xA5','\xA6','\xA7','\xA8','\xA9','\xAA','\xAB','\xAC','\xAD','\xAE','\xAF',
-    '\xB0','\xB1','\xB2','\xB3','\xB4','\xB5','\xB6','\xB7','\xB8','\xB9','\xBA','\xBB','\xBC','\xBD','\xBE','\xBF',
-    '\xC0','\xC1','\xC2','\xC3','\xC4','\xC5','\xC6','\xC7','\xC8','\xC9','\xCA','\xCB','\xCC','\xCD','\xCE','\xCF',
-    '\xD0','\xD1','\xD2','\xD3','\xD4','\xD5','\xD6','\xD7','\xD8','\xD9','\xDA','\xDB','\xDC','\xDD','\xDE','\xDF',
-    '\xE0','\xE1','\xE2','\xE3','\xE4','\xE5','\xE6','\xE7','\xE8','\xE9','\xEA','\xEB','\xEC','\xED','\xEE','\xEF',
-    '\xF0','\xF1','\xF2','\xF3','\xF4','\xF5','\xF6','\xF7','\xF8','\xF9','\xFA','\xFB','\xFC','\xFD','\xFE','\xFF'
+// MODOS DE PROCESAMIENTO
+enum ModoProceso {
+    MODO_BASE,          // muchas operaciones de I/O, como el enunciado
+    MODO_OPTIMIZADO,    // todo en memoria, una pasada por etapa
+    MODO_FUSIONADO      // una sola pasada por bloques de BLOQUE_FUSION
 };
 
-static const char TABLA_DECRYPT_LOWER[256] = {
-    '\x00','\x01','\x02','\x03','\x04','\x05','\x06','\x07','\x08','\x09','\x0A','\x0B','\x0C','\x0D','\x0E','\x0F',
-    '\x10','\x11','\x12','\x13','\x14','\x15','\x16','\x17','\x18','\x19','\x1A','\x1B','\x1C','\x1D','\x1E','\x1F',
-    '\x20','\x21','\x22','\x23','\x24','\x25','\x26','\x27','\x28','\x29','\x2A','\x2B','\x2C','\x2D','\x2E','\x2F',
-    '9','8','7','6','5','4','3','2','1','0',
-    '\x3A','\x3B','\x3C','\x3D','\x3E','\x3F','\x40',
-    'X','Y','Z','A','B','C','D','E','F','G','H','I','J','K','L','M','N','O','P','Q','R','S','T','U','V','W',
-    '\x5B','\x5C','\x5D','\x5E','\x5F','\x60',
-    'x','y','z','a','b','c','d','e','f','g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v','w',
-    '\x7B','\x7C','\x7D','\x7E','\x7F','\x80','\x81','\x82','\x83','\x84','\x85','\x86','\x87','\x88','\x89','\x8A','\x8B','\x8C','\x8D','\x8E','\x8F',
-    '\x90','\x91','\x92','\x93','\x94','\x95','\x96','\x97','\x98','\x99','\x9A','\x9B','\x9C','\x9D','\x9E','\x9F',
-    '\xA0','\xA1','\xA2','\xA3','\xA4','\xA5','\xA6','\xA7','\xA8','\xA9','\xAA','\xAB','\xAC','\xAD','\xAE','\xAF',
-    '\xB0','\xB1','\xB2','\xB3','\xB4','\xB5','\xB6','\xB7','\xB8','\xB9','\xBA','\xBB','\xBC','\xBD','\xBE','\xBF',
-    '\xC0','\xC1','\xC2','\xC3','\xC4','\xC5','\xC6','\xC7','\xC8','\xC9','\xCA','\xCB','\xCC','\xCD','\xCE','\xCF',
-    '\xD0','\xD1','\xD2','\xD3','\xD4','\xD5','\xD6','\xD7','\xD8','\xD9','\xDA','\xDB','\xDC','\xDD','\xDE','\xDF',
-    '\xE0','\xE1','\xE2','\xE3','\xE4','\xE5','\xE6','\xE7','\xE8','\xE9','\xEA','\xEB','\xEC','\xED','\xEE','\xEF',
-    '\xF0','\xF1','\xF2','\xF3','\xF4','\xF5','\xF6','\xF7','\xF8','\xF9','\xFA','\xFB','\xFC','\xFD','\xFE','\xFF'
-};
-
-// SHA256 CONSTANTS
-static const unsigned long SHA256_K[64] = {
-    0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL, 0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
-    0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL, 0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL,
-    0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL, 0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
-    0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL, 0xc6e00bf3UL, 0xd5a79147UL, 0x06ca6351UL, 0x14292967UL,
-    0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL, 0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
-    0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL, 0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
-    0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL, 0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL, 0x682e6ff3UL,
-    0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL, 0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL
-};
+static const char* nombreModo(ModoProceso modo) {
+    switch (modo) {
+        case MODO_OPTIMIZADO: return "optimizado";
+        case MODO_FUSIONADO: return "fusionado";
+        default: return "base";
+    }
+}
 
-// ESTRUCTURA PARA DATOS DE THREAD
-struct ThreadData {
-    vector<int> archivos;
-    const char* originalData;
-    size_t originalSize;
-    vector<double> tiempos;
-    bool success;
-    string errorMsg;
-    bool optimizado;
+// ACCESO AL ARCHIVO ORIGINAL
+enum ModoOrigen {
+    ORIGEN_MEMORIA,     // entero en memoria (vector o mmap), como siempre
+    ORIGEN_FLUJO        // leído por bloques en cada pasada: memoria acotada
 };
 
 // VARIABLES GLOBALES
-static CRITICAL_SECTION g_cs;
-static bool g_csInitialized = false;
+static mutex g_mutexError;      // primer error de la ejecución
+static ModoEscritura g_modoEscritura = ESCRITURA_CACHE;   // --escritura=
 
-// CLASE PARA OPTIMIZACIÓN DEL SISTEMA
-class SystemOptimizer {
-public:
-    static void optimizeForPerformance() {
-        SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS);
-        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
-        
-        SYSTEM_INFO sysInfo;
-        GetSystemInfo(&sysInfo);
-        
-        DWORD_PTR processAffinityMask = (1ULL << sysInfo.dwNumberOfProcessors) - 1;
-        SetProcessAffinityMask(GetCurrentProcess(), processAffinityMask);
-    }
-    
-    static void warmupSystem() {
-        vector<char> dummyData(1024 * 1024, 'X');
-        
-        for (size_t i = 0; i < WARMUP_ITERATIONS; ++i) {
-            for (size_t j = 0; j < dummyData.size(); j += 64) {
-                dummyData[j] = TABLA_ENCRIPT_LOWER[dummyData[j]];
-            }
-            Sleep(10);
-        }
-    }
-};
+// CONTEO DE ASIGNACIONES
+// Compilando con -DCONTAR_ASIGNACIONES un operator new global cuenta las
+// reservas de cada hilo, para comprobar que el bucle por archivo ya no
+// toca el heap (ver procesarTarea) y mostrarlo en ALLOC. Las reservas
+// internas de la libc (fopen, etc.) no pasan por aquí. Sin la macro se
+// usa el operator new de siempre y asignacionesDelHilo() es 0.
+#ifdef CONTAR_ASIGNACIONES
+static const bool ASIGNACIONES_CONTADAS = true;
+static thread_local unsigned long long t_asignaciones = 0;
 
-// FUNCIONES AUXILIARES SHA256
-static unsigned long rotr(unsigned long x, int n) {
-    return (x >> n) | (x << (32 - n));
+static inline unsigned long long asignacionesDelHilo() {
+    return t_asignaciones;
 }
 
-static unsigned long ch(unsigned long x, unsigned long y, unsigned long z) {
-    return (x & y) ^ (~x & z);
+void* operator new(size_t bytes, const nothrow_t&) noexcept {
+    ++t_asignaciones;
+    return malloc(bytes > 0 ? bytes : 1);
 }
 
-static unsigned long maj(unsigned long x, unsigned long y, unsigned long z) {
-    return (x & y) ^ (x & z) ^ (y & z);
+void* operator new[](size_t bytes, const nothrow_t& nt) noexcept {
+    return operator new(bytes, nt);
 }
 
-static unsigned long sig0(unsigned long x) {
-    return rotr(x, 2) ^ rotr(x, 13) ^ rotr(x, 22);
+void* operator new(size_t bytes) {
+    void* p = operator new(bytes, nothrow);
+    if (p == NULL) {
+        throw bad_alloc();
+    }
+    return p;
 }
 
-static unsigned long sig1(unsigned long x) {
-    return rotr(x, 6) ^ rotr(x, 11) ^ rotr(x, 25);
+void* operator new[](size_t bytes) {
+    return operator new(bytes);
 }
 
-static unsigned long gamma0(unsigned long x) {
-    return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3);
+// Si GCC inlinea este free() en un ~vector pero no el new que le
+// corresponde, -Wmismatched-new-delete da un falso positivo
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept {
+    free(p);
 }
 
-static unsigned long gamma1(unsigned long x) {
-    return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10);
+void operator delete[](void* p) noexcept {
+    free(p);
 }
 
-// FUNCIONES DE ENCRIPTACIÓN
-static void encriptarInPlace(char* data, size_t len) {
-    size_t i = 0;
-    // Desenrollado de bucle para mayor velocidad
-    for (; i + 7 < len; i += 8) {
-        data[i] = TABLA_ENCRIPT_LOWER[static_cast<unsigned char>(data[i])];
-        data[i+1] = TABLA_ENCRIPT_LOWER[static_cast<unsigned char>(data[i+1])];
-        data[i+2] = TABLA_ENCRIPT_LOWER[static_cast<unsigned char>(data[i+2])];
-        data[i+3] = TABLA_ENCRIPT_LOWER[static_cast<unsigned char>(data[i+3])];
-        data[i+4] = TABLA_ENCRIPT_LOWER[static_cast<unsigned char>(data[i+4])];
-        data[i+5] = TABLA_ENCRIPT_LOWER[static_cast<unsigned char>(data[i+5])];
-        data[i+6] = TABLA_ENCRIPT_LOWER[static_cast<unsigned char>(data[i+6])];
-        data[i+7] = TABLA_ENCRIPT_LOWER[static_cast<unsigned char>(data[i+7])];
-    }
-    for (; i < len; ++i) {
-        data[i] = TABLA_ENCRIPT_LOWER[static_cast<unsigned char>(data[i])];
-    }
+void operator delete(void* p, size_t) noexcept {
+    free(p);
 }
 
-static void desencriptarInPlace(char* data, size_t len) {
-    size_t i = 0;
-    // Desenrollado de bucle para mayor velocidad
-    for (; i + 7 < len; i += 8) {
-        data[i] = TABLA_DECRYPT_LOWER[static_cast<unsigned char>(data[i])];
-        data[i+1] = TABLA_DECRYPT_LOWER[static_cast<unsigned char>(data[i+1])];
-        data[i+2] = TABLA_DECRYPT_LOWER[static_cast<unsigned char>(data[i+2])];
-        data[i+3] = TABLA_DECRYPT_LOWER[static_cast<unsigned char>(data[i+3])];
-        data[i+4] = TABLA_DECRYPT_LOWER[static_cast<unsigned char>(data[i+4])];
-        data[i+5] = TABLA_DECRYPT_LOWER[static_cast<unsigned char>(data[i+5])];
-        data[i+6] = TABLA_DECRYPT_LOWER[static_cast<unsigned char>(data[i+6])];
-        data[i+7] = TABLA_DECRYPT_LOWER[static_cast<unsigned char>(data[i+7])];
-    }
-    for (; i < len; ++i) {
-        data[i] = TABLA_DECRYPT_LOWER[static_cast<unsigned char>(data[i])];
-    }
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
 }
 
-// FUNCIÓN SHA256
-static string sha256Global(const char* data, size_t len) {
-    unsigned long h[8] = {
-        0x6a09e667UL, 0xbb67ae85UL, 0x3c6ef372UL, 0xa54ff53aUL,
-        0x510e527fUL, 0x9b05688cUL, 0x1f83d9abUL, 0x5be0cd19UL
-    };
-    
-    unsigned long long original_length_bits = static_cast<unsigned long long>(len) * 8;
-    size_t padded_len = len + 1;
-    while ((padded_len % 64) != 56) padded_len++;
-    padded_len += 8;
-    
-    vector<char> buffer(padded_len);
-    memcpy(&buffer[0], data, len);
-    buffer[len] = 0x80;
-    memset(&buffer[len + 1], 0, padded_len - len - 9);
-    
-    for (int i = 7; i >= 0; --i) {
-        buffer[padded_len - 8 + (7-i)] = (original_length_bits >> (i * 8)) & 0xFF;
+void operator delete(void* p, const nothrow_t&) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, const nothrow_t&) noexcept {
+    free(p);
+}
+#pragma GCC diagnostic pop
+#else
+static const bool ASIGNACIONES_CONTADAS = false;
+
+static inline unsigned long long asignacionesDelHilo() {
+    return 0;
+}
+#endif
+
+// CLASE PARA OPTIMIZACIÓN DEL SISTEMA
+class SystemOptimizer {
+public:
+    static void optimizeForPerformance() {
+        // Sin privilegios (nice negativo en POSIX) sigue con la de siempre
+        subirPrioridadProceso();
+        subirPrioridadHilo();
+        usarTodosLosProcesadores();
     }
     
-    for (size_t chunk = 0; chunk < padded_len; chunk += 64) {
-        unsigned long w[64];
-        
-        for (int i = 0; i < 16; ++i) {
-            w[i] = (static_cast<unsigned long>(buffer[chunk + i * 4]) << 24) |
-                   (static_cast<unsigned long>(buffer[chunk + i * 4 + 1]) << 16) |
-                   (static_cast<unsigned long>(buffer[chunk + i * 4 + 2]) << 8) |
-                   (static_cast<unsigned long>(buffer[chunk + i * 4 + 3]));
-        }
-        
-        for (int i = 16; i < 64; ++i) {
-            w[i] = gamma1(w[i - 2]) + w[i - 7] + gamma0(w[i - 15]) + w[i - 16];
-        }
-        
-        unsigned long a = h[0], b = h[1], c = h[2], d = h[3];
-        unsigned long e = h[4], f = h[5], g = h[6], h_var = h[7];
+    static void warmupSystem() {
+        vector<char> dummyData(1024 * 1024, 'X');
         
-        for (int i = 0; i < 64; ++i) {
-            unsigned long t1 = h_var + sig1(e) + ch(e, f, g) + SHA256_K[i] + w[i];
-            unsigned long t2 = sig0(a) + maj(a, b, c);
-            
-            h_var = g; g = f; f = e; e = d + t1;
-            d = c; c = b; b = a; a = t1 + t2;
+        for (size_t i = 0; i < WARMUP_ITERATIONS; ++i) {
+            for (size_t j = 0; j < dummyData.size(); j += 64) {
+                dummyData[j] = TABLA_ENCRIPT_BYTE[static_cast<unsigned char>(dummyData[j])];
+            }
+            dormirMs(10);
         }
-        
-        h[0] += a; h[1] += b; h[2] += c; h[3] += d;
-        h[4] += e; h[5] += f; h[6] += g; h[7] += h_var;
     }
-    
-    stringstream ss;
-    for (int i = 0; i < 8; ++i) {
-        ss << hex << setfill('0') << setw(8) << h[i];
+};
+
+// FUNCIONES DE ENCRIPTACIÓN
+static void encriptarInPlace(char* data, size_t len) {
+    KernelCifrado kernel = kernelsCifradoActivos().encriptar;
+    if (kernel != NULL) {
+        kernel(data, len);
+    } else {
+        encriptarInPlaceEscalar(data, len);
+    }
+}
+
+static void desencriptarInPlace(char* data, size_t len) {
+    KernelCifrado kernel = kernelsCifradoActivos().desencriptar;
+    if (kernel != NULL) {
+        kernel(data, len);
+    } else {
+        desencriptarInPlaceEscalar(data, len);
     }
-    
-    return ss.str();
 }
 
 // I/O BÁSICO (PROCESO BASE)
-static void writeFileBasic(const string& filename, const char* data, size_t size) {
-    ofstream file(filename.c_str(), ios::binary);
+// Los streams básicos leen y escriben el archivo entero en una llamada, que
+// pasa de largo el buffer del stream: en vez del que libstdc++ reserva en
+// cada open() (también con pubsetbuf(0, 0), de 1 byte) se les da uno chico
+// en la pila, instalado antes de abrir
+static const size_t TAM_BUFFER_STREAM_LOCAL = 1024;
+
+static void writeFileBasic(const char* filename, const char* data, size_t size) {
+    char bufferLocal[TAM_BUFFER_STREAM_LOCAL];
+    ofstream file;
+    file.rdbuf()->pubsetbuf(bufferLocal, sizeof(bufferLocal));
+    file.open(filename, ios::binary);
     if (!file.is_open()) {
-        throw runtime_error("Cannot create file: " + filename);
+        throw runtime_error(string("Cannot create file: ") + filename);
     }
     file.write(data, size);
     file.close();
@@ -261,36 +221,58 @@ static vector<char> readFileBasic(const string& filename) {
     return buffer;
 }
 
+// Igual que la anterior pero el contenido queda en la arena del hilo
+static char* readFileBasic(const char* filename, ArenaLineal& arena, size_t& size) {
+    char bufferLocal[TAM_BUFFER_STREAM_LOCAL];
+    ifstream file;
+    file.rdbuf()->pubsetbuf(bufferLocal, sizeof(bufferLocal));
+    file.open(filename, ios::binary);
+    if (!file.is_open()) {
+        throw runtime_error(string("Cannot open file: ") + filename);
+    }
+    
+    file.seekg(0, ios::end);
+    size = file.tellg();
+    file.seekg(0, ios::beg);
+    
+    char* buffer = arena.reservarChars(size);
+    file.read(buffer, size);
+    file.close();
+    
+    return buffer;
+}
+
 // I/O OPTIMIZADO (PROCESO OPTIMIZADO)
-static void writeFileOptimized(const string& filename, const char* data, size_t size) {
-    // Buffer grande para I/O optimizado
-    static char buffer[MEGA_BUFFER_SIZE];
+static void writeFileOptimized(const char* filename, const char* data, size_t size) {
+    // Escritura directa sin cache de páginas si se pidió y el sistema de
+    // archivos la admite
+    if (g_modoEscritura == ESCRITURA_DIRECTA && escribirArchivoDirecto(filename, data, size)) {
+        return;
+    }
     
-    ofstream file(filename.c_str(), ios::binary);
+    // Buffer grande para I/O optimizado: el del hilo (buffers_io.h). Se
+    // instala antes de abrir, después el stream lo ignora.
+    ofstream file;
+    file.rdbuf()->pubsetbuf(bufferIoDelHilo(), tamanoBufferIo());
+    file.open(filename, ios::binary);
     if (!file.is_open()) {
-        throw runtime_error("Cannot create file: " + filename);
+        throw runtime_error(string("Cannot create file: ") + filename);
     }
     
-    // Configurar buffer personalizado para mayor velocidad
-    file.rdbuf()->pubsetbuf(buffer, MEGA_BUFFER_SIZE);
-    
     // Escribir todo de una vez
     file.write(data, size);
     file.close();
 }
 
 static vector<char> readFileOptimized(const string& filename) {
-    // Buffer grande para I/O optimizado
-    static char buffer[MEGA_BUFFER_SIZE];
-    
-    ifstream file(filename.c_str(), ios::binary);
+    // Buffer grande para I/O optimizado (el del hilo, antes de abrir)
+    ifstream file;
+    file.rdbuf()->pubsetbuf(bufferIoDelHilo(), tamanoBufferIo());
+    file.open(filename.c_str(), ios::binary);
     if (!file.is_open()) {
         throw runtime_error("Cannot open file: " + filename);
     }
     
-    // Configurar buffer personalizado para mayor velocidad
-    file.rdbuf()->pubsetbuf(buffer, MEGA_BUFFER_SIZE);
-    
     file.seekg(0, ios::end);
     size_t size = file.tellg();
     file.seekg(0, ios::beg);
@@ -302,143 +284,1224 @@ static vector<char> readFileOptimized(const string& filename) {
     return result;
 }
 
-// FUNCIÓN DE THREAD
-static DWORD WINAPI ThreadProcesarArchivos(LPVOID lpParam) {
-    ThreadData* data = static_cast<ThreadData*>(lpParam);
-    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
+// Igual que la anterior pero en `destino` (--paginas=grandes); devuelve el
+// tamaño
+static size_t readFileOptimized(const string& filename, BloqueGrande& destino) {
+    ifstream file;
+    file.rdbuf()->pubsetbuf(bufferIoDelHilo(), tamanoBufferIo());
+    file.open(filename.c_str(), ios::binary);
+    if (!file.is_open()) {
+        throw runtime_error("Cannot open file: " + filename);
+    }
+    
+    file.seekg(0, ios::end);
+    size_t size = file.tellg();
+    file.seekg(0, ios::beg);
+    
+    file.read(destino.reservar(size), size);
+    file.close();
+    
+    return size;
+}
+
+// NOMBRES DE ARCHIVO
+// Se arman en arreglos fijos: un stringstream por nombre eran varias
+// asignaciones por archivo
+static const size_t TAM_NOMBRE_ARCHIVO = 32;
+
+static void nombreArchivo(char* destino, int numero, const char* sufijo) {
+    snprintf(destino, TAM_NOMBRE_ARCHIVO, "%d%s", numero, sufijo);
+}
+
+// LOTES DE ARCHIVOS PARA EL HASH MULTI-BUFFER
+// Sin SHA-NI, cada thread agrupa sus archivos en lotes del ancho del motor
+// multi-buffer (4/8/16 carriles) para que los hashes se calculen juntos.
+// Con SHA-NI el lote es de 1 archivo y el flujo es el de siempre.
+static const size_t LOTE_MAX_BYTES = 256 * 1024 * 1024;
+
+struct ArchivoEnLote {
+    int numero;
+    char filename[TAM_NOMBRE_ARCHIVO];
+    char outFile[TAM_NOMBRE_ARCHIVO];
+    char hashFile[TAM_NOMBRE_ARCHIVO];
+    ArchivoMapeado mapa;        // proceso base con mmap: N.txt compartido
+    ArchivoMapeado mapa2;       // proceso base con mmap: N.txt copia privada
+    char* cifrado;              // en la arena del hilo o en mapa
+    size_t tamCifrado;
+    char* releido;              // proceso base: en la arena o en mapa2
+    size_t tamReleido;
+    uint8_t digest[32];         // plano: el del archivo; merkle: la raíz
+    uint8_t* hojas;             // --digest=merkle: una por trozo, en la arena
+    size_t numTrozos;
+    uint8_t digestEsperado[32]; // el del .sha (base) o el calculado (optimizado)
+    FormatoDigest formatoEsperado;  // el del .sha, que puede ser cualquiera
+    uint8_t* hojasEsperadas;
+    size_t trozoEsperado;
+    size_t numTrozosEsperados;
+    bool hashLeido;             // el .sha se pudo interpretar
+    uint8_t digestValidacion[32];
+    uint8_t* hojasValidacion;   // numTrozosEsperados, en la arena
+    double tiempo;
+};
+
+// AGREGADO DE TIEMPOS EN STREAMING
+// Cantidad, suma, mínimo, máximo y varianza (Welford) sin guardar cada
+// tiempo: con --escala la memoria no crece con el número de copias
+struct AgregadoTiempos {
+    unsigned long long n;
+    double suma;
+    double minimo;
+    double maximo;
+    double media;
+    double m2;              // suma de cuadrados de las diferencias a la media
+    
+    AgregadoTiempos() : n(0), suma(0.0), minimo(0.0), maximo(0.0), media(0.0), m2(0.0) {}
+    
+    void agregar(double ms) {
+        ++n;
+        suma += ms;
+        minimo = (n == 1 || ms < minimo) ? ms : minimo;
+        maximo = (n == 1 || ms > maximo) ? ms : maximo;
+        double delta = ms - media;
+        media += delta / n;
+        m2 += delta * (ms - media);
+    }
+    
+    // Combina los agregados de dos hilos (Chan et al.)
+    void combinar(const AgregadoTiempos& otro) {
+        if (otro.n == 0) return;
+        if (n == 0) {
+            *this = otro;
+            return;
+        }
+        unsigned long long total = n + otro.n;
+        double delta = otro.media - media;
+        m2 += otro.m2 + delta * delta * (static_cast<double>(n) * otro.n / total);
+        media += delta * otro.n / total;
+        suma += otro.suma;
+        minimo = min(minimo, otro.minimo);
+        maximo = max(maximo, otro.maximo);
+        n = total;
+    }
+    
+    double desviacion() const {
+        return n > 1 ? sqrt(m2 / (n - 1)) : 0.0;
+    }
+};
+
+// ESTADO POR HILO DEL POOL: se reutiliza entre tareas y entre modos, así
+// después del primer archivo de cada hilo el bucle no reserva memoria
+struct EstadoHilo {
+    vector<ArchivoEnLote> lote;
+    vector<char> bloque;            // modo fusionado
+    vector<char> bloqueOrigen;      // --origen=flujo: bloque leído del original
+    ArenaLineal arena;              // buffers de un lote, se vacía al terminarlo
+    PlanificadorHashes planificador;
+    AgregadoTiempos tiempos;        // de los archivos de esta ejecución
+    vector<RegistroManifiesto> registros;   // --sha=manifiesto: aún sin escribir
+    // Régimen estable de esta ejecución (ver procesarTarea)
+    size_t mayorTarea;              // archivos de la tarea más grande ya hecha
+    unsigned long long asignaciones;
+    unsigned long long archivosEstables;
     
+    EstadoHilo() : mayorTarea(0), asignaciones(0), archivosEstables(0) {}
+};
+
+// DATOS COMPARTIDOS POR LAS TAREAS DE UNA EJECUCIÓN
+struct DatosEjecucion {
+    const char* originalData;
+    size_t originalSize;
+    ModoProceso modo;
+    ModoLectura lectura;
+    ModoCopia copia;
+    ModoOrigen origen;              // con ORIGEN_FLUJO originalData es NULL
+    const ReplicasNuma* replicas;   // --colocacion con varios nodos: el original en cada uno
+    FormatoDigest digest;           // formato del .sha que se escribe
+    Manifiesto* manifiesto;         // --sha=manifiesto; NULL: un .sha por archivo
+    const string* archivoOriginal;  // origen de las copias del kernel
+    int numCopias;
+    vector<double> tiempos;         // por número de archivo - 1 (vacío con --escala)
+    vector<EstadoHilo>* estados;    // uno por hilo del pool
+    const SalidaFragmentada* salida;        // --escala: árbol de fragmentos
+    atomic<long long> siguienteArchivo;     // --escala: próximo número a procesar
+    bool success;
+    string errorMsg;
+};
+
+// El original desde el hilo que llama: la copia de su nodo NUMA si la hay
+static const char* originalDelHilo(const DatosEjecucion* data) {
+    const char* local = data->replicas != NULL ? data->replicas->deNodo(nodoNumaDelHilo()) : NULL;
+    return local != NULL ? local : data->originalData;
+}
+
+// Estado del hilo que llama. Sus bloques se reservan la primera vez desde
+// el propio hilo: con --colocacion las páginas quedan en su nodo NUMA
+static EstadoHilo& estadoDelHilo(const DatosEjecucion* data) {
+    EstadoHilo& estado = (*data->estados)[PoolHilos::indiceHiloActual()];
+    if (estado.bloque.empty()) {
+        estado.bloque.resize(BLOQUE_FUSION);
+    }
+    if (data->origen == ORIGEN_FLUJO && estado.bloqueOrigen.empty()) {
+        estado.bloqueOrigen.resize(BLOQUE_FUSION);
+    }
+    if (data->manifiesto != NULL && estado.registros.capacity() < REGISTROS_POR_ESCRITURA) {
+        estado.registros.reserve(REGISTROS_POR_ESCRITURA);
+    }
+    return estado;
+}
+
+static size_t anchoLoteHash(size_t originalSize) {
+    size_t ancho = motorSha256Multiple().carriles;
+    // Limitar la memoria retenida por el lote en archivos grandes
+    while (ancho > 1 && ancho * originalSize * 2 > LOTE_MAX_BYTES) {
+        ancho /= 2;
+    }
+    return ancho;
+}
+
+static double msTranscurridos(int64_t inicio) {
+    return static_cast<double>(marcaTiempo() - inicio) * 1000.0 / frecuenciaReloj();
+}
+
+// 1. Generar la copia N.txt: desde el original en memoria o, con
+// --copia=kernel, copiada por el kernel desde el archivo original
+static void escribirCopia(const DatosEjecucion* data, const char* filename) {
+    if (data->copia == COPIA_KERNEL) {
+        copiarArchivo(data->archivoOriginal->c_str(), filename);
+    } else if (data->modo == MODO_BASE) {
+        writeFileBasic(filename, originalDelHilo(data), data->originalSize);
+    } else {
+        writeFileOptimized(filename, originalDelHilo(data), data->originalSize);
+    }
+}
+
+static void escribirTextoHash(const DatosEjecucion* data, const char* hashFile, const char* texto, size_t tamano) {
+    if (data->modo == MODO_BASE) {
+        writeFileBasic(hashFile, texto, tamano);
+    } else {
+        writeFileOptimized(hashFile, texto, tamano);
+    }
+}
+
+// Escribe el .sha: el digest pasa a hex solo aquí
+static void escribirHash(const DatosEjecucion* data, const char* hashFile, const uint8_t digest[32]) {
+    char hex[65];
+    digestAHex(digest, hex);
+    escribirTextoHash(data, hashFile, hex, 64);
+}
+
+// --sha=manifiesto: el registro queda en el lote del hilo, que se escribe
+// al llenarse (y al final de la ejecución)
+static unsigned long long vaciarManifiesto(const DatosEjecucion* data, EstadoHilo& estado) {
+    unsigned long long desplazamiento = data->manifiesto->agregar(estado.registros.data(), estado.registros.size());
+    estado.registros.clear();
+    return desplazamiento;
+}
+
+static void anotarEnManifiesto(const DatosEjecucion* data, EstadoHilo& estado, int numero, size_t tamano,
+                               const uint8_t digest[32]) {
+    estado.registros.push_back(registroManifiesto(numero, tamano, digest));
+    if (estado.registros.size() >= REGISTROS_POR_ESCRITURA) {
+        vaciarManifiesto(data, estado);
+    }
+}
+
+static uint8_t* reservarHojas(ArenaLineal& arena, size_t numTrozos) {
+    return static_cast<uint8_t*>(arena.reservar(32 * numTrozos));
+}
+
+// .sha en árbol de un archivo del lote: la raíz queda en a.digest
+static void escribirHashMerkle(const DatosEjecucion* data, ArenaLineal& arena, ArchivoEnLote& a) {
+    uint8_t* nodos = reservarHojas(arena, a.numTrozos);
+    memcpy(nodos, a.hojas, 32 * a.numTrozos);
+    raizMerkle(nodos, a.numTrozos, a.digest);
+    char* texto = arena.reservarChars(tamanoShaMerkle(a.numTrozos));
+    size_t tamano = escribirShaMerkle(texto, TROZO_MERKLE, a.tamCifrado, a.digest, a.hojas, a.numTrozos);
+    escribirTextoHash(data, a.hashFile, texto, tamano);
+}
+
+// PROCESO FUSIONADO
+// Encriptar + hash + escribir en una sola pasada por bloques: cada bloque
+// se copia del original, se encripta, se pasa al SHA-256 incremental y se
+// escribe mientras sigue en cache. La validación hace lo mismo al revés:
+// lee el encriptado por bloques, lo hashea, lo desencripta, lo escribe y
+// lo compara con el original. Si el hash no coincide se borra la salida.
+static void procesarArchivoFusionado(const DatosEjecucion* data, int numeroArchivo, EstadoHilo& estado) {
+    vector<char>& bloque = estado.bloque;
+    char filename[TAM_NOMBRE_ARCHIVO];
+    char outFile[TAM_NOMBRE_ARCHIVO];
+    char hashFile[TAM_NOMBRE_ARCHIVO];
+    nombreArchivo(filename, numeroArchivo, ".txt");
+    nombreArchivo(outFile, numeroArchivo, "_2.txt");
+    nombreArchivo(hashFile, numeroArchivo, ".sha");
+    CronometroEtapas crono;
+    
+    // 1. Escribir archivo original (la copia)
+    escribirCopia(data, filename);
+    crono.marcar(ETAPA_COPIA);
+    
+    // 2. Encriptar + hash + escribir por bloques
+    Sha256 ctx;
+    {
+        // Bloques más grandes que el buffer: cada uno va directo al sistema
+        char bufferLocal[TAM_BUFFER_STREAM_LOCAL];
+        ofstream out;
+        out.rdbuf()->pubsetbuf(bufferLocal, sizeof(bufferLocal));
+        out.open(filename, ios::binary);
+        if (!out.is_open()) {
+            throw runtime_error(string("Cannot create file: ") + filename);
+        }
+        
+        for (size_t pos = 0; pos < data->originalSize; pos += BLOQUE_FUSION) {
+            size_t n = min(BLOQUE_FUSION, data->originalSize - pos);
+            memcpy(&bloque[0], originalDelHilo(data) + pos, n);
+            encriptarInPlace(&bloque[0], n);
+            crono.marcar(ETAPA_ENCRIPTAR);
+            ctx.update(&bloque[0], n);
+            crono.marcar(ETAPA_HASH);
+            out.write(&bloque[0], n);
+            crono.marcar(ETAPA_ESCRIBIR_CIFRADO);
+        }
+        if (!out) {
+            throw runtime_error(string("Cannot write file: ") + filename);
+        }
+    }
+    crono.marcar(ETAPA_ESCRIBIR_CIFRADO);
+    
+    // 3. Escribir hash
+    uint8_t digest[32];
+    ctx.final(digest);
+    crono.marcar(ETAPA_HASH);
+    if (data->manifiesto != NULL) {
+        anotarEnManifiesto(data, estado, numeroArchivo, data->originalSize, digest);
+    } else {
+        escribirHash(data, hashFile, digest);
+    }
+    crono.marcar(ETAPA_ESCRIBIR_SHA);
+    
+    // 4. Validar + desencriptar + escribir + comparar por bloques
+    bool iguales = true;
+    {
+        // Con mmap el hash lee las páginas mapeadas y solo se copia el
+        // bloque que se va a desencriptar
+        const bool mapeado = (data->lectura != LECTURA_STREAM);
+        ArchivoMapeado mapa;
+        char bufferEntrada[TAM_BUFFER_STREAM_LOCAL];
+        char bufferSalida[TAM_BUFFER_STREAM_LOCAL];
+        ifstream in;
+        if (mapeado) {
+            mapa.abrir(filename, MAPEO_LECTURA, data->lectura);
+        } else {
+            in.rdbuf()->pubsetbuf(bufferEntrada, sizeof(bufferEntrada));
+            in.open(filename, ios::binary);
+            if (!in.is_open()) {
+                throw runtime_error(string("Cannot open file: ") + filename);
+            }
+        }
+        ofstream out;
+        out.rdbuf()->pubsetbuf(bufferSalida, sizeof(bufferSalida));
+        out.open(outFile, ios::binary);
+        if (!out.is_open()) {
+            throw runtime_error(string("Cannot create file: ") + outFile);
+        }
+        crono.marcar(ETAPA_LEER);
+        
+        size_t pos = 0;
+        while (true) {
+            size_t n;
+            if (mapeado) {
+                n = min(BLOQUE_FUSION, mapa.tamano() - pos);
+                if (n == 0) break;
+                ctx.update(mapa.datos() + pos, n);
+                crono.marcar(ETAPA_VALIDAR);
+                memcpy(&bloque[0], mapa.datos() + pos, n);
+                crono.marcar(ETAPA_LEER);
+            } else {
+                in.read(&bloque[0], BLOQUE_FUSION);
+                n = static_cast<size_t>(in.gcount());
+                crono.marcar(ETAPA_LEER);
+                if (n == 0) break;
+                ctx.update(&bloque[0], n);
+                crono.marcar(ETAPA_VALIDAR);
+            }
+            desencriptarInPlace(&bloque[0], n);
+            crono.marcar(ETAPA_DESENCRIPTAR);
+            out.write(&bloque[0], n);
+            crono.marcar(ETAPA_ESCRIBIR_SALIDA);
+            iguales = iguales && pos + n <= data->originalSize &&
+                      memcmp(&bloque[0], originalDelHilo(data) + pos, n) == 0;
+            crono.marcar(ETAPA_COMPARAR);
+            pos += n;
+        }
+        iguales = iguales && pos == data->originalSize;
+    }
+    crono.marcar(ETAPA_ESCRIBIR_SALIDA);
+    
+    uint8_t digestValidacion[32];
+    ctx.final(digestValidacion);
+    crono.marcar(ETAPA_VALIDAR);
+    if (memcmp(digestValidacion, digest, 32) != 0) {
+        remove(outFile);
+        throw runtime_error("Hash invalido");
+    }
+    if (!iguales) {
+        // Validación fallida: el desencriptado no coincide con el original
+        throw runtime_error("Desencriptado distinto del original");
+    }
+}
+
+// Guarda el primer error de la ejecución (las tareas corren en paralelo)
+static void registrarError(DatosEjecucion* data, int numeroArchivo, const string& mensaje) {
+    {
+        lock_guard<mutex> lock(g_mutexError);
+        if (data->success) {
+            data->success = false;
+            data->errorMsg = "Error processing file " + to_string(numeroArchivo) + ": " + mensaje;
+        }
+    }
+    // Con --escala los hilos dejan de tomar archivos
+    data->siguienteArchivo = static_cast<long long>(data->numCopias) + 1;
+}
+
+// PROCESO POR DESCRIPTORES (--escala y --origen=flujo)
+// El mismo flujo del fusionado, por bloques de BLOQUE_FUSION, pero sobre
+// descriptores: con --escala se abren con openat en el fragmento de cada
+// archivo y con --origen=flujo el original también se lee bloque a bloque
+// en vez de estar entero en memoria. La memoria por archivo en vuelo es
+// solo el bloque del hilo (y el del original con --origen=flujo).
+static void rutaSalida(const DatosEjecucion* data, int numero, const char* sufijo, char* destino, size_t capacidad) {
+    if (data->salida != NULL) {
+        data->salida->ruta(destino, capacidad, numero, sufijo);
+    } else {
+        snprintf(destino, capacidad, "%d%s", numero, sufijo);
+    }
+}
+
+static string rutaSalida(const DatosEjecucion* data, int numero, const char* sufijo) {
+    char ruta[TAM_RUTA_FRAGMENTADA];
+    rutaSalida(data, numero, sufijo, ruta, sizeof(ruta));
+    return ruta;
+}
+
+static int abrirSalida(const DatosEjecucion* data, int numero, const char* sufijo, int flags) {
+    if (data->salida != NULL) {
+        return data->salida->abrir(numero, sufijo, flags);
+    }
+    char ruta[TAM_NOMBRE_ARCHIVO];
+    nombreArchivo(ruta, numero, sufijo);
+    int fd = abrirArchivoFd(ruta, flags);
+    if (fd < 0) {
+        throw runtime_error(string("Cannot open file: ") + ruta);
+    }
+    return fd;
+}
+
+static void borrarSalida(const DatosEjecucion* data, int numero, const char* sufijo) {
+    if (data->salida != NULL) {
+        data->salida->borrar(numero, sufijo);
+    } else {
+        char ruta[TAM_NOMBRE_ARCHIVO];
+        nombreArchivo(ruta, numero, sufijo);
+        remove(ruta);
+    }
+}
+
+// Bloque [pos, pos + n) del original: en memoria, o el siguiente bloque
+// leído de `fdOrigen` (las pasadas lo recorren en orden desde el inicio)
+static const char* bloqueOriginal(const DatosEjecucion* data, int fdOrigen, size_t pos, size_t n, char* destino) {
+    if (data->origen == ORIGEN_MEMORIA) {
+        return originalDelHilo(data) + pos;
+    }
+    if (leerCompletoFd(fdOrigen, destino, n) != n) {
+        throw runtime_error("Cannot read file: " + *data->archivoOriginal);
+    }
+    return destino;
+}
+
+static int abrirOriginal(const DatosEjecucion* data) {
+    int fd = abrirArchivoFd(data->archivoOriginal->c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Cannot open file: " + *data->archivoOriginal);
+    }
+    return fd;
+}
+
+// Descriptores de un archivo en proceso, cerrados también si hay excepción
+struct DescriptoresArchivo {
+    int original, cifrado, salida;
+    
+    DescriptoresArchivo() : original(-1), cifrado(-1), salida(-1) {}
+    ~DescriptoresArchivo() {
+        if (original >= 0) cerrarFd(original);
+        if (cifrado >= 0) cerrarFd(cifrado);
+        if (salida >= 0) cerrarFd(salida);
+    }
+};
+
+// Copia N.txt (por ruta si la hace el kernel); deja fds.cifrado abierto
+static void escribirCopiaDescriptores(const DatosEjecucion* data, int numeroArchivo, DescriptoresArchivo& fds,
+                                      char* bloqueOrigen) {
+    const size_t tamano = data->originalSize;
+    if (data->copia == COPIA_KERNEL) {
+        char ruta[TAM_RUTA_FRAGMENTADA];
+        rutaSalida(data, numeroArchivo, ".txt", ruta, sizeof(ruta));
+        copiarArchivo(data->archivoOriginal->c_str(), ruta);
+        fds.cifrado = abrirSalida(data, numeroArchivo, ".txt", O_RDWR);
+    } else {
+        fds.cifrado = abrirSalida(data, numeroArchivo, ".txt", O_RDWR | O_CREAT | O_TRUNC);
+        bool ok = true;
+        for (size_t pos = 0; ok && pos < tamano; pos += BLOQUE_FUSION) {
+            size_t n = min(BLOQUE_FUSION, tamano - pos);
+            ok = escribirCompletoFd(fds.cifrado, bloqueOriginal(data, fds.original, pos, n, bloqueOrigen), n);
+        }
+        if (!ok) {
+            throw runtime_error("Cannot write file: " + rutaSalida(data, numeroArchivo, ".txt"));
+        }
+    }
+}
+
+static void procesarArchivoDescriptores(const DatosEjecucion* data, int numeroArchivo, EstadoHilo& estado) {
+    char* bloque = &estado.bloque[0];
+    char* bloqueOrigen = estado.bloqueOrigen.empty() ? NULL : &estado.bloqueOrigen[0];
+    const size_t tamano = data->originalSize;
+    CronometroEtapas crono;
+    DescriptoresArchivo fds;
+    if (data->origen == ORIGEN_FLUJO) {
+        fds.original = abrirOriginal(data);
+    }
+    
+    // 1. Copia N.txt
+    escribirCopiaDescriptores(data, numeroArchivo, fds, bloqueOrigen);
+    crono.marcar(ETAPA_COPIA);
+    
+    // 2. Encriptar + hash + reescribir por bloques
+    Sha256 ctx;
+    bool ok = rebobinarFd(fds.cifrado) && (fds.original < 0 || rebobinarFd(fds.original));
+    for (size_t pos = 0; ok && pos < tamano; pos += BLOQUE_FUSION) {
+        size_t n = min(BLOQUE_FUSION, tamano - pos);
+        memcpy(bloque, bloqueOriginal(data, fds.original, pos, n, bloqueOrigen), n);
+        encriptarInPlace(bloque, n);
+        crono.marcar(ETAPA_ENCRIPTAR);
+        ctx.update(bloque, n);
+        crono.marcar(ETAPA_HASH);
+        ok = escribirCompletoFd(fds.cifrado, bloque, n);
+        crono.marcar(ETAPA_ESCRIBIR_CIFRADO);
+    }
+    if (!ok) {
+        throw runtime_error("Cannot write file: " + rutaSalida(data, numeroArchivo, ".txt"));
+    }
+    
+    // 3. Escribir hash
+    uint8_t digest[32];
+    ctx.final(digest);
+    crono.marcar(ETAPA_HASH);
+    if (data->manifiesto != NULL) {
+        anotarEnManifiesto(data, estado, numeroArchivo, tamano, digest);
+    } else {
+        char hex[65];
+        digestAHex(digest, hex);
+        int fdHash = abrirSalida(data, numeroArchivo, ".sha", O_WRONLY | O_CREAT | O_TRUNC);
+        ok = escribirCompletoFd(fdHash, hex, 64);
+        cerrarFd(fdHash);
+        if (!ok) {
+            throw runtime_error("Cannot write file: " + rutaSalida(data, numeroArchivo, ".sha"));
+        }
+    }
+    crono.marcar(ETAPA_ESCRIBIR_SHA);
+    
+    // 4. Releer + hash + desencriptar + escribir N_2.txt + comparar
+    fds.salida = abrirSalida(data, numeroArchivo, "_2.txt", O_WRONLY | O_CREAT | O_TRUNC);
+    crono.marcar(ETAPA_ESCRIBIR_SALIDA);
+    bool iguales = true;
+    size_t pos = 0;
+    ok = rebobinarFd(fds.cifrado) && (fds.original < 0 || rebobinarFd(fds.original));
+    while (ok) {
+        size_t n = leerCompletoFd(fds.cifrado, bloque, BLOQUE_FUSION);
+        crono.marcar(ETAPA_LEER);
+        if (n == 0) break;
+        ctx.update(bloque, n);
+        crono.marcar(ETAPA_VALIDAR);
+        desencriptarInPlace(bloque, n);
+        crono.marcar(ETAPA_DESENCRIPTAR);
+        ok = escribirCompletoFd(fds.salida, bloque, n);
+        crono.marcar(ETAPA_ESCRIBIR_SALIDA);
+        iguales = iguales && pos + n <= tamano &&
+                  memcmp(bloque, bloqueOriginal(data, fds.original, pos, n, bloqueOrigen), n) == 0;
+        crono.marcar(ETAPA_COMPARAR);
+        pos += n;
+    }
+    if (!ok) {
+        throw runtime_error("Cannot write file: " + rutaSalida(data, numeroArchivo, "_2.txt"));
+    }
+    
+    uint8_t digestValidacion[32];
+    ctx.final(digestValidacion);
+    crono.marcar(ETAPA_VALIDAR);
+    if (memcmp(digestValidacion, digest, 32) != 0) {
+        // Como en el fusionado en memoria: no queda un N_2.txt de un
+        // cifrado que no valido
+        cerrarFd(fds.salida);
+        fds.salida = -1;
+        borrarSalida(data, numeroArchivo, "_2.txt");
+        throw runtime_error("Hash invalido");
+    }
+    if (!iguales || pos != tamano) {
+        throw runtime_error("Desencriptado distinto del original");
+    }
+}
+
+// Cada hilo toma el siguiente número de un contador compartido en vez de
+// encolar una tarea por archivo: la cola no crece con las copias
+static void procesarTareaDescriptores(DatosEjecucion* data) {
+    EstadoHilo& estado = estadoDelHilo(data);
+    int64_t start;
+    while (true) {
+        long long numero = data->siguienteArchivo++;
+        if (numero > data->numCopias) break;
+        TramoTraza tramo("archivo", static_cast<int>(numero));
+        
+        const unsigned long long asignacionesAntes = asignacionesDelHilo();
+        start = marcaTiempo();
+        try {
+            procesarArchivoDescriptores(data, static_cast<int>(numero), estado);
+        } catch (const exception& e) {
+            registrarError(data, static_cast<int>(numero), e.what());
+            return;
+        }
+        double tiempo = msTranscurridos(start);
+        if (!data->tiempos.empty()) {
+            data->tiempos[numero - 1] = tiempo;
+        }
+        estado.tiempos.agregar(tiempo);
+        
+        if (estado.mayorTarea > 0) {
+            estado.asignaciones += asignacionesDelHilo() - asignacionesAntes;
+            ++estado.archivosEstables;
+        } else {
+            estado.mayorTarea = 1;
+        }
+    }
+}
+
+// PROCESO FUSIONADO CON ÁRBOL (--digest=merkle)
+// Con el .sha en árbol los trozos de un archivo son independientes: cada
+// fase encola una tarea por trozo (o por archivo) y un solo archivo grande
+// se reparte entre todos los hilos del pool. Las fases, separadas por
+// pool.esperar(), son:
+//   1. copia N.txt (por archivo)
+//   2. encriptar + hoja + escribir en su posición (por trozo)
+//   3. raíz, escribir el .sha, releerlo y crear N_2.txt (por archivo)
+//   4. releer + hoja + comparar con la del .sha y, si coincide,
+//      desencriptar + escribir en N_2.txt + comparar (por trozo)
+//   5. nombrar el primer trozo dañado y comprobar la raíz (por archivo)
+// El tiempo de un archivo es la suma del de sus tareas.
+struct ArchivoMerkle {
+    int numero;
+    size_t numTrozos;
+    vector<uint8_t> hojas;              // fase 2
+    vector<uint8_t> hojasEsperadas;     // las del .sha releído
+    vector<uint8_t> hojasValidacion;    // fase 4
+    uint8_t raizEsperada[32];
+    atomic<size_t> trozoInvalido;       // el menor con hoja distinta; numTrozos si ninguno
+    atomic<bool> distinto;              // algún trozo desencriptado difiere del original
+    atomic<long long> ticks;            // de marcaTiempo(), de todas sus tareas
+    
+    ArchivoMerkle() : numero(0), numTrozos(0), trozoInvalido(0), distinto(false), ticks(0) {}
+};
+
+static void sumarTiempo(ArchivoMerkle* archivo, int64_t inicio) {
+    archivo->ticks += marcaTiempo() - inicio;
+}
+
+// Trozo [pos, pos + n) del original: en memoria o, con --origen=flujo,
+// leído con un descriptor propio (los trozos no van en orden)
+static const char* trozoOriginal(const DatosEjecucion* data, size_t pos, size_t n, char* destino) {
+    if (data->origen == ORIGEN_MEMORIA) {
+        return originalDelHilo(data) + pos;
+    }
+    int fd = abrirOriginal(data);
+    bool ok = posicionarFd(fd, pos) && leerCompletoFd(fd, destino, n) == n;
+    cerrarFd(fd);
+    if (!ok) {
+        throw runtime_error("Cannot read file: " + *data->archivoOriginal);
+    }
+    return destino;
+}
+
+static void escribirTrozo(const DatosEjecucion* data, int numero, const char* sufijo, size_t pos,
+                          const char* datos, size_t n) {
+    int fd = abrirSalida(data, numero, sufijo, O_WRONLY);
+    bool ok = posicionarFd(fd, pos) && escribirCompletoFd(fd, datos, n);
+    cerrarFd(fd);
+    if (!ok) {
+        throw runtime_error("Cannot write file: " + rutaSalida(data, numero, sufijo));
+    }
+}
+
+// Fase 1
+static void copiarArchivoMerkle(DatosEjecucion* data, ArchivoMerkle* archivo) {
+    int64_t inicio = marcaTiempo();
+    EstadoHilo& estado = estadoDelHilo(data);
+    TramoTraza tramo("archivo", archivo->numero);
+    CronometroEtapas crono;
     try {
-        data->tiempos.clear();
-        data->tiempos.reserve(data->archivos.size());
+        DescriptoresArchivo fds;
+        if (data->origen == ORIGEN_FLUJO) {
+            fds.original = abrirOriginal(data);
+        }
+        escribirCopiaDescriptores(data, archivo->numero, fds,
+                                  estado.bloqueOrigen.empty() ? NULL : &estado.bloqueOrigen[0]);
+        crono.marcar(ETAPA_COPIA);
+    } catch (const exception& e) {
+        registrarError(data, archivo->numero, e.what());
+    }
+    sumarTiempo(archivo, inicio);
+}
+
+// Fase 2
+static void cifrarTrozoMerkle(DatosEjecucion* data, ArchivoMerkle* archivo, size_t trozo) {
+    int64_t inicio = marcaTiempo();
+    EstadoHilo& estado = estadoDelHilo(data);
+    TramoTraza tramo("archivo", archivo->numero);
+    CronometroEtapas crono;
+    try {
+        char* bloque = &estado.bloque[0];
+        size_t pos = trozo * TROZO_MERKLE;
+        size_t n = min(TROZO_MERKLE, data->originalSize - pos);
+        memcpy(bloque, trozoOriginal(data, pos, n, estado.bloqueOrigen.empty() ? NULL : &estado.bloqueOrigen[0]), n);
+        encriptarInPlace(bloque, n);
+        crono.marcar(ETAPA_ENCRIPTAR);
+        hojaMerkle(bloque, n, &archivo->hojas[32 * trozo]);
+        crono.marcar(ETAPA_HASH);
+        escribirTrozo(data, archivo->numero, ".txt", pos, bloque, n);
+        crono.marcar(ETAPA_ESCRIBIR_CIFRADO);
+    } catch (const exception& e) {
+        registrarError(data, archivo->numero, e.what());
+    }
+    sumarTiempo(archivo, inicio);
+}
+
+// Fase 3: la validación parte del .sha que quedó en disco
+static void escribirArbolMerkle(DatosEjecucion* data, ArchivoMerkle* archivo) {
+    int64_t inicio = marcaTiempo();
+    TramoTraza tramo("archivo", archivo->numero);
+    CronometroEtapas crono;
+    try {
+        const int numero = archivo->numero;
+        vector<uint8_t> nodos(archivo->hojas);
+        uint8_t raiz[32];
+        raizMerkle(&nodos[0], archivo->numTrozos, raiz);
+        string texto(tamanoShaMerkle(archivo->numTrozos), '\0');
+        texto.resize(escribirShaMerkle(&texto[0], TROZO_MERKLE, data->originalSize, raiz, &archivo->hojas[0],
+                                       archivo->numTrozos));
+        int fd = abrirSalida(data, numero, ".sha", O_WRONLY | O_CREAT | O_TRUNC);
+        bool ok = escribirCompletoFd(fd, texto.data(), texto.size());
+        cerrarFd(fd);
+        if (!ok) {
+            throw runtime_error("Cannot write file: " + rutaSalida(data, numero, ".sha"));
+        }
+        crono.marcar(ETAPA_ESCRIBIR_SHA);
+        
+        fd = abrirSalida(data, numero, ".sha", O_RDONLY);
+        size_t leidos = leerCompletoFd(fd, &texto[0], texto.size());
+        cerrarFd(fd);
+        ShaLeido sha;
+        if (!parsearSha(texto.data(), leidos, sha) || sha.formato != DIGEST_MERKLE || sha.trozo != TROZO_MERKLE ||
+            sha.tamano != data->originalSize || !hojasSha(sha, &archivo->hojasEsperadas[0])) {
+            throw runtime_error("Hash invalido: .sha ilegible");
+        }
+        memcpy(archivo->raizEsperada, sha.raiz, 32);
+        crono.marcar(ETAPA_LEER_SHA);
         
-        // Pre-allocar buffers para optimización
-        vector<char> workBuffer;
-        vector<char> hashBuffer;
-        string hashString;
+        cerrarFd(abrirSalida(data, numero, "_2.txt", O_WRONLY | O_CREAT | O_TRUNC));
+        crono.marcar(ETAPA_ESCRIBIR_SALIDA);
+    } catch (const exception& e) {
+        registrarError(data, archivo->numero, e.what());
+    }
+    sumarTiempo(archivo, inicio);
+}
+
+// Fase 4
+static void validarTrozoMerkle(DatosEjecucion* data, ArchivoMerkle* archivo, size_t trozo) {
+    int64_t inicio = marcaTiempo();
+    EstadoHilo& estado = estadoDelHilo(data);
+    TramoTraza tramo("archivo", archivo->numero);
+    CronometroEtapas crono;
+    try {
+        const int numero = archivo->numero;
+        char* bloque = &estado.bloque[0];
+        size_t pos = trozo * TROZO_MERKLE;
+        size_t n = min(TROZO_MERKLE, data->originalSize - pos);
+        int fd = abrirSalida(data, numero, ".txt", O_RDONLY);
+        bool ok = posicionarFd(fd, pos) && leerCompletoFd(fd, bloque, n) == n;
+        cerrarFd(fd);
+        if (!ok) {
+            throw runtime_error("Cannot read file: " + rutaSalida(data, numero, ".txt"));
+        }
+        crono.marcar(ETAPA_LEER);
         
-        if (data->optimizado) {
-            workBuffer.reserve(data->originalSize * 2);
-            hashBuffer.reserve(64);
-            hashString.reserve(64);
+        uint8_t* hoja = &archivo->hojasValidacion[32 * trozo];
+        hojaMerkle(bloque, n, hoja);
+        crono.marcar(ETAPA_VALIDAR);
+        if (memcmp(hoja, &archivo->hojasEsperadas[32 * trozo], 32) != 0) {
+            // Se guarda el menor trozo dañado
+            size_t actual = archivo->trozoInvalido;
+            while (trozo < actual && !archivo->trozoInvalido.compare_exchange_weak(actual, trozo)) {
+            }
+        } else {
+            desencriptarInPlace(bloque, n);
+            crono.marcar(ETAPA_DESENCRIPTAR);
+            escribirTrozo(data, numero, "_2.txt", pos, bloque, n);
+            crono.marcar(ETAPA_ESCRIBIR_SALIDA);
+            const char* original =
+                trozoOriginal(data, pos, n, estado.bloqueOrigen.empty() ? NULL : &estado.bloqueOrigen[0]);
+            if (memcmp(bloque, original, n) != 0) {
+                archivo->distinto = true;
+            }
+            crono.marcar(ETAPA_COMPARAR);
+        }
+    } catch (const exception& e) {
+        registrarError(data, archivo->numero, e.what());
+    }
+    sumarTiempo(archivo, inicio);
+}
+
+// Fase 5
+static void cerrarArchivoMerkle(DatosEjecucion* data, ArchivoMerkle* archivo) {
+    int64_t inicio = marcaTiempo();
+    EstadoHilo& estado = estadoDelHilo(data);
+    TramoTraza tramo("archivo", archivo->numero);
+    CronometroEtapas crono;
+    try {
+        const int numero = archivo->numero;
+        size_t malo = archivo->trozoInvalido;
+        if (malo < archivo->numTrozos) {
+            remove(rutaSalida(data, numero, "_2.txt").c_str());
+            throw runtime_error("Hash invalido en el " + describirTrozoMerkle(malo, TROZO_MERKLE, data->originalSize));
+        }
+        vector<uint8_t> nodos(archivo->hojasValidacion);
+        uint8_t raiz[32];
+        raizMerkle(&nodos[0], archivo->numTrozos, raiz);
+        crono.marcar(ETAPA_VALIDAR);
+        if (memcmp(raiz, archivo->raizEsperada, 32) != 0) {
+            remove(rutaSalida(data, numero, "_2.txt").c_str());
+            throw runtime_error("Hash invalido: raiz del arbol distinta");
+        }
+        if (archivo->distinto) {
+            throw runtime_error("Desencriptado distinto del original");
+        }
+    } catch (const exception& e) {
+        registrarError(data, archivo->numero, e.what());
+    }
+    sumarTiempo(archivo, inicio);
+    double tiempo = static_cast<double>(archivo->ticks) * 1000.0 / frecuenciaReloj();
+    if (!data->tiempos.empty()) {
+        data->tiempos[archivo->numero - 1] = tiempo;
+    }
+    estado.tiempos.agregar(tiempo);
+}
+
+// LOTE DE ARCHIVOS (PROCESOS BASE Y OPTIMIZADO)
+// Todo lo que vive solo mientras dura el lote (contenidos, relecturas,
+// el .sha leído) sale de la arena del hilo, que se vacía al terminar
+
+// Encola el hash de validación de `datos`: el del archivo entero o, si el
+// .sha esperado es un árbol, el de cada trozo
+static void agregarValidacion(PlanificadorHashes& planificador, ArenaLineal& arena, ArchivoEnLote& a,
+                              const char* datos, size_t tamano) {
+    if (a.formatoEsperado == DIGEST_MERKLE) {
+        a.hojasValidacion = reservarHojas(arena, a.numTrozosEsperados);
+        agregarHojasMerkle(planificador, datos, tamano, a.trozoEsperado, a.hojasValidacion);
+    } else {
+        planificador.agregar(datos, tamano, a.digestValidacion);
+    }
+}
+
+// Compara el hash de validación con el esperado. Con árbol un trozo
+// distinto es un error que lo nombra; si todas las hojas coinciden se
+// comprueba además la raíz (la del .sha podría estar alterada).
+static bool validarHashLote(const ArchivoEnLote& a, ArenaLineal& arena, size_t tamano) {
+    if (a.formatoEsperado == DIGEST_PLANO) {
+        return memcmp(a.digestValidacion, a.digestEsperado, 32) == 0;
+    }
+    size_t malo = primerTrozoDistinto(a.hojasValidacion, a.hojasEsperadas, a.numTrozosEsperados);
+    if (malo < a.numTrozosEsperados) {
+        throw runtime_error("Hash invalido en el " + describirTrozoMerkle(malo, a.trozoEsperado, tamano));
+    }
+    uint8_t* nodos = reservarHojas(arena, a.numTrozosEsperados);
+    memcpy(nodos, a.hojasValidacion, 32 * a.numTrozosEsperados);
+    uint8_t raiz[32];
+    raizMerkle(nodos, a.numTrozosEsperados, raiz);
+    if (memcmp(raiz, a.digestEsperado, 32) != 0) {
+        throw runtime_error("Hash invalido: raiz del arbol distinta");
+    }
+    return true;
+}
+
+// Hash esperado desde el .sha del archivo, plano o árbol según lo que tenga
+static void leerHashArchivo(ArenaLineal& arena, ArchivoEnLote& a) {
+    size_t tamHash = 0;
+    const char* texto = readFileBasic(a.hashFile, arena, tamHash);
+    ShaLeido sha;
+    a.hashLeido = parsearSha(texto, tamHash, sha);
+    a.formatoEsperado = sha.formato;
+    memcpy(a.digestEsperado, sha.raiz, 32);
+    if (sha.formato == DIGEST_MERKLE) {
+        a.hashLeido = a.hashLeido && sha.tamano == a.tamReleido;
+        if (a.hashLeido) {
+            a.trozoEsperado = sha.trozo;
+            a.numTrozosEsperados = sha.numTrozos;
+            a.hojasEsperadas = reservarHojas(arena, sha.numTrozos);
+            a.hashLeido = hojasSha(sha, a.hojasEsperadas);
         }
+    }
+}
+
+// Hash esperado desde el registro del manifiesto mapeado
+static void leerHashManifiesto(const ManifiestoMapeado& manifiesto, unsigned long long desplazamiento,
+                               ArchivoEnLote& a) {
+    const RegistroManifiesto* registro = manifiesto.registroEn(desplazamiento);
+    a.formatoEsperado = DIGEST_PLANO;
+    a.hashLeido = registro != NULL && registro->numero == static_cast<uint64_t>(a.numero) &&
+                  registro->tamano == a.tamReleido;
+    if (a.hashLeido) {
+        memcpy(a.digestEsperado, registro->digest, 32);
+    }
+}
+
+static void procesarLote(DatosEjecucion* data, EstadoHilo& estado, int primero, size_t cantidad) {
+    int64_t start;
+    const bool optimizado = (data->modo == MODO_OPTIMIZADO);
+    const bool mapeado = (data->lectura != LECTURA_STREAM);
+    const bool merkle = (data->digest == DIGEST_MERKLE);
+    
+    if (estado.lote.size() < cantidad) {
+        estado.lote.resize(cantidad);
+    }
+    vector<ArchivoEnLote>& lote = estado.lote;
+    ArenaLineal& arena = estado.arena;
+    PlanificadorHashes& planificador = estado.planificador;
+    CronometroEtapas crono;
+    
+    // ETAPA 1: escribir original, encriptar y escribir encriptado
+    for (size_t k = 0; k < cantidad; ++k) {
+        ArchivoEnLote& a = lote[k];
+        a.numero = primero + static_cast<int>(k);
+        start = marcaTiempo();
+        
+        nombreArchivo(a.filename, a.numero, ".txt");
+        nombreArchivo(a.outFile, a.numero, "_2.txt");
+        nombreArchivo(a.hashFile, a.numero, ".sha");
+        crono.reiniciar();
         
-        for (size_t idx = 0; idx < data->archivos.size(); ++idx) {
-            int numeroArchivo = data->archivos[idx];
+        if (optimizado) {
+            // PROCESO OPTIMIZADO - TODO EN MEMORIA
+            // 1. Escribir archivo original (optimizado)
+            escribirCopia(data, a.filename);
+            crono.marcar(ETAPA_COPIA);
             
-            LARGE_INTEGER freq, start, end;
-            QueryPerformanceFrequency(&freq);
-            QueryPerformanceCounter(&start);
+            // 2. Procesar en memoria (sin leer archivo)
+            a.cifrado = arena.reservarChars(data->originalSize);
+            a.tamCifrado = data->originalSize;
+            memcpy(a.cifrado, originalDelHilo(data), a.tamCifrado);
+            encriptarInPlace(a.cifrado, a.tamCifrado);
+            crono.marcar(ETAPA_ENCRIPTAR);
             
-            try {
-                if (data->optimizado) {
-                    // PROCESO OPTIMIZADO - TODO EN MEMORIA
-                    stringstream ss1, ss2, ss3;
-                    ss1 << numeroArchivo << ".txt";
-                    ss2 << numeroArchivo << "2.txt";
-                    ss3 << numeroArchivo << ".sha";
-                    
-                    string filename = ss1.str();
-                    string outFile = ss2.str();
-                    string hashFile = ss3.str();
-                    
-                    // 1. Escribir archivo original (optimizado)
-                    writeFileOptimized(filename, data->originalData, data->originalSize);
-                    
-                    // 2. Procesar en memoria (sin leer archivo)
-                    workBuffer.assign(data->originalData, data->originalData + data->originalSize);
-                    encriptarInPlace(&workBuffer[0], workBuffer.size());
-                    
-                    // 3. Escribir encriptado y hash (optimizado)
-                    writeFileOptimized(filename, &workBuffer[0], workBuffer.size());
-                    
-                    hashString = sha256Global(&workBuffer[0], workBuffer.size());
-                    writeFileOptimized(hashFile, hashString.c_str(), hashString.size());
-                    
-                    // 4. Validar hash (en memoria)
-                    string calculatedHash = sha256Global(&workBuffer[0], workBuffer.size());
-                    
-                    if (calculatedHash == hashString) {
-                        // 5. Desencriptar (en memoria)
-                        desencriptarInPlace(&workBuffer[0], workBuffer.size());
-                        writeFileOptimized(outFile, &workBuffer[0], workBuffer.size());
-                        
-                        // 6. Validación final (en memoria - sin leer archivo)
-                        if (workBuffer.size() == data->originalSize && 
-                            memcmp(&workBuffer[0], data->originalData, workBuffer.size()) == 0) {
-                            // Validación exitosa
-                        }
+            // 3. Escribir encriptado (optimizado)
+            writeFileOptimized(a.filename, a.cifrado, a.tamCifrado);
+            crono.marcar(ETAPA_ESCRIBIR_CIFRADO);
+        } else {
+            // PROCESO BASE - MUCHAS OPERACIONES DE I/O
+            // 1. Escribir archivo original
+            escribirCopia(data, a.filename);
+            crono.marcar(ETAPA_COPIA);
+            
+            if (mapeado) {
+                // 2-4. Mapear el archivo compartido y encriptar sus páginas:
+                // el encriptado llega al archivo sin read() ni write()
+                a.mapa.abrir(a.filename, MAPEO_COMPARTIDO, data->lectura);
+                a.cifrado = a.mapa.datos();
+                a.tamCifrado = a.mapa.tamano();
+                crono.marcar(ETAPA_LEER);
+                encriptarInPlace(a.cifrado, a.tamCifrado);
+                crono.marcar(ETAPA_ENCRIPTAR);
+            } else {
+                // 2. Leer archivo
+                a.cifrado = readFileBasic(a.filename, arena, a.tamCifrado);
+                crono.marcar(ETAPA_LEER);
+                
+                // 3. Encriptar
+                encriptarInPlace(a.cifrado, a.tamCifrado);
+                crono.marcar(ETAPA_ENCRIPTAR);
+                
+                // 4. Escribir encriptado
+                writeFileBasic(a.filename, a.cifrado, a.tamCifrado);
+                crono.marcar(ETAPA_ESCRIBIR_CIFRADO);
+            }
+        }
+        
+        a.tiempo = msTranscurridos(start);
+        if (merkle) {
+            // Las hojas de todo el lote van juntas al motor multi-buffer
+            a.numTrozos = numTrozosMerkle(a.tamCifrado, TROZO_MERKLE);
+            a.hojas = reservarHojas(arena, a.numTrozos);
+            agregarHojasMerkle(planificador, a.cifrado, a.tamCifrado, TROZO_MERKLE, a.hojas);
+        } else {
+            planificador.agregar(a.cifrado, a.tamCifrado, a.digest);
+        }
+    }
+    
+    // ETAPA 2: hash del lote (el tiempo se reparte entre sus archivos)
+    start = marcaTiempo();
+    crono.reiniciar();
+    planificador.ejecutar();
+    crono.marcar(ETAPA_HASH);
+    
+    // Con manifiesto los hashes del lote se agregan de una vez; el proceso
+    // base los escribe ya y los relee del manifiesto mapeado
+    unsigned long long desplazamiento = 0;
+    ManifiestoMapeado manifiestoLeido;
+    if (data->manifiesto != NULL) {
+        for (size_t k = 0; k < cantidad; ++k) {
+            anotarEnManifiesto(data, estado, lote[k].numero, lote[k].tamCifrado, lote[k].digest);
+        }
+        if (!optimizado) {
+            desplazamiento = vaciarManifiesto(data, estado);
+        }
+        crono.marcar(ETAPA_ESCRIBIR_SHA);
+        if (!optimizado) {
+            manifiestoLeido.abrir(data->manifiesto->ruta());
+            crono.marcar(ETAPA_LEER_SHA);
+        }
+    }
+    double tiempoHash = msTranscurridos(start) / cantidad;
+    
+    // ETAPA 3: escribir hash y preparar la validación
+    for (size_t k = 0; k < cantidad; ++k) {
+        ArchivoEnLote& a = lote[k];
+        start = marcaTiempo();
+        crono.reiniciar();
+        
+        // 5. Escribir hash
+        if (merkle) {
+            escribirHashMerkle(data, arena, a);
+        } else if (data->manifiesto == NULL) {
+            escribirHash(data, a.hashFile, a.digest);
+        }
+        crono.marcar(ETAPA_ESCRIBIR_SHA);
+        if (optimizado) {
+            // 4. Validar hash (en memoria)
+            memcpy(a.digestEsperado, a.digest, 32);
+            a.formatoEsperado = data->digest;
+            a.hojasEsperadas = a.hojas;
+            a.trozoEsperado = TROZO_MERKLE;
+            a.numTrozosEsperados = a.numTrozos;
+            a.hashLeido = true;
+            agregarValidacion(planificador, arena, a, a.cifrado, a.tamCifrado);
+            crono.marcar(ETAPA_VALIDAR);
+        } else {
+            // 6. Leer archivo encriptado (con mmap: copia privada, así el
+            // desencriptado no modifica N.txt)
+            if (mapeado) {
+                a.mapa.cerrar();
+                a.mapa2.abrir(a.filename, MAPEO_COPIA_PRIVADA, data->lectura);
+                a.releido = a.mapa2.datos();
+                a.tamReleido = a.mapa2.tamano();
+            } else {
+                a.releido = readFileBasic(a.filename, arena, a.tamReleido);
+            }
+            crono.marcar(ETAPA_LEER);
+            
+            // 7. Leer hash
+            if (data->manifiesto != NULL) {
+                leerHashManifiesto(manifiestoLeido, desplazamiento + k * sizeof(RegistroManifiesto), a);
+            } else {
+                leerHashArchivo(arena, a);
+            }
+            crono.marcar(ETAPA_LEER_SHA);
+            
+            if (a.hashLeido || a.formatoEsperado == DIGEST_PLANO) {
+                agregarValidacion(planificador, arena, a, a.releido, a.tamReleido);
+            }
+            crono.marcar(ETAPA_VALIDAR);
+        }
+        
+        a.tiempo += tiempoHash + msTranscurridos(start);
+    }
+    
+    // ETAPA 4: hash de validación del lote
+    start = marcaTiempo();
+    crono.reiniciar();
+    planificador.ejecutar();
+    crono.marcar(ETAPA_VALIDAR);
+    tiempoHash = msTranscurridos(start) / cantidad;
+    
+    // ETAPA 5: validar, desencriptar, escribir y comparar con el original
+    for (size_t k = 0; k < cantidad; ++k) {
+        ArchivoEnLote& a = lote[k];
+        start = marcaTiempo();
+        crono.reiniciar();
+        
+        bool hashValido = a.hashLeido && validarHashLote(a, arena, optimizado ? a.tamCifrado : a.tamReleido);
+        crono.marcar(ETAPA_VALIDAR);
+        
+        if (optimizado) {
+            if (hashValido) {
+                // 5. Desencriptar (en memoria)
+                desencriptarInPlace(a.cifrado, a.tamCifrado);
+                crono.marcar(ETAPA_DESENCRIPTAR);
+                writeFileOptimized(a.outFile, a.cifrado, a.tamCifrado);
+                crono.marcar(ETAPA_ESCRIBIR_SALIDA);
+                
+                // 6. Validación final (en memoria - sin leer archivo)
+                if (a.tamCifrado == data->originalSize && 
+                    memcmp(a.cifrado, originalDelHilo(data), a.tamCifrado) == 0) {
+                    // Validación exitosa
+                }
+                crono.marcar(ETAPA_COMPARAR);
+            }
+        } else {
+            // 8. Validar hash
+            if (hashValido) {
+                // 9. Desencriptar
+                desencriptarInPlace(a.releido, a.tamReleido);
+                crono.marcar(ETAPA_DESENCRIPTAR);
+                
+                // 10. Escribir desencriptado
+                writeFileBasic(a.outFile, a.releido, a.tamReleido);
+                crono.marcar(ETAPA_ESCRIBIR_SALIDA);
+                
+                // 11. Leer archivo final y 12. validar con original
+                if (mapeado) {
+                    ArchivoMapeado final;
+                    final.abrir(a.outFile, MAPEO_LECTURA, data->lectura);
+                    crono.marcar(ETAPA_LEER);
+                    if (final.tamano() == data->originalSize && 
+                        memcmp(final.datos(), originalDelHilo(data), final.tamano()) == 0) {
+                        // Validación exitosa
                     }
-                    
                 } else {
-                    // PROCESO BASE - MUCHAS OPERACIONES DE I/O
-                    stringstream ss1, ss2, ss3;
-                    ss1 << numeroArchivo << ".txt";
-                    ss2 << numeroArchivo << "2.txt";
-                    ss3 << numeroArchivo << ".sha";
-                    
-                    string filename = ss1.str();
-                    string outFile = ss2.str();
-                    string hashFile = ss3.str();
-                    
-                    // 1. Escribir archivo original
-                    writeFileBasic(filename, data->originalData, data->originalSize);
-                    
-                    // 2. Leer archivo
-                    vector<char> buffer = readFileBasic(filename);
-                    
-                    // 3. Encriptar
-                    encriptarInPlace(&buffer[0], buffer.size());
-                    
-                    // 4. Escribir encriptado
-                    writeFileBasic(filename, &buffer[0], buffer.size());
-                    
-                    // 5. Generar hash
-                    string hash = sha256Global(&buffer[0], buffer.size());
-                    writeFileBasic(hashFile, hash.c_str(), hash.size());
-                    
-                    // 6. Leer archivo encriptado
-                    vector<char> buffer2 = readFileBasic(filename);
-                    
-                    // 7. Leer hash
-                    vector<char> hashBuffer = readFileBasic(hashFile);
-                    string expectedHash(hashBuffer.begin(), hashBuffer.end());
-                    
-                    // 8. Validar hash
-                    string calculatedHash = sha256Global(&buffer2[0], buffer2.size());
-                    
-                    if (calculatedHash == expectedHash) {
-                        // 9. Desencriptar
-                        desencriptarInPlace(&buffer2[0], buffer2.size());
-                        
-                        // 10. Escribir desencriptado
-                        writeFileBasic(outFile, &buffer2[0], buffer2.size());
-                        
-                        // 11. Leer archivo final
-                        vector<char> finalBuffer = readFileBasic(outFile);
-                        
-                        // 12. Validar con original
-                        if (finalBuffer.size() == data->originalSize && 
-                            memcmp(&finalBuffer[0], data->originalData, finalBuffer.size()) == 0) {
-                            // Validación exitosa
-                        }
+                    size_t tamFinal = 0;
+                    const char* finalBuffer = readFileBasic(a.outFile, arena, tamFinal);
+                    crono.marcar(ETAPA_LEER);
+                    if (tamFinal == data->originalSize && 
+                        memcmp(finalBuffer, originalDelHilo(data), tamFinal) == 0) {
+                        // Validación exitosa
                     }
                 }
-                
-            } catch (const exception& e) {
-                throw runtime_error("Error processing file " + to_string(numeroArchivo) + ": " + e.what());
+                crono.marcar(ETAPA_COMPARAR);
             }
-            
-            QueryPerformanceCounter(&end);
-            double tiempo = static_cast<double>(end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart;
-            data->tiempos.push_back(tiempo);
+            a.mapa2.cerrar();
         }
         
-        data->success = true;
-    } catch (const exception& e) {
-        data->success = false;
-        data->errorMsg = e.what();
+        a.tiempo += tiempoHash + msTranscurridos(start);
+        data->tiempos[a.numero - 1] = a.tiempo;
+        estado.tiempos.agregar(a.tiempo);
     }
-    return 0;
+}
+
+// TAREA DEL POOL: archivos consecutivos [primero, primero + cantidad)
+// Con SHA-NI o en modo fusionado cada tarea es un solo archivo; sin SHA-NI
+// es un lote del ancho del motor multi-buffer.
+static void procesarTarea(DatosEjecucion* data, int primero, size_t cantidad) {
+    EstadoHilo& estado = estadoDelHilo(data);
+    const unsigned long long asignacionesAntes = asignacionesDelHilo();
+    
+    if (data->modo == MODO_FUSIONADO) {
+        int64_t start;
+        for (size_t k = 0; k < cantidad; ++k) {
+            int numeroArchivo = primero + static_cast<int>(k);
+            TramoTraza tramo("archivo", numeroArchivo);
+            start = marcaTiempo();
+            try {
+                procesarArchivoFusionado(data, numeroArchivo, estado);
+            } catch (const exception& e) {
+                registrarError(data, numeroArchivo, e.what());
+                return;
+            }
+            double tiempo = msTranscurridos(start);
+            data->tiempos[numeroArchivo - 1] = tiempo;
+            estado.tiempos.agregar(tiempo);
+        }
+    } else {
+        TramoTraza tramo(cantidad == 1 ? "archivo" : "lote", primero, primero + static_cast<int>(cantidad) - 1);
+        try {
+            procesarLote(data, estado, primero, cantidad);
+        } catch (const exception& e) {
+            registrarError(data, primero, e.what());
+        }
+        estado.arena.reiniciar();
+    }
+    
+    // Una tarea más grande que las anteriores del hilo todavía dimensiona
+    // sus buffers; las demás son régimen estable y no deberían reservar
+    if (cantidad <= estado.mayorTarea) {
+        estado.asignaciones += asignacionesDelHilo() - asignacionesAntes;
+        estado.archivosEstables += cantidad;
+    } else {
+        estado.mayorTarea = cantidad;
+    }
+}
+
+// ESTADÍSTICAS DEL BENCHMARK (--bench)
+// Resumen de un conjunto de muestras; los percentiles son por rango
+// (el menor valor con al menos p% de las muestras por debajo o igual)
+struct ResumenMuestras {
+    size_t n;
+    double minimo;
+    double mediana;
+    double p95;
+    double p99;
+    double maximo;
+    double media;
+    double desviacion;
+};
+
+static double percentilOrdenado(const vector<double>& ordenadas, double p) {
+    size_t rango = static_cast<size_t>(ceil(p / 100.0 * ordenadas.size()));
+    return ordenadas[rango > 0 ? rango - 1 : 0];
+}
+
+static ResumenMuestras resumirMuestras(vector<double> muestras) {
+    ResumenMuestras r = ResumenMuestras();
+    r.n = muestras.size();
+    if (muestras.empty()) return r;
+    sort(muestras.begin(), muestras.end());
+    const size_t n = muestras.size();
+    r.minimo = muestras.front();
+    r.maximo = muestras.back();
+    r.mediana = (n % 2 != 0) ? muestras[n / 2] : (muestras[n / 2 - 1] + muestras[n / 2]) / 2.0;
+    r.p95 = percentilOrdenado(muestras, 95.0);
+    r.p99 = percentilOrdenado(muestras, 99.0);
+    AgregadoTiempos agregado;
+    for (size_t i = 0; i < n; ++i) {
+        agregado.agregar(muestras[i]);
+    }
+    r.media = agregado.media;
+    r.desviacion = agregado.desviacion();
+    return r;
+}
+
+// Una configuración medida: modo x copias x threads
+struct ResultadoBench {
+    ModoProceso modo;
+    int copias;
+    size_t hilos;
+    int repeticiones;
+    int calentamiento;
+    size_t bytesPorCopia;
+    ResumenMuestras porArchivo;     // todos los archivos de las repeticiones medidas
+    ResumenMuestras total;          // TT de cada repetición
+    ResumenMuestras megasPorSegundo;    // THR de cada repetición
+};
+
+// Configuración de cada hilo del pool al arrancar
+static void prepararHiloTrabajador(size_t indice) {
+    // Primero la CPU: lo que el hilo reserve después queda en su nodo
+    fijarHiloTrabajador(indice);
+    subirPrioridadHilo();
+    nombrarHiloTraza("trabajador " + to_string(indice));
+    iniciarContadoresHilo();
 }
 
 // CLASE PRINCIPAL
@@ -446,6 +1509,21 @@ class OptimizedFileProcessor {
 private:
     string archivoOriginal;
     int numCopias;
+    ModoLectura lectura;
+    ModoCopia copia;
+    bool escala;                    // --escala: sin límite de copias, salida fragmentada
+    ModoOrigen origen;
+    FormatoDigest digest;           // --digest: .sha plano o en árbol
+    bool conManifiesto;             // --sha=manifiesto
+    PoolHilos pool;
+    vector<EstadoHilo> estados;     // uno por hilo del pool, vive entre modos
+    unique_ptr<SalidaFragmentada> salida;   // --escala, durante cada ejecución
+    unique_ptr<Manifiesto> manifiesto;      // --sha=manifiesto, durante cada ejecución
+    // Con MEDIR_ETAPAS: el desglose por etapa de cada modo ejecutado
+    vector<string> titulosEtapas;
+    vector<HistogramasEtapas> etapasPorModo;
+    LecturaContadoresHw contadoresHw;   // --contadores: los de la última ejecución
+    EstadisticasPaginas paginas;        // --paginas=grandes: al final de la última ejecución
     
     string formatDurationMS(double ms) const {
         stringstream ss;
@@ -454,171 +1532,352 @@ private:
     }
     
     string getCurrentSystemTime() const {
-        SYSTEMTIME st;
-        GetLocalTime(&st);
+        HoraLocal h = horaLocal();
         stringstream ss;
-        ss << setfill('0') << setw(2) << st.wHour << ":"
-           << setfill('0') << setw(2) << st.wMinute << ":"
-           << setfill('0') << setw(2) << st.wSecond;
+        ss << setfill('0') << setw(2) << h.hora << ":"
+           << setfill('0') << setw(2) << h.minuto << ":"
+           << setfill('0') << setw(2) << h.segundo;
         return ss.str();
     }
     
-    void distribuirArchivos(vector<ThreadData>& threadData, bool optimizado) {
-        // Usar 4 threads para estabilidad
-        int threadsToUse = min(4, numCopias);
-        threadData.resize(threadsToUse);
-        
-        int filesPerThread = numCopias / threadsToUse;
-        int remainder = numCopias % threadsToUse;
+    // --digest=merkle en el proceso fusionado (ver ArchivoMerkle): fases por
+    // archivo y por trozo alternadas, con pool.esperar() entre una y otra
+    void ejecutarFasesMerkle(DatosEjecucion& data) {
+        typedef void (*TareaArchivo)(DatosEjecucion*, ArchivoMerkle*);
+        typedef void (*TareaTrozo)(DatosEjecucion*, ArchivoMerkle*, size_t);
+        static const TareaArchivo POR_ARCHIVO[] = {copiarArchivoMerkle, escribirArbolMerkle, cerrarArchivoMerkle};
+        static const TareaTrozo POR_TROZO[] = {cifrarTrozoMerkle, validarTrozoMerkle};
+        static const char* const NOMBRES_FASE[] = {"fase copia", "fase cifrar", "fase arbol", "fase validar",
+                                                   "fase cerrar"};
         
-        int currentFile = 1;
-        for (int t = 0; t < threadsToUse; ++t) {
-            threadData[t].archivos.clear();
-            threadData[t].success = false;
-            threadData[t].errorMsg = "";
-            threadData[t].optimizado = optimizado;
-            
-            int filesForThisThread = filesPerThread;
-            if (t < remainder) filesForThisThread++;
-            
-            for (int f = 0; f < filesForThisThread && currentFile <= numCopias; ++f) {
-                threadData[t].archivos.push_back(currentFile);
-                currentFile++;
+        const size_t numTrozos = numTrozosMerkle(data.originalSize, TROZO_MERKLE);
+        vector<ArchivoMerkle> archivos(numCopias);
+        for (size_t i = 0; i < archivos.size(); ++i) {
+            archivos[i].numero = static_cast<int>(i) + 1;
+            archivos[i].numTrozos = numTrozos;
+            archivos[i].hojas.resize(32 * numTrozos);
+            archivos[i].hojasEsperadas.resize(32 * numTrozos);
+            archivos[i].hojasValidacion.resize(32 * numTrozos);
+            archivos[i].trozoInvalido = numTrozos;
+        }
+        for (size_t fase = 0; fase < 5 && data.success; ++fase) {
+            TramoTraza tramo(NOMBRES_FASE[fase]);
+            for (size_t i = 0; i < archivos.size(); ++i) {
+                if (fase % 2 == 0) {
+                    pool.enviar(bind(POR_ARCHIVO[fase / 2], &data, &archivos[i]));
+                } else {
+                    for (size_t t = 0; t < numTrozos; ++t) {
+                        pool.enviar(bind(POR_TROZO[fase / 2], &data, &archivos[i], t));
+                    }
+                }
             }
+            pool.esperar();
         }
     }
     
-    vector<double> ejecutarConThreads(bool optimizado) {
+    // Devuelve el agregado de los tiempos por archivo; sin --escala también
+    // deja cada tiempo en `tiempos`
+    AgregadoTiempos ejecutarConThreads(ModoProceso modo, vector<double>& tiempos, double& tiempoPared,
+                                       size_t& bytesPorCopia) {
+        TramoTraza tramo(nombreModo(modo));
+        int64_t start = marcaTiempo();
+        descartarContadoresHw();
+        
+        // Con mmap las tareas leen el original directamente de las páginas
+        // mapeadas, sin copiarlo a un vector; con --origen=flujo no se carga
         vector<char> originalData;
-        if (optimizado) {
-            originalData = readFileOptimized(archivoOriginal);
+        BloqueGrande originalGrande;    // --paginas=grandes
+        ArchivoMapeado originalMapeado;
+        ReplicasNuma replicas;
+        DatosEjecucion data;
+        if (origen == ORIGEN_FLUJO) {
+            ifstream original(archivoOriginal.c_str(), ios::binary | ios::ate);
+            if (!original.is_open()) {
+                throw runtime_error("Cannot open file: " + archivoOriginal);
+            }
+            data.originalData = NULL;
+            data.originalSize = static_cast<size_t>(original.tellg());
+        } else if (lectura != LECTURA_STREAM) {
+            originalMapeado.abrir(archivoOriginal, MAPEO_LECTURA, lectura);
+            data.originalData = originalMapeado.datos();
+            data.originalSize = originalMapeado.tamano();
+        } else if (modo != MODO_BASE && paginasGrandesActivas()) {
+            data.originalSize = readFileOptimized(archivoOriginal, originalGrande);
+            data.originalData = originalGrande.datos();
         } else {
-            originalData = readFileBasic(archivoOriginal);
+            if (modo != MODO_BASE) {
+                originalData = readFileOptimized(archivoOriginal);
+            } else {
+                originalData = readFileBasic(archivoOriginal);
+            }
+            data.originalData = &originalData[0];
+            data.originalSize = originalData.size();
         }
+        bytesPorCopia = data.originalSize;
+        replicas.crear(data.originalData, data.originalSize, pool.numHilos());
+        data.replicas = &replicas;
         
-        vector<ThreadData> threadData;
-        distribuirArchivos(threadData, optimizado);
-        
-        for (size_t t = 0; t < threadData.size(); ++t) {
-            threadData[t].originalData = &originalData[0];
-            threadData[t].originalSize = originalData.size();
+        data.modo = modo;
+        data.lectura = lectura;
+        data.copia = copia;
+        data.origen = origen;
+        data.digest = digest;
+        data.manifiesto = NULL;
+        if (conManifiesto) {
+            manifiesto.reset(new Manifiesto(RUTA_MANIFIESTO));
+            data.manifiesto = manifiesto.get();
         }
-        
-        vector<HANDLE> threads;
-        for (size_t t = 0; t < threadData.size(); ++t) {
-            HANDLE hThread = CreateThread(NULL, 0, ThreadProcesarArchivos, &threadData[t], 0, NULL);
-            if (hThread != NULL) {
-                threads.push_back(hThread);
-            }
+        data.archivoOriginal = &archivoOriginal;
+        data.numCopias = numCopias;
+        reiniciarContadoresCopia();
+        reiniciarEstadisticasBuffersIo();
+        if (!escala) {
+            data.tiempos.assign(numCopias, 0.0);
         }
-        
-        if (!threads.empty()) {
-            WaitForMultipleObjects(threads.size(), &threads[0], TRUE, INFINITE);
-            for (size_t i = 0; i < threads.size(); ++i) {
-                CloseHandle(threads[i]);
-            }
+        for (size_t i = 0; i < estados.size(); ++i) {
+            estados[i].tiempos = AgregadoTiempos();
+            estados[i].mayorTarea = 0;
+            estados[i].asignaciones = 0;
+            estados[i].archivosEstables = 0;
         }
+        data.estados = &estados;
+        data.salida = NULL;
+        data.siguienteArchivo = 1;
+        data.success = true;
         
-        for (size_t t = 0; t < threadData.size(); ++t) {
-            if (!threadData[t].success) {
-                throw runtime_error(threadData[t].errorMsg);
+        if (digest == DIGEST_MERKLE && modo == MODO_FUSIONADO) {
+            ejecutarFasesMerkle(data);
+        } else if (escala || origen == ORIGEN_FLUJO) {
+            // Un bucle por hilo sobre el contador compartido
+            if (escala) {
+                salida.reset(new SalidaFragmentada(RAIZ_ESCALA, numCopias));
+                data.salida = salida.get();
             }
-        }
-        
-        vector<pair<int, double>> tiemposConIndice;
-        for (size_t t = 0; t < threadData.size(); ++t) {
-            for (size_t i = 0; i < threadData[t].archivos.size(); ++i) {
-                int numeroArchivo = threadData[t].archivos[i];
-                double tiempo = threadData[t].tiempos[i];
-                tiemposConIndice.push_back(make_pair(numeroArchivo, tiempo));
+            for (size_t h = 0; h < pool.numHilos(); ++h) {
+                pool.enviar(bind(procesarTareaDescriptores, &data));
+            }
+        } else {
+            // Una tarea por archivo (o por lote del motor multi-buffer); los
+            // hilos libres roban tareas de los ocupados
+            size_t ancho = (modo == MODO_FUSIONADO) ? 1 : anchoLoteHash(data.originalSize);
+            for (int primero = 1; primero <= numCopias; primero += static_cast<int>(ancho)) {
+                size_t cantidad = min(ancho, static_cast<size_t>(numCopias - primero + 1));
+                pool.enviar(bind(procesarTarea, &data, primero, cantidad));
             }
         }
+        pool.esperar();
+        // Lo que quedó en el lote de cada hilo
+        for (size_t i = 0; manifiesto && i < estados.size(); ++i) {
+            vaciarManifiesto(&data, estados[i]);
+        }
         
-        sort(tiemposConIndice.begin(), tiemposConIndice.end());
+        tiempoPared = msTranscurridos(start);
+        // Antes de liberar el original y las copias por nodo
+        paginas = estadisticasPaginas();
+        contadoresHw.reiniciar();
+        combinarContadoresHw(contadoresHw);
         
-        vector<double> tiemposOrdenados;
-        for (size_t i = 0; i < tiemposConIndice.size(); ++i) {
-            tiemposOrdenados.push_back(tiemposConIndice[i].second);
+        if (!data.success) {
+            throw runtime_error(data.errorMsg);
         }
-        
-        return tiemposOrdenados;
+        tiempos.swap(data.tiempos);
+        AgregadoTiempos agregado;
+        for (size_t i = 0; i < estados.size(); ++i) {
+            agregado.combinar(estados[i].tiempos);
+        }
+        return agregado;
     }
 
 public:
-    OptimizedFileProcessor(const string& archivo, int copias) 
-        : archivoOriginal(archivo), numCopias(copias) {
-        if (!g_csInitialized) {
-            InitializeCriticalSection(&g_cs);
-            g_csInitialized = true;
-        }
-    }
+    OptimizedFileProcessor(const string& archivo, int copias, size_t hilos, ModoLectura modoLectura,
+                           ModoCopia modoCopia, bool modoEscala, ModoOrigen modoOrigen, FormatoDigest formatoDigest, bool manifiestoSha) 
+        : archivoOriginal(archivo), numCopias(copias), lectura(modoLectura), copia(modoCopia),
+          escala(modoEscala), origen(modoOrigen), digest(formatoDigest), conManifiesto(manifiestoSha), pool(hilos, prepararHiloTrabajador), estados(pool.numHilos()) {}
     
-    ~OptimizedFileProcessor() {
-        if (g_csInitialized) {
-            DeleteCriticalSection(&g_cs);
-            g_csInitialized = false;
+    void limpiarArchivos() {
+        if (manifiesto) {
+            manifiesto.reset();
+            remove(RUTA_MANIFIESTO);
+        }
+        if (salida) {
+            // Con manifiesto no hay .sha por archivo
+            static const char* const SUFIJOS[] = {".txt", "_2.txt", ".sha"};
+            salida->eliminar(SUFIJOS, conManifiesto ? 2 : 3);
+            salida.reset();
+            return;
         }
-    }
-    
-    void limpiarArchivos() const {
         for (int i = 1; i <= numCopias; i++) {
             stringstream ss1, ss2, ss3;
             ss1 << i << ".txt";
-            ss2 << i << "2.txt";
+            ss2 << i << "_2.txt";
             ss3 << i << ".sha";
             
-            DeleteFileA(ss1.str().c_str());
-            DeleteFileA(ss2.str().c_str());
-            DeleteFileA(ss3.str().c_str());
+            borrarArchivo(ss1.str().c_str());
+            borrarArchivo(ss2.str().c_str());
+            borrarArchivo(ss3.str().c_str());
         }
     }
     
-    double ejecutarProcesoBase() {
-        cout << "\n=== PROCESO BASE ===\n";
+    // --bench: `calentamiento` ejecuciones descartadas y `repeticiones`
+    // medidas. Muestra el bloque TI/TFIN/TPPA/TT/THR de siempre con las
+    // medianas, más las estadísticas de las muestras. Con `totalBase` > 0
+    // (la mediana del TT del proceso base) agrega DF y PM.
+    ResultadoBench medirProceso(ModoProceso modo, int repeticiones, int calentamiento, double totalBase) {
+        cout << "--------------------------------\n";
+        cout << "=== " << tituloModo(modo) << (digest == DIGEST_MERKLE ? " (MERKLE)" : "") << " === copias: "
+             << numCopias << ", threads: " << pool.numHilos() << "\n";
         cout << "TI: " << getCurrentSystemTime() << "\n";
         cout.flush();
         
-        vector<double> tiempos = ejecutarConThreads(false);
-        double tiempoTotal = 0.0;
-        
-        for (int i = 0; i < numCopias; ++i) {
-            cout << "Tiempo " << setfill('0') << setw(2) << (i+1) << ": " << formatDurationMS(tiempos[i]) << "\n";
-            cout.flush();
-            tiempoTotal += tiempos[i];
+        ResultadoBench resultado;
+        resultado.modo = modo;
+        resultado.copias = numCopias;
+        resultado.hilos = pool.numHilos();
+        resultado.repeticiones = repeticiones;
+        resultado.calentamiento = calentamiento;
+        resultado.bytesPorCopia = 0;
+        vector<double> porArchivo, totales, megas;
+        HistogramasEtapas etapas;
+        LecturaContadoresHw contadores;
+        for (int r = 0; r < calentamiento + repeticiones; ++r) {
+            double tiempoPared = 0.0;
+            vector<double> tiempos;
+            AgregadoTiempos agregado = ejecutarConThreads(modo, tiempos, tiempoPared, resultado.bytesPorCopia);
+            limpiarArchivos();
+            if (r < calentamiento) {
+                descartarHistogramasEtapas();
+                continue;
+            }
+            combinarHistogramasEtapas(etapas);
+            contadores.combinar(contadoresHw);
+            porArchivo.insert(porArchivo.end(), tiempos.begin(), tiempos.end());
+            totales.push_back(agregado.suma);
+            double megabytes = static_cast<double>(resultado.bytesPorCopia) * numCopias / (1024.0 * 1024.0);
+            megas.push_back(megabytes / (tiempoPared / 1000.0));
         }
+        titulosEtapas.push_back(nombreModo(modo));
+        etapasPorModo.push_back(etapas);
+        resultado.porArchivo = resumirMuestras(porArchivo);
+        resultado.total = resumirMuestras(totales);
+        resultado.megasPorSegundo = resumirMuestras(megas);
         
         cout << "TFIN: " << getCurrentSystemTime() << "\n";
-        cout << "TPPA: " << formatDurationMS(tiempoTotal / numCopias) << "\n";
-        cout << "TT: " << formatDurationMS(tiempoTotal) << "\n";
+        cout << "TPPA: " << formatDurationMS(resultado.porArchivo.mediana) << " (mediana)\n";
+        cout << "TT: " << formatDurationMS(resultado.total.mediana) << " (mediana de " << repeticiones << ")\n";
+        cout << "THR: " << fixed << setprecision(1) << resultado.megasPorSegundo.mediana << " MB/s (mediana)\n";
+        if (contadoresHwActivos()) {
+            // Media por repetición medida
+            for (int c = 0; c < NUM_CONTADORES_HW; ++c) {
+                contadores.valores[c] /= static_cast<uint64_t>(repeticiones);
+            }
+            cout << resumenContadoresHw(contadores, static_cast<double>(resultado.bytesPorCopia) * numCopias);
+        }
+        if (paginasGrandesActivas()) {
+            cout << "PAG: " << resumenPaginas(paginas) << " (última repetición)\n";
+        }
+        mostrarResumen("Archivo", resultado.porArchivo, " ms");
+        mostrarResumen("Total", resultado.total, " ms");
+        mostrarResumen("MB/s", resultado.megasPorSegundo, "");
+        if (totalBase > 0.0) {
+            double mediana = resultado.total.mediana;
+            cout << "DF: " << formatDurationMS(totalBase - mediana) << "\n";
+            cout << "PM: " << fixed << setprecision(1) << (totalBase - mediana) / totalBase * 100.0 << "%\n";
+        }
         cout.flush();
-        
-        limpiarArchivos();
-        return tiempoTotal;
+        return resultado;
     }
     
-    double ejecutarProcesoOptimizado(double tiempoBase) {
-        cout << "--------------------------------\n";
-        cout << "=== PROCESO OPTIMIZADO ===\n";
+    static void mostrarResumen(const char* nombre, const ResumenMuestras& r, const char* unidad) {
+        cout << nombre << ": min " << fixed << setprecision(2) << r.minimo << unidad << "  med " << r.mediana
+             << unidad << "  p95 " << r.p95 << unidad << "  p99 " << r.p99 << unidad << "  desv " << r.desviacion
+             << unidad << "  (n=" << r.n << ")\n";
+    }
+    
+    // Desglose por etapa de los modos ejecutados desde la última llamada
+    // (no muestra nada sin MEDIR_ETAPAS)
+    void mostrarEtapas() {
+        mostrarDesgloseEtapas(cout, titulosEtapas, etapasPorModo);
+        cout.flush();
+        titulosEtapas.clear();
+        etapasPorModo.clear();
+    }
+    
+    static const char* tituloModo(ModoProceso modo) {
+        switch (modo) {
+            case MODO_OPTIMIZADO: return "PROCESO OPTIMIZADO";
+            case MODO_FUSIONADO: return "PROCESO FUSIONADO";
+            default: return "PROCESO BASE";
+        }
+    }
+    
+    // Ejecuta un modo y muestra sus tiempos. THR es el throughput: bytes de
+    // todas las copias entre el tiempo de pared de la ejecución. Si se pasa
+    // el tiempo del proceso base (> 0) se agregan DF y PM.
+    double ejecutarProceso(ModoProceso modo, double tiempoBase) {
+        cout << (modo == MODO_BASE ? "\n" : "--------------------------------\n");
+        cout << "=== " << tituloModo(modo) << (escala ? " (ESCALA)" : "")
+             << (digest == DIGEST_MERKLE ? " (MERKLE)" : "") << " ===\n";
         cout << "TI: " << getCurrentSystemTime() << "\n";
         cout.flush();
         
-        vector<double> tiempos = ejecutarConThreads(true);
-        double tiempoTotal = 0.0;
+        double tiempoPared = 0.0;
+        size_t bytesPorCopia = 0;
+        vector<double> tiempos;
+        AgregadoTiempos agregado = ejecutarConThreads(modo, tiempos, tiempoPared, bytesPorCopia);
+        double tiempoTotal = agregado.suma;
+        titulosEtapas.push_back(nombreModo(modo));
+        etapasPorModo.push_back(HistogramasEtapas());
+        combinarHistogramasEtapas(etapasPorModo.back());
         
-        for (int i = 0; i < numCopias; ++i) {
+        // Con --escala no se lista cada archivo: solo el resumen
+        for (size_t i = 0; i < tiempos.size(); ++i) {
             cout << "Tiempo " << setfill('0') << setw(2) << (i+1) << ": " << formatDurationMS(tiempos[i]) << "\n";
             cout.flush();
-            tiempoTotal += tiempos[i];
+        }
+        if (escala) {
+            cout << "Archivos: " << agregado.n << " en " << salida->numFragmentos() << " fragmentos ("
+                 << salida->numDescriptoresEnCache() << " con descriptor en cache)\n";
+            cout << "MIN: " << formatDurationMS(agregado.minimo) << "  MAX: " << formatDurationMS(agregado.maximo)
+                 << "  DESV: " << formatDurationMS(agregado.desviacion()) << "\n";
         }
         
+        double megabytes = static_cast<double>(bytesPorCopia) * numCopias / (1024.0 * 1024.0);
         cout << "TFIN: " << getCurrentSystemTime() << "\n";
         cout << "TPPA: " << formatDurationMS(tiempoTotal / numCopias) << "\n";
         cout << "TT: " << formatDurationMS(tiempoTotal) << "\n";
-        cout << "--------------------------------\n";
+        cout << "THR: " << fixed << setprecision(1) << megabytes / (tiempoPared / 1000.0) << " MB/s\n";
+        if (contadoresHwActivos()) {
+            cout << resumenContadoresHw(contadoresHw, static_cast<double>(bytesPorCopia) * numCopias);
+        }
+        if (copia == COPIA_KERNEL) {
+            cout << "Copia: " << resumenEstrategiasCopia() << "\n";
+        }
+        if (manifiesto) {
+            cout << "SHA: " << manifiesto->numRegistros() << " registros en " << RUTA_MANIFIESTO << " ("
+                 << manifiesto->numEscrituras() << " escrituras)\n";
+        }
+        EstadisticasBuffersIo buffers = estadisticasBuffersIo();
+        cout << "BUF: " << buffers.usos << " reutilizados, " << buffers.reservas << " reservados\n";
+        if (paginasGrandesActivas()) {
+            cout << "PAG: " << resumenPaginas(paginas) << "\n";
+        }
+        unsigned long long asignaciones = 0, archivosEstables = 0;
+        for (size_t i = 0; i < estados.size(); ++i) {
+            asignaciones += estados[i].asignaciones;
+            archivosEstables += estados[i].archivosEstables;
+        }
+        if (ASIGNACIONES_CONTADAS && archivosEstables > 0) {
+            cout << "ALLOC: " << fixed << setprecision(1)
+                 << static_cast<double>(asignaciones) / archivosEstables << " por archivo ("
+                 << archivosEstables << " archivos en régimen estable)\n";
+        }
         
-        double mejora = ((tiempoBase - tiempoTotal) / tiempoBase) * 100.0;
-        cout << "DF: " << formatDurationMS(tiempoBase - tiempoTotal) << "\n";
-        cout << "PM: " << fixed << setprecision(1) << mejora << "%\n";
+        if (tiempoBase > 0.0) {
+            cout << "--------------------------------\n";
+            double mejora = ((tiempoBase - tiempoTotal) / tiempoBase) * 100.0;
+            cout << "DF: " << formatDurationMS(tiempoBase - tiempoTotal) << "\n";
+            cout << "PM: " << fixed << setprecision(1) << mejora << "%\n";
+        }
         cout.flush();
         
         limpiarArchivos();
@@ -626,12 +1885,388 @@ public:
     }
 };
 
-int main() {
+// OPCIONES DE LÍNEA DE COMANDOS
+struct Opciones {
+    vector<ModoProceso> modos;
+    size_t hilos;               // 0 = uno por núcleo lógico
+    ColocacionHilos colocacion; // CPU de cada hilo del pool
+    ModoLectura lectura;
+    ModoEscritura escritura;
+    ModoCopia copia;
+    size_t bufferBytes;         // buffer de I/O por hilo
+    bool escala;                // sin límite de copias (ver --escala)
+    ModoOrigen origen;
+    FormatoDigest digest;
+    bool manifiesto;            // --sha=manifiesto
+    bool contadores;            // --contadores: perf_event_open por hilo
+    bool paginasGrandes;        // --paginas=grandes
+    string rutaTraza;           // --trace=ruta: línea de tiempo de los hilos
+    // Benchmark no interactivo
+    vector<int> copias;         // vacío: se pregunta como siempre
+    vector<size_t> listaHilos;  // --threads con varios valores (solo --bench)
+    bool bench;
+    int repeticiones;
+    int calentamiento;
+    string rutaJson;
+    string rutaCsv;
+};
+
+// Lista "a,b,c" de enteros en [minimo, maximo]
+static vector<int> parsearListaEnteros(const string& texto, int minimo, int maximo, const char* que) {
+    vector<int> valores;
+    stringstream lista(texto);
+    string valor;
+    while (getline(lista, valor, ',')) {
+        char* fin = NULL;
+        long n = strtol(valor.c_str(), &fin, 10);
+        if (valor.empty() || *fin != '\0' || n < minimo || n > maximo) {
+            throw runtime_error(string(que) + " invalido: " + valor);
+        }
+        valores.push_back(static_cast<int>(n));
+    }
+    if (valores.empty()) {
+        throw runtime_error(string(que) + " invalido: " + texto);
+    }
+    return valores;
+}
+
+// --modos=base,optimizado,fusionado (por defecto base y optimizado, como
+// siempre), --threads=N (por defecto uno por núcleo lógico),
+// --lectura=stream|mmap|mmap-perezoso (por defecto stream),
+// --escritura=cache|directa (por defecto cache), --copia=memoria|kernel
+// (por defecto memoria) y --buffer-kb=N (buffer de I/O por hilo, por
+// defecto MEGA_BUFFER_SIZE). --escala quita el límite de 50 copias: las
+// salidas van fragmentadas bajo RAIZ_ESCALA y se corre el proceso fusionado
+// sobre descriptores, con memoria constante por archivo en vuelo; con
+// --escala o --origen=flujo, --modos solo puede ser fusionado.
+// --origen=memoria|flujo: con flujo el original no se carga entero sino que
+// cada pasada lo lee por bloques (proceso fusionado, memoria acotada por
+// hilo sin importar el tamaño del archivo). --digest=plano|merkle (por
+// defecto plano): con merkle el .sha guarda un árbol de hashes por trozo y
+// en el proceso fusionado los trozos se reparten entre los hilos.
+// --sha=archivos|manifiesto (por defecto archivos): con manifiesto los
+// hashes van a un único archivo binario (ver manifiesto.h) en vez de un
+// .sha por copia.
+// --contadores lee los contadores de hardware de cada hilo (ver
+// contadores_hw.h) y los muestra junto a TT/TPPA; con MEDIR_ETAPAS también
+// por etapa.
+// --colocacion=ninguna|compacta|dispersa (por defecto ninguna) fija cada
+// hilo del pool a una CPU, uno por núcleo físico antes de usar hermanas SMT,
+// llenando los nodos NUMA de a uno o alternándolos (ver topologia.h); con
+// varios nodos el original se replica en cada nodo con hilos.
+// --paginas=normales|grandes (por defecto normales): con grandes el
+// original (salvo en el proceso base), el bloque de la arena de cada hilo,
+// los buffers de I/O y las copias por nodo van en páginas de 2 MB (ver
+// paginas_grandes.h) y cada modo informa las que obtuvo.
+// --trace=ruta guarda al terminar la línea de tiempo de cada hilo (archivos
+// y etapas) en formato Chrome trace-event (ver traza_eventos.h).
+// --copias=N evita la pregunta del número de copias. --bench corre cada
+// combinación de --copias=N,M,... y --threads=N,M,... con
+// --calentamiento=C ejecuciones descartadas (por defecto WARMUP_ITERATIONS)
+// y --repeticiones=R medidas (por defecto BENCHMARK_RUNS), y reporta
+// min/mediana/p95/p99/desviación por archivo, del total y de MB/s; con
+// --json=ruta y --csv=ruta además los escribe en esos formatos.
+static Opciones parsearOpciones(int argc, char* argv[]) {
+    Opciones opciones;
+    opciones.hilos = 0;
+    opciones.colocacion = COLOCACION_NINGUNA;
+    opciones.lectura = LECTURA_STREAM;
+    opciones.escritura = ESCRITURA_CACHE;
+    opciones.copia = COPIA_MEMORIA;
+    opciones.bufferBytes = MEGA_BUFFER_SIZE;
+    opciones.escala = false;
+    opciones.origen = ORIGEN_MEMORIA;
+    opciones.digest = DIGEST_PLANO;
+    opciones.manifiesto = false;
+    opciones.contadores = false;
+    opciones.paginasGrandes = false;
+    opciones.bench = false;
+    opciones.repeticiones = static_cast<int>(BENCHMARK_RUNS);
+    opciones.calentamiento = static_cast<int>(WARMUP_ITERATIONS);
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, 8, "--modos=") == 0) {
+            stringstream lista(arg.substr(8));
+            string nombre;
+            while (getline(lista, nombre, ',')) {
+                if (nombre == "base") opciones.modos.push_back(MODO_BASE);
+                else if (nombre == "optimizado") opciones.modos.push_back(MODO_OPTIMIZADO);
+                else if (nombre == "fusionado") opciones.modos.push_back(MODO_FUSIONADO);
+                else throw runtime_error("Modo desconocido: " + nombre);
+            }
+        } else if (arg.compare(0, 10, "--threads=") == 0) {
+            vector<int> hilos = parsearListaEnteros(arg.substr(10), 0, 256, "Numero de threads");
+            opciones.listaHilos.clear();
+            for (size_t h = 0; h < hilos.size(); ++h) {
+                opciones.listaHilos.push_back(PoolHilos::hilosEfectivos(static_cast<size_t>(hilos[h])));
+            }
+            opciones.hilos = static_cast<size_t>(hilos[0]);
+        } else if (arg.compare(0, 13, "--colocacion=") == 0) {
+            if (!parsearColocacion(arg.substr(13), opciones.colocacion)) {
+                throw runtime_error("Colocacion desconocida: " + arg.substr(13));
+            }
+        } else if (arg.compare(0, 10, "--lectura=") == 0) {
+            if (!parsearModoLectura(arg.substr(10), opciones.lectura)) {
+                throw runtime_error("Modo de lectura desconocido: " + arg.substr(10));
+            }
+        } else if (arg.compare(0, 12, "--escritura=") == 0) {
+            if (!parsearModoEscritura(arg.substr(12), opciones.escritura)) {
+                throw runtime_error("Modo de escritura desconocido: " + arg.substr(12));
+            }
+        } else if (arg.compare(0, 8, "--copia=") == 0) {
+            if (!parsearModoCopia(arg.substr(8), opciones.copia)) {
+                throw runtime_error("Modo de copia desconocido: " + arg.substr(8));
+            }
+        } else if (arg.compare(0, 12, "--buffer-kb=") == 0) {
+            int kb = atoi(arg.c_str() + 12);
+            if (kb < 4 || kb > 1024 * 1024) {
+                throw runtime_error("Tamano de buffer invalido: " + arg.substr(12));
+            }
+            opciones.bufferBytes = static_cast<size_t>(kb) * 1024;
+        } else if (arg == "--escala") {
+            opciones.escala = true;
+        } else if (arg.compare(0, 9, "--origen=") == 0) {
+            string nombre = arg.substr(9);
+            if (nombre == "memoria") opciones.origen = ORIGEN_MEMORIA;
+            else if (nombre == "flujo") opciones.origen = ORIGEN_FLUJO;
+            else throw runtime_error("Modo de origen desconocido: " + nombre);
+        } else if (arg.compare(0, 9, "--digest=") == 0) {
+            if (!parsearFormatoDigest(arg.substr(9), opciones.digest)) {
+                throw runtime_error("Formato de digest desconocido: " + arg.substr(9));
+            }
+        } else if (arg.compare(0, 6, "--sha=") == 0) {
+            string nombre = arg.substr(6);
+            if (nombre == "archivos") opciones.manifiesto = false;
+            else if (nombre == "manifiesto") opciones.manifiesto = true;
+            else throw runtime_error("Destino de hashes desconocido: " + nombre);
+        } else if (arg.compare(0, 8, "--trace=") == 0) {
+            opciones.rutaTraza = arg.substr(8);
+            if (opciones.rutaTraza.empty()) {
+                throw runtime_error("--trace necesita una ruta");
+            }
+        } else if (arg.compare(0, 10, "--paginas=") == 0) {
+            string nombre = arg.substr(10);
+            if (nombre == "normales") opciones.paginasGrandes = false;
+            else if (nombre == "grandes") opciones.paginasGrandes = true;
+            else throw runtime_error("Tipo de paginas desconocido: " + nombre);
+        } else if (arg == "--contadores") {
+            opciones.contadores = true;
+        } else if (arg.compare(0, 9, "--copias=") == 0) {
+            opciones.copias = parsearListaEnteros(arg.substr(9), 1, 2000000000, "Numero de copias");
+        } else if (arg == "--bench") {
+            opciones.bench = true;
+        } else if (arg.compare(0, 15, "--repeticiones=") == 0) {
+            opciones.repeticiones = parsearListaEnteros(arg.substr(15), 1, 100000, "Repeticiones")[0];
+        } else if (arg.compare(0, 16, "--calentamiento=") == 0) {
+            opciones.calentamiento = parsearListaEnteros(arg.substr(16), 0, 100000, "Calentamiento")[0];
+        } else if (arg.compare(0, 7, "--json=") == 0) {
+            opciones.rutaJson = arg.substr(7);
+        } else if (arg.compare(0, 6, "--csv=") == 0) {
+            opciones.rutaCsv = arg.substr(6);
+        } else {
+            throw runtime_error("Argumento desconocido: " + arg);
+        }
+    }
+    if (opciones.escala && opciones.digest == DIGEST_MERKLE) {
+        // El árbol guarda las hojas de cada archivo hasta validarlo
+        throw runtime_error("--digest=merkle no se combina con --escala");
+    }
+    if (!opciones.bench && (opciones.copias.size() > 1 || opciones.listaHilos.size() > 1)) {
+        throw runtime_error("Varios valores de --copias o --threads solo con --bench");
+    }
+    if (opciones.bench && opciones.escala) {
+        // Las estadísticas por archivo necesitan el tiempo de cada uno
+        throw runtime_error("--bench no se combina con --escala");
+    }
+    if (!opciones.bench && (!opciones.rutaJson.empty() || !opciones.rutaCsv.empty())) {
+        throw runtime_error("--json y --csv solo con --bench");
+    }
+    for (size_t i = 0; i < opciones.copias.size(); ++i) {
+        if (!opciones.escala && opciones.copias[i] > 50) {
+            throw runtime_error("Numero de copias invalido (1-50): " + to_string(opciones.copias[i]));
+        }
+    }
+    if (opciones.manifiesto && opciones.digest == DIGEST_MERKLE) {
+        // El registro guarda un solo digest, no las hojas del árbol
+        throw runtime_error("--sha=manifiesto no se combina con --digest=merkle");
+    }
+    if (opciones.escala || opciones.origen == ORIGEN_FLUJO) {
+        // Los modos base y optimizado guardan el archivo entero por etapa
+        if (!opciones.modos.empty() &&
+            (opciones.modos.size() != 1 || opciones.modos[0] != MODO_FUSIONADO)) {
+            throw runtime_error(string(opciones.escala ? "--escala" : "--origen=flujo") +
+                                " solo admite --modos=fusionado");
+        }
+        opciones.modos.assign(1, MODO_FUSIONADO);
+    } else if (opciones.modos.empty()) {
+        opciones.modos.push_back(MODO_BASE);
+        opciones.modos.push_back(MODO_OPTIMIZADO);
+    }
+    opciones.hilos = PoolHilos::hilosEfectivos(opciones.hilos);
+    if (opciones.listaHilos.empty()) {
+        opciones.listaHilos.push_back(opciones.hilos);
+    }
+    return opciones;
+}
+
+// SALIDA DEL BENCHMARK EN JSON Y CSV
+static void escribirResumenJson(ostream& out, const char* nombre, const ResumenMuestras& r) {
+    out << "\"" << nombre << "\": {\"n\": " << r.n << ", \"min\": " << r.minimo << ", \"mediana\": " << r.mediana
+        << ", \"p95\": " << r.p95 << ", \"p99\": " << r.p99 << ", \"max\": " << r.maximo
+        << ", \"media\": " << r.media << ", \"desv\": " << r.desviacion << "}";
+}
+
+static void escribirBenchJson(const string& ruta, const vector<ResultadoBench>& resultados) {
+    ofstream out(ruta.c_str());
+    if (!out.is_open()) {
+        throw runtime_error("Cannot create file: " + ruta);
+    }
+    out << fixed << setprecision(3) << "[\n";
+    for (size_t i = 0; i < resultados.size(); ++i) {
+        const ResultadoBench& r = resultados[i];
+        out << "  {\"modo\": \"" << nombreModo(r.modo) << "\", \"copias\": " << r.copias
+            << ", \"threads\": " << r.hilos << ", \"repeticiones\": " << r.repeticiones
+            << ", \"calentamiento\": " << r.calentamiento << ", \"bytes_por_copia\": " << r.bytesPorCopia << ",\n   ";
+        escribirResumenJson(out, "archivo_ms", r.porArchivo);
+        out << ",\n   ";
+        escribirResumenJson(out, "total_ms", r.total);
+        out << ",\n   ";
+        escribirResumenJson(out, "mb_s", r.megasPorSegundo);
+        out << "}" << (i + 1 < resultados.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+static void escribirResumenCsv(ostream& out, const ResumenMuestras& r) {
+    out << "," << r.minimo << "," << r.mediana << "," << r.p95 << "," << r.p99 << "," << r.desviacion;
+}
+
+static void escribirBenchCsv(const string& ruta, const vector<ResultadoBench>& resultados) {
+    ofstream out(ruta.c_str());
+    if (!out.is_open()) {
+        throw runtime_error("Cannot create file: " + ruta);
+    }
+    out << "modo,copias,threads,repeticiones,calentamiento,bytes_por_copia";
+    static const char* const GRUPOS[] = {"archivo_ms", "total_ms", "mb_s"};
+    static const char* const CAMPOS[] = {"min", "mediana", "p95", "p99", "desv"};
+    for (size_t g = 0; g < 3; ++g) {
+        for (size_t c = 0; c < 5; ++c) {
+            out << "," << GRUPOS[g] << "_" << CAMPOS[c];
+        }
+    }
+    out << "\n" << fixed << setprecision(3);
+    for (size_t i = 0; i < resultados.size(); ++i) {
+        const ResultadoBench& r = resultados[i];
+        out << nombreModo(r.modo) << "," << r.copias << "," << r.hilos << "," << r.repeticiones << ","
+            << r.calentamiento << "," << r.bytesPorCopia;
+        escribirResumenCsv(out, r.porArchivo);
+        escribirResumenCsv(out, r.total);
+        escribirResumenCsv(out, r.megasPorSegundo);
+        out << "\n";
+    }
+}
+
+// --bench: cada combinación de threads y copias con un procesador (y su
+// pool) propio; DF/PM comparan con la mediana del base de esa combinación
+static void ejecutarBenchmark(const Opciones& opciones) {
+    vector<ResultadoBench> resultados;
+    for (size_t h = 0; h < opciones.listaHilos.size(); ++h) {
+        for (size_t c = 0; c < opciones.copias.size(); ++c) {
+            OptimizedFileProcessor processor("original.txt", opciones.copias[c], opciones.listaHilos[h],
+                                             opciones.lectura, opciones.copia, opciones.escala, opciones.origen,
+                                             opciones.digest, opciones.manifiesto);
+            double totalBase = 0.0;
+            for (size_t m = 0; m < opciones.modos.size(); ++m) {
+                ModoProceso modo = opciones.modos[m];
+                resultados.push_back(processor.medirProceso(modo, opciones.repeticiones, opciones.calentamiento,
+                                                            modo == MODO_BASE ? 0.0 : totalBase));
+                if (modo == MODO_BASE) totalBase = resultados.back().total.mediana;
+            }
+            processor.mostrarEtapas();
+        }
+    }
+    if (!opciones.rutaJson.empty()) {
+        escribirBenchJson(opciones.rutaJson, resultados);
+        cout << "JSON: " << opciones.rutaJson << "\n";
+    }
+    if (!opciones.rutaCsv.empty()) {
+        escribirBenchCsv(opciones.rutaCsv, resultados);
+        cout << "CSV: " << opciones.rutaCsv << "\n";
+    }
+}
+
+// --trace: con los hilos ya ociosos
+static void guardarTraza(const Opciones& opciones) {
+    if (opciones.rutaTraza.empty()) return;
+    uint64_t perdidos = 0;
+    size_t eventos = escribirTraza(opciones.rutaTraza, perdidos);
+    cout << "Traza: " << eventos << " eventos en " << opciones.rutaTraza;
+    if (perdidos > 0) {
+        cout << " (" << perdidos << " pisados por buffer lleno)";
+    }
+    cout << "\n";
+}
+
+int main(int argc, char* argv[]) {
     try {
+        Opciones opciones = parsearOpciones(argc, argv);
+        const vector<ModoProceso>& modos = opciones.modos;
+        
         cout << "=== ULTRA-STABLE FILE PROCESSOR ===\n";
-        cout << "Threads: " << MAX_THREADS << "\n";
-        cout << "Buffer: " << MEGA_BUFFER_SIZE / (1024*1024) << "MB\n";
-        cout << "Mediciones: " << BENCHMARK_RUNS << " por operacion\n";
+        cout << "Threads: ";
+        for (size_t h = 0; h < opciones.listaHilos.size(); ++h) {
+            cout << (h > 0 ? "," : "") << opciones.listaHilos[h];
+        }
+        cout << " (work stealing)\n";
+        // Antes de crear el pool: cada hilo se fija al arrancar
+        cout << "Colocacion: " << activarColocacion(opciones.colocacion) << "\n";
+        configurarTamanoBufferIo(opciones.bufferBytes);
+        cout << "Buffer: " << tamanoBufferIo() / 1024 << "KB por hilo\n";
+        cout << "Lectura: " << nombreModoLectura(opciones.lectura) << "\n";
+        cout << "Escritura: " << nombreModoEscritura(opciones.escritura) << "\n";
+        g_modoEscritura = opciones.escritura;
+        cout << "Copia de archivos: " << nombreModoCopia(opciones.copia) << "\n";
+        if (opciones.bench) {
+            cout << "Mediciones: " << opciones.repeticiones << " por operacion (+" << opciones.calentamiento
+                 << " de calentamiento)\n";
+        } else {
+            cout << "Mediciones: 1 por operacion (--bench para repetir)\n";
+        }
+        if (opciones.escala) {
+            cout << "Escala: salida fragmentada en " << RAIZ_ESCALA << "/ (proceso fusionado)\n";
+        }
+        if (opciones.origen == ORIGEN_FLUJO) {
+            cout << "Origen: flujo por bloques de " << BLOQUE_FUSION / 1024 << " KB ("
+                 << 2 * BLOQUE_FUSION / 1024 << " KB por hilo)\n";
+        }
+        if (opciones.manifiesto) {
+            cout << "Hashes: manifiesto binario " << RUTA_MANIFIESTO << "\n";
+        }
+        if (opciones.digest == DIGEST_MERKLE) {
+            cout << "Digest: arbol merkle, trozos de " << TROZO_MERKLE / 1024 << " KB\n";
+        }
+        if (ETAPAS_ACTIVAS) {
+            cout << "Etapas: desglose por tramo al final (MEDIR_ETAPAS)\n";
+        }
+        if (ASIGNACIONES_CONTADAS) {
+            cout << "Asignaciones: conteo por hilo, ALLOC en cada modo (CONTAR_ASIGNACIONES)\n";
+        }
+        if (opciones.paginasGrandes) {
+            // Antes de reservar buffers: el modo no cambia después
+            cout << "Paginas: " << activarPaginasGrandes() << "\n";
+        }
+        if (opciones.contadores) {
+            // Antes de crear el pool: cada hilo abre su grupo al arrancar
+            cout << "Contadores HW: " << activarContadoresHw() << "\n";
+        }
+        if (!opciones.rutaTraza.empty()) {
+            activarTraza();
+            cout << "Traza: " << opciones.rutaTraza << " (Chrome trace-event)\n";
+        }
+        NivelSimd nivelSimd = inicializarCifradoSimd(encriptarInPlaceEscalar, desencriptarInPlaceEscalar);
+        cout << "Cifrado SIMD: " << nombreNivelSimd(nivelSimd) << "\n";
+        cout << "SHA-256: " << implementacionSha256().nombre
+             << " (lotes: " << motorSha256Multiple().nombre << ")\n";
         cout << "==========================================\n";
         cout.flush();
         
@@ -645,20 +2280,41 @@ int main() {
         }
         check.close();
         
-        int numCopias;
-        cout << "Numero de copias (1-50): ";
-        cout.flush();
-        cin >> numCopias;
+        if (opciones.bench) {
+            if (opciones.copias.empty()) {
+                cout << "ERROR: --bench necesita --copias=N[,M...]\n";
+                return 1;
+            }
+            ejecutarBenchmark(opciones);
+            guardarTraza(opciones);
+            return 0;
+        }
         
-        if (numCopias < 1 || numCopias > 50) {
-            cout << "ERROR: Numero invalido\n";
-            return 1;
+        int numCopias;
+        if (!opciones.copias.empty()) {
+            numCopias = opciones.copias[0];
+        } else {
+            cout << (opciones.escala ? "Numero de copias: " : "Numero de copias (1-50): ");
+            cout.flush();
+            cin >> numCopias;
+            
+            if (!cin || numCopias < 1 || (!opciones.escala && numCopias > 50)) {
+                cout << "ERROR: Numero invalido\n";
+                return 1;
+            }
         }
         
-        OptimizedFileProcessor processor("original.txt", numCopias);
+        OptimizedFileProcessor processor("original.txt", numCopias, opciones.hilos, opciones.lectura,
+                                         opciones.copia, opciones.escala, opciones.origen,
+                                         opciones.digest, opciones.manifiesto);
         
-        double tiempoBase = processor.ejecutarProcesoBase();
-        double tiempoOptimizado = processor.ejecutarProcesoOptimizado(tiempoBase);
+        double tiempoBase = 0.0;
+        for (size_t m = 0; m < modos.size(); ++m) {
+            double tiempo = processor.ejecutarProceso(modos[m], modos[m] == MODO_BASE ? 0.0 : tiempoBase);
+            if (modos[m] == MODO_BASE) tiempoBase = tiempo;
+        }
+        processor.mostrarEtapas();
+        guardarTraza(opciones);
         
         return 0;
         
@@ -13,6 +13,21 @@
 #include <locale>
 #include <codecvt>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+
+#include "cifrado_simd.h"
+#include "cifrado_escalar.h"
+#include "sha256_multibuffer.h"
+#include "ejecutor_tareas.h"
+#include "archivo_mapeado.h"
+#include "io_uring_lotes.h"
+#include "escritura_directa.h"
+#include "copia_archivos.h"
+#include "buffers_io.h"
+#include "salida_fragmentada.h"
+#include "traza_eventos.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -25,202 +40,232 @@ using namespace std::chrono;
 
 // Optimización: Variables globales para evitar reasignaciones
 static const size_t MAX_THREADS = std::thread::hardware_concurrency();
-static const size_t BUFFER_SIZE = 65536; // 64KB buffer
-
-// Tablas de lookup precalculadas fuera de la clase para C++11
-static const char TABLA_ENCRIPT_LOWER[26] = {
-    'd','e','f','g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v','w','x','y','z','a','b','c'
-};
-static const char TABLA_ENCRIPT_UPPER[26] = {
-    'D','E','F','G','H','I','J','K','L','M','N','O','P','Q','R','S','T','U','V','W','X','Y','Z','A','B','C'
-};
-static const char TABLA_ENCRIPT_DIGITS[10] = {'9','8','7','6','5','4','3','2','1','0'};
-
-static const char TABLA_DECRYPT_LOWER[26] = {
-    'x','y','z','a','b','c','d','e','f','g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v','w'
-};
-static const char TABLA_DECRYPT_UPPER[26] = {
-    'X','Y','Z','A','B','C','D','E','F','G','H','I','J','K','L','M','N','O','P','Q','R','S','T','U','V','W'
-};
-static const char TABLA_DECRYPT_DIGITS[10] = {'9','8','7','6','5','4','3','2','1','0'};
-
-// Constantes SHA256 (primeras 64 raíces cúbicas de los primeros 64 números primos)
-static const uint32_t SHA256_K[64] = {
-    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-};
+static const size_t BUFFER_SIZE = 65536; // 64KB buffer por hilo (buffers_io.h)
+static const char* const RAIZ_ESCALA = "copias";  // árbol de fragmentos con --escala
 
 class FileProcessor {
 private:
     string archivoOriginal;
     int numCopias;
     mutable mutex logMutex;
+    ModoLectura lectura;
+    ModoEscritura escritura;
+    ModoCopia copia;
+    EjecutorTareas ejecutor;    // compartido por las cuatro fases
+    unique_ptr<MotorIoUring> motorIo;   // nulo: I/O con streams
+    unique_ptr<SalidaFragmentada> salida;   // --escala: árbol de fragmentos
     
-    // Función de encriptación ULTRA-OPTIMIZADA con tablas de lookup
-    inline string encriptar(const string& texto) noexcept {
-        string resultado;
-        resultado.reserve(texto.length());
-        
-        const char* data = texto.data();
-        const size_t size = texto.size();
-        
-        for (size_t i = 0; i < size; ++i) {
-            const char c = data[i];
-            if (c >= 'a' && c <= 'z') {
-                resultado += TABLA_ENCRIPT_LOWER[c - 'a'];
-            } else if (c >= 'A' && c <= 'Z') {
-                resultado += TABLA_ENCRIPT_UPPER[c - 'A'];
-            } else if (c >= '0' && c <= '9') {
-                resultado += TABLA_ENCRIPT_DIGITS[c - '0'];
-            } else {
-                resultado += c;
-            }
+    // Encriptación in-place con el kernel SIMD activo (o la tabla escalar
+    // si el CPU no tiene SSE2/AVX2/AVX-512)
+    static void encriptarEnSitio(char* datos, size_t tamano) {
+        KernelCifrado kernel = kernelsCifradoActivos().encriptar;
+        if (kernel != nullptr) {
+            kernel(datos, tamano);
+        } else {
+            encriptarEscalar(datos, tamano);
         }
-        return resultado;
     }
     
-    // Función de desencriptación ULTRA-OPTIMIZADA con tablas de lookup
-    inline string desencriptar(const string& texto) noexcept {
-        string resultado;
-        resultado.reserve(texto.length());
-        
-        const char* data = texto.data();
-        const size_t size = texto.size();
-        
-        for (size_t i = 0; i < size; ++i) {
-            const char c = data[i];
-            if (c >= 'a' && c <= 'z') {
-                resultado += TABLA_DECRYPT_LOWER[c - 'a'];
-            } else if (c >= 'A' && c <= 'Z') {
-                resultado += TABLA_DECRYPT_UPPER[c - 'A'];
-            } else if (c >= '0' && c <= '9') {
-                resultado += TABLA_DECRYPT_DIGITS[c - '0'];
-            } else {
-                resultado += c;
-            }
+    // Desencriptación in-place con el mismo esquema de despacho
+    static void desencriptarEnSitio(char* datos, size_t tamano) {
+        KernelCifrado kernel = kernelsCifradoActivos().desencriptar;
+        if (kernel != nullptr) {
+            kernel(datos, tamano);
+        } else {
+            desencriptarEscalar(datos, tamano);
         }
+    }
+    
+    inline string encriptar(const string& texto) {
+        string resultado(texto);
+        if (!resultado.empty()) encriptarEnSitio(&resultado[0], resultado.size());
         return resultado;
     }
     
-    // Implementación completa de SHA256 (sin librerías externas)
-    inline string generarHashSimple(const string& texto) {
-        return sha256(texto);
+    inline string desencriptar(const string& texto) {
+        string resultado(texto);
+        if (!resultado.empty()) desencriptarEnSitio(&resultado[0], resultado.size());
+        return resultado;
     }
-
-private:
     
-    // Funciones auxiliares SHA256
-    static inline uint32_t rotr(uint32_t x, int n) {
-        return (x >> n) | (x << (32 - n));
+    bool usaMmap() const {
+        return lectura != LECTURA_STREAM;
     }
     
-    static inline uint32_t ch(uint32_t x, uint32_t y, uint32_t z) {
-        return (x & y) ^ (~x & z);
+    bool usaIoUring() const {
+        return motorIo != nullptr;
     }
     
-    static inline uint32_t maj(uint32_t x, uint32_t y, uint32_t z) {
-        return (x & y) ^ (x & z) ^ (y & z);
+    template <class F>
+    static double medirMs(F f) {
+        const auto inicio = high_resolution_clock::now();
+        f();
+        const auto duracion = duration_cast<microseconds>(high_resolution_clock::now() - inicio);
+        return duracion.count() / 1000.0;
     }
     
-    static inline uint32_t sig0(uint32_t x) {
-        return rotr(x, 2) ^ rotr(x, 13) ^ rotr(x, 22);
+    // "N.txt" o, con --escala, la ruta en su fragmento ("copias/3f/N.txt")
+    string nombreArchivo(int i, const char* sufijo) const {
+        if (salida) return salida->ruta(i, sufijo);
+        return to_string(i) + sufijo;
     }
     
-    static inline uint32_t sig1(uint32_t x) {
-        return rotr(x, 6) ^ rotr(x, 11) ^ rotr(x, 25);
+    vector<string> nombresCopias(const char* sufijo) const {
+        vector<string> nombres;
+        nombres.reserve(numCopias);
+        for (int i = 1; i <= numCopias; i++) {
+            nombres.push_back(nombreArchivo(i, sufijo));
+        }
+        return nombres;
     }
     
-    static inline uint32_t gamma0(uint32_t x) {
-        return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3);
+    // Envía una tarea por cada i de [primero, ultimo] (de `paso` en `paso`)
+    // y consume los futures en orden con una ventana del doble de la cola
+    // del ejecutor: los futures guardados no crecen con numCopias
+    template <class Enviar, class Consumir>
+    void procesarEnVentana(int primero, int ultimo, int paso, Enviar enviar, Consumir consumir) {
+        typedef decltype(enviar(primero)) Futuro;
+        deque<Futuro> enVuelo;
+        const size_t ventana = 2 * ejecutor.capacidad();
+        for (int i = primero; i <= ultimo; i += paso) {
+            enVuelo.push_back(enviar(i));
+            if (enVuelo.size() > ventana) {
+                consumir(enVuelo.front());
+                enVuelo.pop_front();
+            }
+        }
+        while (!enVuelo.empty()) {
+            consumir(enVuelo.front());
+            enVuelo.pop_front();
+        }
     }
     
-    static inline uint32_t gamma1(uint32_t x) {
-        return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10);
+    // FASES CON io_uring: el hilo principal encola el I/O de todas las
+    // copias en un solo lote y el ejecutor solo hace el trabajo de CPU
+    void generarCopiasIoUring() {
+        vector<string> contenidoOriginal;
+        motorIo->leerArchivos(vector<string>(1, archivoOriginal), contenidoOriginal);
+        
+        vector<string> nombres = nombresCopias(".txt");
+        vector<EscrituraLote> escrituras(numCopias);
+        for (int k = 0; k < numCopias; k++) {
+            escrituras[k].nombre = nombres[k];
+            escrituras[k].datos = contenidoOriginal[0].data();
+            escrituras[k].tamano = contenidoOriginal[0].size();
+        }
+        motorIo->escribirArchivos(escrituras);
     }
     
-    // Implementación completa de SHA256
-    string sha256(const string& texto) {
-        // Valores iniciales de hash
-        uint32_t h[8] = {
-            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
-            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
-        };
+    void encriptarYGenerarHashIoUring() {
+        vector<string> nombres = nombresCopias(".txt");
+        vector<string> contenidos;
+        motorIo->leerArchivos(nombres, contenidos);
         
-        // Preparar mensaje
-        vector<uint8_t> message(texto.begin(), texto.end());
-        uint64_t original_length = message.size();
-        
-        // Padding
-        message.push_back(0x80);
-        while ((message.size() % 64) != 56) {
-            message.push_back(0x00);
+        vector<string> hashes(numCopias);
+        vector<future<void>> tareas;
+        tareas.reserve(numCopias);
+        for (int k = 0; k < numCopias; k++) {
+            tareas.push_back(ejecutor.enviar([&contenidos, &hashes, k]() {
+                TramoTraza tramo("encriptar", k + 1);
+                if (!contenidos[k].empty()) encriptarEnSitio(&contenidos[k][0], contenidos[k].size());
+                hashes[k] = sha256Hex(contenidos[k].data(), contenidos[k].size());
+            }));
         }
-        
-        // Agregar longitud original en bits (big-endian)
-        uint64_t bit_length = original_length * 8;
-        for (int i = 7; i >= 0; --i) {
-            message.push_back((bit_length >> (i * 8)) & 0xFF);
+        for (auto& tarea : tareas) {
+            tarea.get();
         }
         
-        // Procesar mensaje en chunks de 512 bits
-        for (size_t chunk = 0; chunk < message.size(); chunk += 64) {
-            uint32_t w[64];
-            
-            // Copiar chunk a w[0..15]
-            for (int i = 0; i < 16; ++i) {
-                w[i] = (message[chunk + i * 4] << 24) |
-                       (message[chunk + i * 4 + 1] << 16) |
-                       (message[chunk + i * 4 + 2] << 8) |
-                       (message[chunk + i * 4 + 3]);
-            }
-            
-            // Extender w[16..63]
-            for (int i = 16; i < 64; ++i) {
-                w[i] = gamma1(w[i - 2]) + w[i - 7] + gamma0(w[i - 15]) + w[i - 16];
-            }
-            
-            // Inicializar variables de trabajo
-            uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
-            uint32_t e = h[4], f = h[5], g = h[6], h_var = h[7];
-            
-            // Compresión principal
-            for (int i = 0; i < 64; ++i) {
-                uint32_t t1 = h_var + sig1(e) + ch(e, f, g) + SHA256_K[i] + w[i];
-                uint32_t t2 = sig0(a) + maj(a, b, c);
-                
-                h_var = g;
-                g = f;
-                f = e;
-                e = d + t1;
-                d = c;
-                c = b;
-                b = a;
-                a = t1 + t2;
-            }
-            
-            // Agregar hash comprimido al hash actual
-            h[0] += a; h[1] += b; h[2] += c; h[3] += d;
-            h[4] += e; h[5] += f; h[6] += g; h[7] += h_var;
+        vector<string> nombresHash = nombresCopias(".sha");
+        vector<EscrituraLote> escrituras(2 * numCopias);
+        for (int k = 0; k < numCopias; k++) {
+            escrituras[2 * k].nombre = nombres[k];
+            escrituras[2 * k].datos = contenidos[k].data();
+            escrituras[2 * k].tamano = contenidos[k].size();
+            escrituras[2 * k + 1].nombre = nombresHash[k];
+            escrituras[2 * k + 1].datos = hashes[k].data();
+            escrituras[2 * k + 1].tamano = hashes[k].size();
+        }
+        motorIo->escribirArchivos(escrituras);
+    }
+    
+    void validarYDesencriptarIoUring() {
+        vector<string> nombres = nombresCopias(".txt");
+        vector<string> contenidos, hashesEsperados;
+        motorIo->leerArchivos(nombres, contenidos);
+        motorIo->leerArchivos(nombresCopias(".sha"), hashesEsperados);
+        
+        // Grupos del ancho del motor multi-buffer, como validarGrupo
+        const int ancho = static_cast<int>(motorSha256Multiple().carriles);
+        vector<char> validos(numCopias, 0);
+        vector<future<void>> tareas;
+        for (int primero = 0; primero < numCopias; primero += ancho) {
+            const int ultimo = min(numCopias, primero + ancho) - 1;
+            tareas.push_back(ejecutor.enviar([&, primero, ultimo]() {
+                TramoTraza tramo("validar", primero + 1, ultimo + 1);
+                vector<uint8_t> digests((ultimo - primero + 1) * Sha256::TAMANO_DIGEST);
+                PlanificadorHashes planificador;
+                for (int k = primero; k <= ultimo; ++k) {
+                    planificador.agregar(contenidos[k].data(), contenidos[k].size(),
+                                         &digests[(k - primero) * Sha256::TAMANO_DIGEST]);
+                }
+                planificador.ejecutar();
+                for (int k = primero; k <= ultimo; ++k) {
+                    if (digestAHex(&digests[(k - primero) * Sha256::TAMANO_DIGEST]) == hashesEsperados[k]) {
+                        if (!contenidos[k].empty()) desencriptarEnSitio(&contenidos[k][0], contenidos[k].size());
+                        validos[k] = 1;
+                    } else {
+                        log("ERROR: Hash inválido para " + nombres[k]);
+                    }
+                }
+            }));
+        }
+        for (auto& tarea : tareas) {
+            tarea.get();
         }
         
-        // Convertir a string hexadecimal
-        stringstream ss;
-        for (int i = 0; i < 8; ++i) {
-            ss << hex << setfill('0') << setw(8) << h[i];
+        vector<EscrituraLote> escrituras;
+        for (int k = 0; k < numCopias; k++) {
+            if (!validos[k]) continue;
+            EscrituraLote e;
+            e.nombre = nombres[k];
+            e.datos = contenidos[k].data();
+            e.tamano = contenidos[k].size();
+            escrituras.push_back(e);
         }
+        motorIo->escribirArchivos(escrituras);
+    }
+    
+    int compararConOriginalIoUring() {
+        vector<string> original, contenidos;
+        motorIo->leerArchivos(vector<string>(1, archivoOriginal), original);
+        motorIo->leerArchivos(nombresCopias(".txt"), contenidos);
         
-        return ss.str();
+        int errores = 0;
+        for (int k = 0; k < numCopias; k++) {
+            if (contenidos[k] != original[0]) errores++;
+        }
+        return errores;
+    }
+    
+    // Implementación completa de SHA256 (sin librerías externas)
+    inline string generarHashSimple(const string& texto) {
+        return sha256(texto);
+    }
+
+private:
+    
+    // SHA256 con el contexto incremental (sha256.h): sin copiar el
+    // contenido a un vector ni hacer push_back del padding
+    string sha256(const string& texto) {
+        return sha256Hex(texto.data(), texto.size());
     }
     
     // Función de lectura ULTRA-OPTIMIZADA con buffer personalizado
     string leerArchivo(const string& nombreArchivo) {
-        ifstream archivo(nombreArchivo, ios::binary | ios::ate);
+        // Buffer de I/O del hilo: se instala antes de abrir el stream
+        ifstream archivo;
+        archivo.rdbuf()->pubsetbuf(bufferIoDelHilo(), tamanoBufferIo());
+        archivo.open(nombreArchivo, ios::binary | ios::ate);
         if (!archivo.is_open()) {
             throw runtime_error("No se pudo abrir el archivo: " + nombreArchivo);
         }
@@ -239,18 +284,28 @@ private:
     }
     
     // Función de escritura ULTRA-OPTIMIZADA con buffer
-    void escribirArchivo(const string& nombreArchivo, const string& contenido) {
-        ofstream archivo(nombreArchivo, ios::binary);
+    void escribirArchivo(const string& nombreArchivo, const char* datos, size_t tamano) {
+        // O_DIRECT si se pidió y el sistema de archivos lo admite
+        if (escritura == ESCRITURA_DIRECTA && escribirArchivoDirecto(nombreArchivo, datos, tamano)) {
+            return;
+        }
+        
+        // Buffer optimizado para mejor rendimiento: el del hilo, instalado
+        // antes de abrir (después el stream lo ignora)
+        ofstream archivo;
+        archivo.rdbuf()->pubsetbuf(bufferIoDelHilo(), tamanoBufferIo());
+        archivo.open(nombreArchivo, ios::binary);
         if (!archivo.is_open()) {
             throw runtime_error("No se pudo crear el archivo: " + nombreArchivo);
         }
-        
-        // Buffer optimizado para mejor rendimiento
-        archivo.rdbuf()->pubsetbuf(nullptr, BUFFER_SIZE);
-        archivo.write(contenido.data(), contenido.size());
+        archivo.write(datos, tamano);
         archivo.close();
     }
     
+    void escribirArchivo(const string& nombreArchivo, const string& contenido) {
+        escribirArchivo(nombreArchivo, contenido.data(), contenido.size());
+    }
+    
     // Función para configurar la consola para UTF-8 (Windows)
     void configurarConsola() {
         #ifdef _WIN32
@@ -274,42 +329,73 @@ private:
     }
 
 public:
-    FileProcessor(const string& archivo, int copias) 
-        : archivoOriginal(archivo), numCopias(copias) {}
+    // Con IO_URING, si el kernel no permite crear el anillo se usan los
+    // streams (descripcionIo() lo indica). Con `escala` las copias van en el
+    // árbol de fragmentos bajo RAIZ_ESCALA.
+    FileProcessor(const string& archivo, int copias, ModoLectura modoLectura = LECTURA_STREAM,
+                  ModoIo modoIo = IO_STREAM, ModoEscritura modoEscritura = ESCRITURA_CACHE,
+                  ModoCopia modoCopia = COPIA_MEMORIA, bool escala = false) 
+        : archivoOriginal(archivo), numCopias(copias), lectura(modoLectura), escritura(modoEscritura),
+          copia(modoCopia), ejecutor(MAX_THREADS) {
+        if (modoIo == IO_URING) {
+            motorIo.reset(new MotorIoUring());
+            if (!motorIo->activo()) motorIo.reset();
+        }
+        if (escala) {
+            salida.reset(new SalidaFragmentada(RAIZ_ESCALA, copias));
+        }
+    }
+    
+    string descripcionIo() const {
+        if (usaIoUring()) return string("io_uring (") + motorIo->descripcion() + ")";
+        return "stream";
+    }
     
     // Función ULTRA-OPTIMIZADA para generar copias
     double generarCopias() {
-        const auto inicio = high_resolution_clock::now();
-        
+        TramoTraza tramo("fase copias");
+        if (usaIoUring()) return medirMs([this]() { generarCopiasIoUring(); });
         
-        const string contenidoOriginal = std::move(leerArchivo(archivoOriginal));
+        const auto inicio = high_resolution_clock::now();
         
-        // Optimización: Usar pool de threads controlado
-        vector<future<void>> tareas;
-        tareas.reserve(numCopias);
+        // Copia del lado del kernel: no hace falta leer el original
+        if (copia == COPIA_KERNEL) {
+            reiniciarContadoresCopia();
+            procesarEnVentana(1, numCopias, 1, [this](int i) {
+                return ejecutor.enviar([this, i]() {
+                    TramoTraza tramo("copia", i);
+                    copiarArchivo(archivoOriginal, nombreArchivo(i, ".txt"));
+                });
+            }, [](future<void>& tarea) { tarea.get(); });
+            const auto duracion = duration_cast<microseconds>(high_resolution_clock::now() - inicio);
+            return duracion.count() / 1000.0;
+        }
         
-        const size_t threads_activos = min(static_cast<size_t>(numCopias), MAX_THREADS);
         
-        for (int i = 1; i <= numCopias; i++) {
-            tareas.emplace_back(async(launch::async, [this, i, &contenidoOriginal]() {
-                const string nombreCopia = to_string(i) + ".txt";
-                escribirArchivo(nombreCopia, contenidoOriginal);
-            }));
-            
-            // Control de threads: esperar si tenemos demasiados activos
-            if (i % threads_activos == 0) {
-                for (auto& tarea : tareas) {
-                    if (tarea.valid()) tarea.wait();
-                }
-                tareas.clear();
-                tareas.reserve(min(numCopias - i, static_cast<int>(threads_activos)));
-            }
+        // Con mmap las copias se escriben desde las páginas del original
+        string contenidoLeido;
+        ArchivoMapeado originalMapeado;
+        const char* datosOriginal;
+        size_t tamanoOriginal;
+        if (usaMmap()) {
+            originalMapeado.abrir(archivoOriginal, MAPEO_LECTURA, lectura);
+            datosOriginal = originalMapeado.datos();
+            tamanoOriginal = originalMapeado.tamano();
+        } else {
+            contenidoLeido = leerArchivo(archivoOriginal);
+            datosOriginal = contenidoLeido.data();
+            tamanoOriginal = contenidoLeido.size();
         }
         
-        // Esperar tareas restantes
-        for (auto& tarea : tareas) {
-            if (tarea.valid()) tarea.wait();
-        }
+        // Pool de threads controlado: la cola acotada del ejecutor limita
+        // las tareas en vuelo sin esperar a que termine cada tanda
+        procesarEnVentana(1, numCopias, 1, [this, datosOriginal, tamanoOriginal](int i) {
+            return ejecutor.enviar([this, i, datosOriginal, tamanoOriginal]() {
+                TramoTraza tramo("copia", i);
+                const string nombreCopia = nombreArchivo(i, ".txt");
+                escribirArchivo(nombreCopia, datosOriginal, tamanoOriginal);
+            });
+        }, [](future<void>& tarea) { tarea.get(); });
         
         const auto fin = high_resolution_clock::now();
         const auto duracion = duration_cast<microseconds>(fin - inicio);
@@ -319,72 +405,111 @@ public:
     
     // Función para encriptar archivos y generar hash
     double encriptarYGenerarHash() {
+        TramoTraza tramo("fase encriptar");
+        if (usaIoUring()) return medirMs([this]() { encriptarYGenerarHashIoUring(); });
+        
         auto inicio = high_resolution_clock::now();
         
         
-        vector<future<void>> tareas;
-        for (int i = 1; i <= numCopias; i++) {
-            tareas.push_back(async(launch::async, [this, i]() {
-                string nombreArchivo = to_string(i) + ".txt";
-                string contenido = leerArchivo(nombreArchivo);
+        procesarEnVentana(1, numCopias, 1, [this](int i) {
+            return ejecutor.enviar([this, i]() {
+                TramoTraza tramo("encriptar", i);
+                string nombre = nombreArchivo(i, ".txt");
+                string hash;
                 
-                // Encriptar contenido
-                string contenidoEncriptado = encriptar(contenido);
-                escribirArchivo(nombreArchivo, contenidoEncriptado);
-                
-                // Generar hash simple
-                string hash = generarHashSimple(contenidoEncriptado);
-                string nombreHash = to_string(i) + ".sha";
+                if (usaMmap()) {
+                    // Encriptar las páginas del archivo mapeado compartido
+                    // (sin read/write) y hashearlas en el mismo mapeo
+                    ArchivoMapeado mapa(nombre, MAPEO_COMPARTIDO, lectura);
+                    encriptarEnSitio(mapa.datos(), mapa.tamano());
+                    hash = sha256Hex(mapa.datos(), mapa.tamano());
+                } else {
+                    string contenido = leerArchivo(nombre);
+                    
+                    // Encriptar contenido
+                    string contenidoEncriptado = encriptar(contenido);
+                    escribirArchivo(nombre, contenidoEncriptado);
+                    
+                    // Generar hash simple
+                    hash = generarHashSimple(contenidoEncriptado);
+                }
+                string nombreHash = nombreArchivo(i, ".sha");
                 escribirArchivo(nombreHash, hash);
-            }));
-        }
-        
-        // Esperar a que todas las tareas terminen
-        for (auto& tarea : tareas) {
-            tarea.wait();
-        }
+            });
+        }, [](future<void>& tarea) {
+            // Esperar a que cada tarea termine
+            tarea.get();
+        });
         
         auto fin = high_resolution_clock::now();
         auto duracion = duration_cast<microseconds>(fin - inicio);
         return duracion.count() / 1000.0; // Retornar en milisegundos
     }
     
-    // Función para validar hash y desencriptar
-    double validarYDesencriptar() {
-        auto inicio = high_resolution_clock::now();
-        vector<future<bool>> tareas;
-        for (int i = 1; i <= numCopias; i++) {
-            tareas.push_back(async(launch::async, [this, i]() {
-                string nombreArchivo = to_string(i) + ".txt";
-                string nombreHash = to_string(i) + ".sha";
-                
-                // Leer archivo encriptado y hash
-                string contenidoEncriptado = leerArchivo(nombreArchivo);
-                string hashEsperado = leerArchivo(nombreHash);
-                
-                // Validar hash
-                string hashCalculado = generarHashSimple(contenidoEncriptado);
-                bool hashValido = (hashCalculado == hashEsperado);
-                
-                if (hashValido) {
-                    // Desencriptar contenido
-                    string contenidoDesencriptado = desencriptar(contenidoEncriptado);
-                    escribirArchivo(nombreArchivo, contenidoDesencriptado);
-                } else {
-                    log("ERROR: Hash inválido para " + nombreArchivo);
-                }
-                
-                return hashValido;
-            }));
+    // Valida y desencripta los archivos [primero, ultimo] como un grupo: los
+    // hashes se calculan juntos en los carriles SIMD del motor multi-buffer
+    int validarGrupo(int primero, int ultimo) {
+        TramoTraza tramo("validar", primero, ultimo);
+        const int cantidad = ultimo - primero + 1;
+        vector<string> contenidos(cantidad);
+        vector<ArchivoMapeado> mapas(cantidad);
+        vector<string> hashesEsperados(cantidad);
+        vector<uint8_t> digests(cantidad * Sha256::TAMANO_DIGEST);
+        PlanificadorHashes planificador;
+        
+        // Leer archivos encriptados y hashes
+        for (int k = 0; k < cantidad; ++k) {
+            hashesEsperados[k] = leerArchivo(nombreArchivo(primero + k, ".sha"));
+            if (usaMmap()) {
+                mapas[k].abrir(nombreArchivo(primero + k, ".txt"), MAPEO_COMPARTIDO, lectura);
+                planificador.agregar(mapas[k].datos(), mapas[k].tamano(), &digests[k * Sha256::TAMANO_DIGEST]);
+            } else {
+                contenidos[k] = leerArchivo(nombreArchivo(primero + k, ".txt"));
+                planificador.agregar(contenidos[k].data(), contenidos[k].size(), &digests[k * Sha256::TAMANO_DIGEST]);
+            }
         }
         
-        // Esperar a que todas las tareas terminen y contar errores
+        // Validar hashes
+        planificador.ejecutar();
+        
         int errores = 0;
-        for (auto& tarea : tareas) {
-            if (!tarea.get()) {
+        for (int k = 0; k < cantidad; ++k) {
+            string nombre = nombreArchivo(primero + k, ".txt");
+            bool hashValido = (digestAHex(&digests[k * Sha256::TAMANO_DIGEST]) == hashesEsperados[k]);
+            
+            if (hashValido && usaMmap()) {
+                // Desencriptar en el mapeo compartido: se escribe al archivo
+                desencriptarEnSitio(mapas[k].datos(), mapas[k].tamano());
+            } else if (hashValido) {
+                // Desencriptar contenido
+                string contenidoDesencriptado = desencriptar(contenidos[k]);
+                escribirArchivo(nombre, contenidoDesencriptado);
+            } else {
+                log("ERROR: Hash inválido para " + nombre);
                 errores++;
             }
         }
+        return errores;
+    }
+    
+    // Función para validar hash y desencriptar
+    double validarYDesencriptar() {
+        TramoTraza tramo("fase validar");
+        if (usaIoUring()) return medirMs([this]() { validarYDesencriptarIoUring(); });
+        
+        auto inicio = high_resolution_clock::now();
+        
+        // Un grupo por pasada del motor multi-buffer (1 archivo con SHA-NI)
+        const int ancho = static_cast<int>(motorSha256Multiple().carriles);
+        
+        // Esperar a que todas las tareas terminen y contar errores
+        int errores = 0;
+        procesarEnVentana(1, numCopias, ancho, [this, ancho](int primero) {
+            const int ultimo = min(numCopias, primero + ancho - 1);
+            return ejecutor.enviar([this, primero, ultimo]() {
+                return validarGrupo(primero, ultimo);
+            });
+        }, [&errores](future<int>& tarea) { errores += tarea.get(); });
         
         auto fin = high_resolution_clock::now();
         auto duracion = duration_cast<microseconds>(fin - inicio);
@@ -393,28 +518,41 @@ public:
     
     // Función para comparar archivos con el original
     double compararConOriginal() {
-        auto inicio = high_resolution_clock::now();
+        TramoTraza tramo("fase comparar");
+        if (usaIoUring()) return medirMs([this]() { compararConOriginalIoUring(); });
         
-        string contenidoOriginal = leerArchivo(archivoOriginal);
+        auto inicio = high_resolution_clock::now();
         
-        vector<future<bool>> tareas;
-        for (int i = 1; i <= numCopias; i++) {
-            tareas.push_back(async(launch::async, [this, i, contenidoOriginal]() {
-                string nombreArchivo = to_string(i) + ".txt";
-                string contenidoArchivo = leerArchivo(nombreArchivo);
-                
-                bool esIgual = (contenidoArchivo == contenidoOriginal);                
-                return esIgual;
-            }));
+        string contenidoOriginal;
+        ArchivoMapeado originalMapeado;
+        if (usaMmap()) {
+            originalMapeado.abrir(archivoOriginal, MAPEO_LECTURA, lectura);
+        } else {
+            contenidoOriginal = leerArchivo(archivoOriginal);
         }
         
         // Esperar a que todas las tareas terminen y contar errores
         int errores = 0;
-        for (auto& tarea : tareas) {
+        procesarEnVentana(1, numCopias, 1, [this, &contenidoOriginal, &originalMapeado](int i) {
+            return ejecutor.enviar([this, i, &contenidoOriginal, &originalMapeado]() -> bool {
+                TramoTraza tramo("comparar", i);
+                string nombre = nombreArchivo(i, ".txt");
+                if (usaMmap()) {
+                    // Comparar las páginas mapeadas sin copiarlas
+                    ArchivoMapeado mapa(nombre, MAPEO_LECTURA, lectura);
+                    return mapa.tamano() == originalMapeado.tamano() &&
+                           memcmp(mapa.datos(), originalMapeado.datos(), mapa.tamano()) == 0;
+                }
+                string contenidoArchivo = leerArchivo(nombre);
+                
+                bool esIgual = (contenidoArchivo == contenidoOriginal);                
+                return esIgual;
+            });
+        }, [&errores](future<bool>& tarea) {
             if (!tarea.get()) {
                 errores++;
             }
-        }
+        });
         
         auto fin = high_resolution_clock::now();
         auto duracion = duration_cast<microseconds>(fin - inicio);
@@ -423,6 +561,12 @@ public:
     
     // Función para limpiar archivos temporales
     void limpiarArchivos() {
+        if (salida) {
+            static const char* const SUFIJOS[] = {".txt", ".sha"};
+            salida->eliminar(SUFIJOS, 2);
+            salida.reset();
+            return;
+        }
         for (int i = 1; i <= numCopias; i++) {
             string nombreTxt = to_string(i) + ".txt";
             string nombreSha = to_string(i) + ".sha";
@@ -452,6 +596,9 @@ public:
         
         double tiempo1 = generarCopias();
         cout << "Tiempo 01: " << fixed << setprecision(3) << tiempo1 << " ms" << endl;
+        if (copia == COPIA_KERNEL && !usaIoUring()) {
+            cout << "Copia: " << resumenEstrategiasCopia() << endl;
+        }
         
         double tiempo2 = encriptarYGenerarHash();
         cout << "Tiempo 02: " << fixed << setprecision(3) << tiempo2 << " ms" << endl;
@@ -471,12 +618,70 @@ public:
         
         double tiempoTotalProceso = tiempo1 + tiempo2 + tiempo3 + tiempo4;
         cout << "TT: " << fixed << setprecision(3) << tiempoTotalProceso << " ms" << endl;
+        EstadisticasBuffersIo buffers = estadisticasBuffersIo();
+        cout << "BUF: " << buffers.usos << " reutilizados, " << buffers.reservas << " reservados" << endl;
         limpiarArchivos();
     }
 };
 
-int main() {
+struct Opciones {
+    ModoLectura lectura;
+    ModoIo io;
+    ModoEscritura escritura;
+    ModoCopia copia;
+    size_t bufferBytes;
+    bool escala;
+    string rutaTraza;
+};
+
+// --lectura=stream|mmap|mmap-perezoso elige cómo se leen los archivos,
+// --io=stream|uring cómo se hace el I/O de las copias y
+// --escritura=cache|directa si las escrituras pasan por la cache de páginas
+// y --copia=memoria|kernel cómo se generan las copias (por defecto el
+// camino original). --buffer-kb=N cambia el buffer de I/O por hilo. Con io_uring el I/O va por el anillo aunque se pida
+// mmap, escritura directa o copia del kernel. --escala quita el límite de
+// 50 copias y las guarda fragmentadas bajo RAIZ_ESCALA. --trace=ruta guarda
+// al terminar la línea de tiempo de cada hilo (una tarea por archivo y fase)
+// en formato Chrome trace-event.
+static Opciones parsearOpciones(int argc, char* argv[]) {
+    Opciones opciones = {LECTURA_STREAM, IO_STREAM, ESCRITURA_CACHE, COPIA_MEMORIA, BUFFER_SIZE, false, ""};
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool valido = false;
+        if (arg.compare(0, 10, "--lectura=") == 0) {
+            valido = parsearModoLectura(arg.substr(10), opciones.lectura);
+        } else if (arg.compare(0, 5, "--io=") == 0) {
+            valido = parsearModoIo(arg.substr(5), opciones.io);
+        } else if (arg.compare(0, 12, "--escritura=") == 0) {
+            valido = parsearModoEscritura(arg.substr(12), opciones.escritura);
+        } else if (arg.compare(0, 8, "--copia=") == 0) {
+            valido = parsearModoCopia(arg.substr(8), opciones.copia);
+        } else if (arg.compare(0, 12, "--buffer-kb=") == 0) {
+            int kb = atoi(arg.c_str() + 12);
+            valido = kb >= 4 && kb <= 1024 * 1024;
+            opciones.bufferBytes = static_cast<size_t>(kb) * 1024;
+        } else if (arg == "--escala") {
+            valido = true;
+            opciones.escala = true;
+        } else if (arg.compare(0, 8, "--trace=") == 0) {
+            opciones.rutaTraza = arg.substr(8);
+            valido = !opciones.rutaTraza.empty();
+        }
+        if (!valido) {
+            throw runtime_error("Argumento desconocido: " + arg);
+        }
+    }
+    // io_uring lee y escribe todas las copias de una fase en un lote
+    if (opciones.escala && opciones.io == IO_URING) {
+        throw runtime_error("--io=uring no se puede combinar con --escala");
+    }
+    return opciones;
+}
+
+int main(int argc, char* argv[]) {
     try {
+        Opciones opciones = parsearOpciones(argc, argv);
+        
         // Configurar consola para UTF-8 y caracteres especiales
         #ifdef _WIN32
         SetConsoleOutputCP(CP_UTF8);
@@ -487,6 +692,15 @@ int main() {
         cout << "Mejorando el performance de manejo de archivos" << endl;
         cout << "Versión ULTRA-OPTIMIZADA con SHA256 REAL" << endl;
         cout << "Threads disponibles: " << MAX_THREADS << endl;
+        cout << "Lectura: " << nombreModoLectura(opciones.lectura) << endl;
+        cout << "Escritura: " << nombreModoEscritura(opciones.escritura) << endl;
+        cout << "Copia de archivos: " << nombreModoCopia(opciones.copia) << endl;
+        configurarTamanoBufferIo(opciones.bufferBytes);
+        cout << "Buffer de I/O: " << tamanoBufferIo() / 1024 << " KB por hilo" << endl;
+        NivelSimd nivelSimd = inicializarCifradoSimd(encriptarEscalar, desencriptarEscalar);
+        cout << "Cifrado SIMD: " << nombreNivelSimd(nivelSimd) << endl;
+        cout << "SHA-256: " << implementacionSha256().nombre
+             << " (validación: " << motorSha256Multiple().nombre << ")" << endl;
         ifstream checkFile("original.txt");
         if (!checkFile.good()) {
             cout << "Error: No se encontró el archivo original.txt" << endl;
@@ -495,19 +709,39 @@ int main() {
         checkFile.close();
         
         int numCopias;
-        cout << "Ingrese el número de copias a generar (máximo 50): ";
+        if (opciones.escala) {
+            cout << "Ingrese el número de copias a generar: ";
+        } else {
+            cout << "Ingrese el número de copias a generar (máximo 50): ";
+        }
         cin >> numCopias;
         
-        if (numCopias < 1 || numCopias > 50) {
-            cout << "Error: El número de copias debe estar entre 1 y 50" << endl;
+        if (!cin || numCopias < 1 || (!opciones.escala && numCopias > 50)) {
+            cout << "Error: El número de copias debe estar entre 1 y 50 (sin límite con --escala)" << endl;
             return 1;
         }
         
+        // Antes de crear el ejecutor: sus hilos registran su buffer al trazar
+        if (!opciones.rutaTraza.empty()) {
+            activarTraza();
+        }
+        
         // Crear procesador de archivos
-        FileProcessor procesador("original.txt", numCopias);
+        FileProcessor procesador("original.txt", numCopias, opciones.lectura, opciones.io,
+                                 opciones.escritura, opciones.copia, opciones.escala);
+        cout << "I/O: " << procesador.descripcionIo() << endl;
         
         // Ejecutar el proceso
         procesador.ejecutarProceso();
+        if (!opciones.rutaTraza.empty()) {
+            uint64_t perdidos = 0;
+            size_t eventos = escribirTraza(opciones.rutaTraza, perdidos);
+            cout << "Traza: " << eventos << " eventos en " << opciones.rutaTraza;
+            if (perdidos > 0) {
+                cout << " (" << perdidos << " pisados por buffer lleno)";
+            }
+            cout << endl;
+        }
         return 0;
         
     } catch (const exception& e) {
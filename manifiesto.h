@@ -0,0 +1,167 @@
+// Manifiesto binario de hashes (--sha=manifiesto).
+// En vez de un N.sha de 64 caracteres hex por copia (crear, escribir y
+// cerrar un archivo para guardar 32 bytes, y en el proceso base abrirlo y
+// leerlo otra vez) todos los digests van a un unico archivo de registros
+// de tamano fijo. Solo se agrega al final: cada hilo junta sus registros y
+// los escribe de a lotes con una sola escritura, y la validacion lo lee
+// mapeado en memoria. exportar_manifiesto.cpp genera los .sha por archivo
+// a partir de el.
+//
+// Formato (orden de bytes del host):
+//   cabecera de 64 bytes: "SHAMANI1", version, tamano de registro
+//   registros de 64 bytes: numero, tamano, digest SHA-256, banderas
+#ifndef MANIFIESTO_H
+#define MANIFIESTO_H
+
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <stdint.h>
+#include "archivo_mapeado.h"
+#include "salida_fragmentada.h"
+
+static const char* const RUTA_MANIFIESTO = "hashes.manifiesto";
+static const uint32_t VERSION_MANIFIESTO = 1;
+// Registros que junta cada hilo antes de escribirlos
+static const size_t REGISTROS_POR_ESCRITURA = 256;
+
+struct CabeceraManifiesto {
+    char magia[8];              // "SHAMANI1"
+    uint32_t version;
+    uint32_t tamanoRegistro;
+    uint8_t reservado[48];
+};
+
+struct RegistroManifiesto {
+    uint64_t numero;            // numero de archivo (N de N.txt)
+    uint64_t tamano;            // bytes del archivo hasheado
+    uint8_t digest[32];
+    uint32_t banderas;          // 0 = digest plano del archivo (el resto, reservado)
+    uint32_t reservado;
+    uint64_t reservado2;
+};
+
+static_assert(sizeof(CabeceraManifiesto) == 64, "cabecera del manifiesto de 64 bytes");
+static_assert(sizeof(RegistroManifiesto) == 64, "registro del manifiesto de 64 bytes");
+
+static inline RegistroManifiesto registroManifiesto(unsigned long long numero, unsigned long long tamano,
+                                                    const uint8_t digest[32]) {
+    RegistroManifiesto registro;
+    memset(&registro, 0, sizeof(registro));
+    registro.numero = numero;
+    registro.tamano = tamano;
+    memcpy(registro.digest, digest, 32);
+    return registro;
+}
+
+// Escritor compartido por los hilos de una ejecucion. Crea el archivo (o lo
+// vacia) y escribe la cabecera; despues solo agrega lotes de registros.
+class Manifiesto {
+public:
+    explicit Manifiesto(const std::string& ruta) : ruta_(ruta), registros(0), escrituras(0) {
+        fd = abrirArchivoFd(ruta.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND);
+        if (fd < 0) {
+            throw std::runtime_error("No se pudo crear el manifiesto " + ruta + ": " + strerror(errno));
+        }
+        CabeceraManifiesto cabecera;
+        memset(&cabecera, 0, sizeof(cabecera));
+        memcpy(cabecera.magia, "SHAMANI1", 8);
+        cabecera.version = VERSION_MANIFIESTO;
+        cabecera.tamanoRegistro = sizeof(RegistroManifiesto);
+        if (!escribirCompletoFd(fd, reinterpret_cast<const char*>(&cabecera), sizeof(cabecera))) {
+            cerrarFd(fd);
+            throw std::runtime_error("No se pudo escribir el manifiesto " + ruta);
+        }
+        tamano = sizeof(cabecera);
+    }
+
+    ~Manifiesto() {
+        cerrarFd(fd);
+    }
+
+    // Agrega `n` registros con una sola escritura; devuelve el desplazamiento
+    // del primero (lo que ya esta escrito se puede leer mapeado)
+    unsigned long long agregar(const RegistroManifiesto* lote, size_t n) {
+        std::lock_guard<std::mutex> lock(cerrojo);
+        unsigned long long desplazamiento = tamano;
+        if (n == 0) return desplazamiento;
+        if (!escribirCompletoFd(fd, reinterpret_cast<const char*>(lote), n * sizeof(RegistroManifiesto))) {
+            throw std::runtime_error("No se pudo escribir el manifiesto " + ruta_);
+        }
+        tamano += n * sizeof(RegistroManifiesto);
+        registros += n;
+        ++escrituras;
+        return desplazamiento;
+    }
+
+    const std::string& ruta() const {
+        return ruta_;
+    }
+
+    unsigned long long numRegistros() const {
+        return registros;
+    }
+
+    unsigned long long numEscrituras() const {
+        return escrituras;
+    }
+
+private:
+    std::string ruta_;
+    int fd;
+    std::mutex cerrojo;
+    unsigned long long tamano;
+    unsigned long long registros;
+    unsigned long long escrituras;
+
+    Manifiesto(const Manifiesto&);
+    Manifiesto& operator=(const Manifiesto&);
+};
+
+// Lectura del manifiesto mapeado en memoria
+class ManifiestoMapeado {
+public:
+    // Lanza runtime_error si el archivo no es un manifiesto valido
+    void abrir(const std::string& ruta, ModoLectura modo = LECTURA_MMAP_PEREZOSO) {
+        mapa.abrir(ruta, MAPEO_LECTURA, modo);
+        const CabeceraManifiesto* cabecera = reinterpret_cast<const CabeceraManifiesto*>(mapa.datos());
+        if (mapa.tamano() < sizeof(CabeceraManifiesto) || memcmp(cabecera->magia, "SHAMANI1", 8) != 0 ||
+            cabecera->version != VERSION_MANIFIESTO || cabecera->tamanoRegistro != sizeof(RegistroManifiesto)) {
+            mapa.cerrar();
+            throw std::runtime_error("Manifiesto invalido: " + ruta);
+        }
+    }
+
+    // Registros completos (un lote a medio escribir no se cuenta)
+    size_t numRegistros() const {
+        return (mapa.tamano() - sizeof(CabeceraManifiesto)) / sizeof(RegistroManifiesto);
+    }
+
+    const RegistroManifiesto& registro(size_t i) const {
+        return primero()[i];
+    }
+
+    // Registro en el desplazamiento que devolvio Manifiesto::agregar; NULL si
+    // queda fuera de lo mapeado
+    const RegistroManifiesto* registroEn(unsigned long long desplazamiento) const {
+        if (desplazamiento < sizeof(CabeceraManifiesto) ||
+            desplazamiento + sizeof(RegistroManifiesto) > mapa.tamano()) {
+            return NULL;
+        }
+        return reinterpret_cast<const RegistroManifiesto*>(mapa.datos() + desplazamiento);
+    }
+
+    void cerrar() {
+        mapa.cerrar();
+    }
+
+private:
+    const RegistroManifiesto* primero() const {
+        return reinterpret_cast<const RegistroManifiesto*>(mapa.datos() + sizeof(CabeceraManifiesto));
+    }
+
+    ArchivoMapeado mapa;
+};
+
+#endif
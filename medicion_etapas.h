@@ -0,0 +1,341 @@
+// Medicion por etapa del bucle de trabajo (compilar con -DMEDIR_ETAPAS).
+// Cada hilo lleva un CronometroEtapas por archivo: marcar(etapa) anota el
+// tiempo desde la marca anterior en el histograma de esa etapa, asi una
+// sola lectura del reloj cierra un tramo y abre el siguiente. Los
+// histogramas son del hilo (solo el los escribe: sin atomicos ni
+// cerrojos) y log-lineales al estilo HDR: 16 subdivisiones por potencia de
+// 2, error relativo menor al 6.25%. Al terminar una ejecucion, con los
+// hilos ya parados, combinarHistogramasEtapas() los suma y los vacia.
+//
+// Con los contadores de hardware activos (--contadores, ver contadores_hw.h)
+// cada marca lee ademas el grupo del hilo y suma lo contado a la etapa que
+// cierra; esa read() cae en el tramo siguiente.
+//
+// Con la traza activa (--trace, ver traza_eventos.h) cada tramo tambien
+// queda en la linea de tiempo del hilo, con o sin MEDIR_ETAPAS.
+//
+// Sin MEDIR_ETAPAS los histogramas son clases vacias y el cronometro solo
+// lee el reloj si hay traza: sin ella no deja nada en el bucle.
+#ifndef MEDICION_ETAPAS_H
+#define MEDICION_ETAPAS_H
+
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "traza_eventos.h"
+
+#ifdef MEDIR_ETAPAS
+#include <cstring>
+#include <mutex>
+#include "contadores_hw.h"
+#endif
+
+enum Etapa {
+    ETAPA_COPIA,                // escribir N.txt (la copia del original)
+    ETAPA_LEER,                 // leer o mapear un archivo
+    ETAPA_ENCRIPTAR,
+    ETAPA_ESCRIBIR_CIFRADO,
+    ETAPA_HASH,
+    ETAPA_ESCRIBIR_SHA,         // .sha o registro del manifiesto
+    ETAPA_LEER_SHA,
+    ETAPA_VALIDAR,              // hash de validacion y comparacion de digests
+    ETAPA_DESENCRIPTAR,
+    ETAPA_ESCRIBIR_SALIDA,      // N_2.txt
+    ETAPA_COMPARAR,             // desencriptado contra el original
+    NUM_ETAPAS
+};
+
+static inline const char* nombreEtapa(int etapa) {
+    static const char* const NOMBRES[NUM_ETAPAS] = {
+        "escribir original", "leer", "encriptar", "escribir cifrado", "hash", "escribir .sha",
+        "leer .sha", "validar", "desencriptar", "escribir salida", "comparar"};
+    return etapa >= 0 && etapa < NUM_ETAPAS ? NOMBRES[etapa] : "?";
+}
+
+#ifdef MEDIR_ETAPAS
+
+static const bool ETAPAS_ACTIVAS = true;
+
+// Buckets: los valores < 16 ns tienen uno cada uno; desde ahi cada potencia
+// de 2 se parte en 16. Hasta 2^40 ns (unos 18 minutos), lo demas satura.
+static const int BITS_SUBBUCKET = 4;
+static const int SUBBUCKETS = 1 << BITS_SUBBUCKET;
+static const int MAXIMA_POTENCIA = 40;
+static const int NUM_BUCKETS = (MAXIMA_POTENCIA - BITS_SUBBUCKET + 2) * SUBBUCKETS;
+
+static inline int bucketLatencia(uint64_t ns) {
+    if (ns < static_cast<uint64_t>(SUBBUCKETS)) return static_cast<int>(ns);
+    int potencia = 63 - __builtin_clzll(ns);
+    if (potencia > MAXIMA_POTENCIA) return NUM_BUCKETS - 1;
+    int sub = static_cast<int>((ns >> (potencia - BITS_SUBBUCKET)) & (SUBBUCKETS - 1));
+    return (potencia - BITS_SUBBUCKET + 1) * SUBBUCKETS + sub;
+}
+
+// Valor representativo del bucket: el punto medio de su rango
+static inline double valorBucket(int bucket) {
+    if (bucket < SUBBUCKETS) return bucket;
+    int potencia = bucket / SUBBUCKETS + BITS_SUBBUCKET - 1;
+    int sub = bucket % SUBBUCKETS;
+    double ancho = static_cast<double>(1ULL << (potencia - BITS_SUBBUCKET));
+    return (SUBBUCKETS + sub) * ancho + ancho / 2;
+}
+
+struct HistogramaLatencias {
+    uint64_t cuentas[NUM_BUCKETS];
+    uint64_t n;
+    uint64_t sumaNs;
+    uint64_t maximoNs;
+
+    HistogramaLatencias() {
+        reiniciar();
+    }
+
+    void reiniciar() {
+        memset(cuentas, 0, sizeof(cuentas));
+        n = 0;
+        sumaNs = 0;
+        maximoNs = 0;
+    }
+
+    void agregar(uint64_t ns) {
+        ++cuentas[bucketLatencia(ns)];
+        ++n;
+        sumaNs += ns;
+        maximoNs = ns > maximoNs ? ns : maximoNs;
+    }
+
+    void combinar(const HistogramaLatencias& otro) {
+        for (int i = 0; i < NUM_BUCKETS; ++i) {
+            cuentas[i] += otro.cuentas[i];
+        }
+        n += otro.n;
+        sumaNs += otro.sumaNs;
+        maximoNs = otro.maximoNs > maximoNs ? otro.maximoNs : maximoNs;
+    }
+
+    // p en [0, 100], en ns
+    double percentil(double p) const {
+        if (n == 0) return 0.0;
+        uint64_t objetivo = static_cast<uint64_t>(p / 100.0 * n + 0.5);
+        objetivo = objetivo < 1 ? 1 : objetivo;
+        uint64_t acumulado = 0;
+        for (int i = 0; i < NUM_BUCKETS; ++i) {
+            acumulado += cuentas[i];
+            if (acumulado >= objetivo) {
+                // El punto medio del ultimo bucket puede pasar del maximo real
+                double valor = valorBucket(i);
+                return valor < maximoNs ? valor : static_cast<double>(maximoNs);
+            }
+        }
+        return static_cast<double>(maximoNs);
+    }
+};
+
+struct HistogramasEtapas {
+    HistogramaLatencias etapas[NUM_ETAPAS];
+    LecturaContadoresHw contadores[NUM_ETAPAS];     // vacios sin --contadores
+
+    void combinar(const HistogramasEtapas& otro) {
+        for (int e = 0; e < NUM_ETAPAS; ++e) {
+            etapas[e].combinar(otro.etapas[e]);
+            contadores[e].combinar(otro.contadores[e]);
+        }
+    }
+
+    void reiniciar() {
+        for (int e = 0; e < NUM_ETAPAS; ++e) {
+            etapas[e].reiniciar();
+            contadores[e].reiniciar();
+        }
+    }
+};
+
+// Histogramas de todos los hilos que midieron algo. No se liberan: el
+// de un hilo que termino se sigue sumando (vacio) en las combinaciones.
+static inline std::vector<HistogramasEtapas*>& registroHistogramasEtapas() {
+    static std::vector<HistogramasEtapas*> registro;
+    return registro;
+}
+
+static inline std::mutex& cerrojoRegistroEtapas() {
+    static std::mutex cerrojo;
+    return cerrojo;
+}
+
+// El cerrojo solo se toma la primera vez que mide cada hilo
+static inline HistogramasEtapas& histogramasDelHilo() {
+    static thread_local HistogramasEtapas* propios = NULL;
+    if (propios == NULL) {
+        propios = new HistogramasEtapas();
+        std::lock_guard<std::mutex> lock(cerrojoRegistroEtapas());
+        registroHistogramasEtapas().push_back(propios);
+    }
+    return *propios;
+}
+
+// Suma en `destino` lo medido por todos los hilos desde la ultima
+// combinacion y lo vacia. Llamar con los hilos de trabajo detenidos.
+static inline void combinarHistogramasEtapas(HistogramasEtapas& destino) {
+    std::lock_guard<std::mutex> lock(cerrojoRegistroEtapas());
+    std::vector<HistogramasEtapas*>& registro = registroHistogramasEtapas();
+    for (size_t i = 0; i < registro.size(); ++i) {
+        destino.combinar(*registro[i]);
+        registro[i]->reiniciar();
+    }
+}
+
+static inline void descartarHistogramasEtapas() {
+    HistogramasEtapas descartados;
+    combinarHistogramasEtapas(descartados);
+}
+
+class CronometroEtapas {
+public:
+    CronometroEtapas() : histogramas(histogramasDelHilo()), contadores(grupoContadoresDelHilo()), ultimo(nsTraza()) {
+        if (contadores != NULL) contadores->leer(ultimaMuestra);
+    }
+
+    // Cierra el tramo abierto como `etapa` y abre el siguiente
+    void marcar(Etapa etapa) {
+        uint64_t ahora = nsTraza();
+        histogramas.etapas[etapa].agregar(ahora - ultimo);
+        if (trazaActiva()) registrarTramoTraza(nombreEtapa(etapa), ultimo, ahora);
+        ultimo = ahora;
+        MuestraContadoresHw muestra;
+        if (contadores != NULL && contadores->leer(muestra)) {
+            acumularDiferenciaHw(histogramas.contadores[etapa], muestra, ultimaMuestra);
+            ultimaMuestra = muestra;
+        }
+    }
+
+    // Abre un tramo nuevo sin anotar el anterior (trabajo que no es etapa)
+    void reiniciar() {
+        ultimo = nsTraza();
+        if (contadores != NULL) contadores->leer(ultimaMuestra);
+    }
+
+private:
+    HistogramasEtapas& histogramas;
+    GrupoContadoresHw* contadores;
+    MuestraContadoresHw ultimaMuestra;
+    uint64_t ultimo;
+};
+
+// Contadores de hardware por etapa (si se midieron): una columna por
+// contador, "-" para los no disponibles
+static inline void mostrarContadoresEtapas(std::ostream& out, const HistogramasEtapas& ejecucion) {
+    bool hayContadores = false;
+    for (int e = 0; e < NUM_ETAPAS; ++e) {
+        hayContadores = hayContadores || !ejecucion.contadores[e].vacia();
+    }
+    if (!hayContadores) return;
+    char linea[192];
+    snprintf(linea, sizeof(linea), "%-18s", "contadores");
+    out << linea;
+    for (int c = 0; c < NUM_CONTADORES_HW; ++c) {
+        snprintf(linea, sizeof(linea), " %13s", nombreContadorHw(c));
+        out << linea;
+    }
+    out << "\n";
+    for (int e = 0; e < NUM_ETAPAS; ++e) {
+        if (ejecucion.etapas[e].n == 0) continue;
+        snprintf(linea, sizeof(linea), "%-18s", nombreEtapa(e));
+        out << linea;
+        for (int c = 0; c < NUM_CONTADORES_HW; ++c) {
+            if (contadorHwDisponible(c)) {
+                snprintf(linea, sizeof(linea), " %13llu",
+                         static_cast<unsigned long long>(ejecucion.contadores[e].valores[c]));
+            } else {
+                snprintf(linea, sizeof(linea), " %13s", "-");
+            }
+            out << linea;
+        }
+        out << "\n";
+    }
+}
+
+// Una tabla por ejecucion (tramos, total, % del total medido, p50/p99/max)
+// y, con mas de una, la comparacion del total por etapa
+static inline void mostrarDesgloseEtapas(std::ostream& out, const std::vector<std::string>& titulos,
+                                         const std::vector<HistogramasEtapas>& ejecuciones) {
+    char linea[160];
+    for (size_t x = 0; x < ejecuciones.size(); ++x) {
+        uint64_t totalNs = 0;
+        for (int e = 0; e < NUM_ETAPAS; ++e) {
+            totalNs += ejecuciones[x].etapas[e].sumaNs;
+        }
+        out << "=== ETAPAS: " << titulos[x] << " ===\n";
+        snprintf(linea, sizeof(linea), "%-18s %9s %11s %7s %11s %11s %11s\n", "etapa", "tramos", "total ms", "%",
+                 "p50 us", "p99 us", "max us");
+        out << linea;
+        for (int e = 0; e < NUM_ETAPAS; ++e) {
+            const HistogramaLatencias& h = ejecuciones[x].etapas[e];
+            if (h.n == 0) continue;
+            snprintf(linea, sizeof(linea), "%-18s %9llu %11.2f %6.1f%% %11.1f %11.1f %11.1f\n", nombreEtapa(e),
+                     static_cast<unsigned long long>(h.n), h.sumaNs / 1e6,
+                     totalNs > 0 ? 100.0 * h.sumaNs / totalNs : 0.0, h.percentil(50) / 1e3, h.percentil(99) / 1e3,
+                     h.maximoNs / 1e3);
+            out << linea;
+        }
+        mostrarContadoresEtapas(out, ejecuciones[x]);
+    }
+    if (ejecuciones.size() < 2) return;
+    out << "=== ETAPAS: COMPARACION (total ms) ===\n";
+    snprintf(linea, sizeof(linea), "%-18s", "etapa");
+    out << linea;
+    for (size_t x = 0; x < titulos.size(); ++x) {
+        snprintf(linea, sizeof(linea), " %14.14s", titulos[x].c_str());
+        out << linea;
+    }
+    out << "\n";
+    for (int e = 0; e < NUM_ETAPAS; ++e) {
+        snprintf(linea, sizeof(linea), "%-18s", nombreEtapa(e));
+        out << linea;
+        for (size_t x = 0; x < ejecuciones.size(); ++x) {
+            snprintf(linea, sizeof(linea), " %14.2f", ejecuciones[x].etapas[e].sumaNs / 1e6);
+            out << linea;
+        }
+        out << "\n";
+    }
+}
+
+#else
+
+static const bool ETAPAS_ACTIVAS = false;
+
+struct HistogramasEtapas {
+    void combinar(const HistogramasEtapas&) {}
+    void reiniciar() {}
+};
+
+static inline void combinarHistogramasEtapas(HistogramasEtapas&) {}
+
+static inline void descartarHistogramasEtapas() {}
+
+class CronometroEtapas {
+public:
+    CronometroEtapas() : ultimo(trazaActiva() ? nsTraza() : 0) {}
+
+    void marcar(Etapa etapa) {
+        if (!trazaActiva()) return;
+        uint64_t ahora = nsTraza();
+        registrarTramoTraza(nombreEtapa(etapa), ultimo, ahora);
+        ultimo = ahora;
+    }
+
+    void reiniciar() {
+        if (trazaActiva()) ultimo = nsTraza();
+    }
+
+private:
+    uint64_t ultimo;
+};
+
+static inline void mostrarDesgloseEtapas(std::ostream&, const std::vector<std::string>&,
+                                         const std::vector<HistogramasEtapas>&) {}
+
+#endif // MEDIR_ETAPAS
+
+#endif
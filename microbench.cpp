@@ -0,0 +1,467 @@
+// Microbenchmarks de los kernels calientes, medidos aislados de los
+// programas: el cifrado (cada nivel SIMD y las dos rutas escalares), el
+// SHA-256 (SHA-NI, portable, con hex y multi-buffer) y los helpers de
+// lectura/escritura. Recorre tamanos de 64 B a 1 GB con la entrada en
+// cache (caliente) y fuera de ella (fria) y reporta ciclos/byte y GB/s, para
+// que una regresion se vea en el kernel que la causo y no solo en el total.
+//
+// Uso: microbench [--min=64] [--max=1G] [--filtro=texto] [--cache=ambas|caliente|fria] [--csv=ruta]
+//
+// Entrada fria: en memoria se vacian de la cache las lineas del buffer
+// (clflush) antes de cada llamada; en los de archivo se descarta el archivo
+// del page cache (posix_fadvise). Los ciclos son ticks del TSC (ciclos a la
+// frecuencia nominal); fuera de x86 solo se reporta GB/s.
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include "cifrado_simd.h"
+#include "cifrado_escalar.h"
+#include "sha256_multibuffer.h"
+#include "archivo_mapeado.h"
+#include "escritura_directa.h"
+#include "copia_archivos.h"
+#include "buffers_io.h"
+#include "salida_fragmentada.h"
+
+#ifdef SO_X86_GNU
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+static const size_t TAM_MINIMO = 64;
+static const size_t TAM_MAXIMO = 1024ULL * 1024 * 1024;
+static const size_t FACTOR_TAMANO = 4;
+// Cada medicion junta muestras hasta este tiempo (y al menos MIN_MUESTRAS)
+static const double TIEMPO_OBJETIVO_NS = 50e6;
+static const size_t MIN_MUESTRAS = 3;
+static const size_t MAX_MUESTRAS = 2000;
+// Con la entrada caliente una muestra repite el kernel hasta este tiempo:
+// con 64 B una sola llamada queda por debajo de la resolucion del reloj
+static const double TIEMPO_MUESTRA_NS = 20e3;
+static const char* const ARCHIVO_BENCH = "microbench.tmp";
+static const char* const ARCHIVO_COPIA = "microbench_copia.tmp";
+static const size_t PAGINA = 4096;
+
+static volatile unsigned long long g_sumidero = 0;
+
+enum Cache {
+    CACHE_CALIENTE,
+    CACHE_FRIA
+};
+
+// Kernel a medir: procesa `tamano` bytes de `datos`. Los de archivo leen
+// ARCHIVO_BENCH, que se escribe con el tamano pedido antes de medir.
+struct Kernel {
+    string nombre;
+    bool leeArchivo;
+    bool shaPortable;
+    function<bool(char* datos, size_t tamano)> ejecutar;    // false: no soportado aca
+};
+
+struct Medicion {
+    string kernel;
+    size_t tamano;
+    Cache cache;
+    bool soportado;
+    double ns;          // mediana por llamada
+    double ticks;       // mediana por llamada (TSC), 0 si no hay
+};
+
+static inline unsigned long long leerTicks() {
+#ifdef SO_X86_GNU
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static inline double ahoraNs() {
+    return static_cast<double>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+// Saca de todas las caches las lineas de [datos, datos + tamano)
+static void vaciarCacheBuffer(const char* datos, size_t tamano) {
+#ifdef SO_X86_GNU
+    for (size_t i = 0; i < tamano; i += 64) {
+        _mm_clflush(datos + i);
+    }
+    _mm_mfence();
+#else
+    // Sin clflush: recorrer un buffer mas grande que la ultima cache
+    static vector<char> desalojo(64 * 1024 * 1024);
+    for (size_t i = 0; i < desalojo.size(); i += 64) {
+        desalojo[i]++;
+    }
+    (void)datos;
+    (void)tamano;
+#endif
+}
+
+// Baja el archivo a disco y lo descarta del page cache
+static void vaciarCacheArchivo(const char* nombre) {
+#ifndef _WIN32
+    int fd = abrirArchivoFd(nombre, O_RDONLY);
+    if (fd >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        cerrarFd(fd);
+    }
+#else
+    (void)nombre;
+#endif
+}
+
+// Texto parecido al de las copias: original.txt repetido si esta, si no
+// letras, digitos y puntuacion (las rutas con ramas dependen de la mezcla)
+static void llenarEntrada(vector<char>& datos) {
+    string muestra;
+    ifstream original("original.txt", ios::binary);
+    if (original) {
+        muestra.assign(istreambuf_iterator<char>(original), istreambuf_iterator<char>());
+    }
+    if (muestra.empty()) {
+        static const char TEXTO[] = "El Veloz Murcielago Hindu comia 1234 kilos de cardillo y kiwi, 5678 veces.\n";
+        muestra = TEXTO;
+    }
+    for (size_t i = 0; i < datos.size(); i += muestra.size()) {
+        memcpy(&datos[i], muestra.data(), min(muestra.size(), datos.size() - i));
+    }
+}
+
+static bool escribirArchivoBench(const char* datos, size_t tamano) {
+    ofstream archivo;
+    archivo.rdbuf()->pubsetbuf(bufferIoDelHilo(), tamanoBufferIo());
+    archivo.open(ARCHIVO_BENCH, ios::binary | ios::trunc);
+    archivo.write(datos, tamano);
+    return static_cast<bool>(archivo);
+}
+
+static vector<Kernel> crearKernels() {
+    vector<Kernel> kernels;
+    Kernel k;
+    k.leeArchivo = false;
+    k.shaPortable = false;
+
+    // Cifrado: las dos rutas escalares y cada nivel SIMD del CPU
+    struct Escalar {
+        const char* nombre;
+        KernelCifrado kernel;
+    };
+    static const Escalar ESCALARES[] = {
+        {"encriptar escalar ramas", encriptarEscalar},
+        {"desencriptar escalar ramas", desencriptarEscalar},
+        {"encriptar escalar tabla", encriptarInPlaceEscalar},
+        {"desencriptar escalar tabla", desencriptarInPlaceEscalar},
+    };
+    for (size_t i = 0; i < sizeof(ESCALARES) / sizeof(ESCALARES[0]); ++i) {
+        KernelCifrado kernel = ESCALARES[i].kernel;
+        k.nombre = ESCALARES[i].nombre;
+        k.ejecutar = [kernel](char* datos, size_t tamano) {
+            kernel(datos, tamano);
+            return true;
+        };
+        kernels.push_back(k);
+    }
+    for (int n = NIVEL_SSE2; n <= nivelSimdDisponible(); ++n) {
+        KernelsCifrado simd = kernelsCifradoParaNivel(static_cast<NivelSimd>(n));
+        if (simd.encriptar == NULL) continue;
+        KernelCifrado encriptar = simd.encriptar;
+        KernelCifrado desencriptar = simd.desencriptar;
+        k.nombre = string("encriptar ") + nombreNivelSimd(simd.nivel);
+        k.ejecutar = [encriptar](char* datos, size_t tamano) {
+            encriptar(datos, tamano);
+            return true;
+        };
+        kernels.push_back(k);
+        k.nombre = string("desencriptar ") + nombreNivelSimd(simd.nivel);
+        k.ejecutar = [desencriptar](char* datos, size_t tamano) {
+            desencriptar(datos, tamano);
+            return true;
+        };
+        kernels.push_back(k);
+    }
+    // FileProcessor::encriptar de main_simple: copia a un string y cifra
+    k.nombre = "encriptar(string)";
+    k.ejecutar = [](char* datos, size_t tamano) {
+        string resultado(datos, tamano);
+        KernelCifrado kernel = kernelsCifradoActivos().encriptar;
+        if (kernel != NULL) kernel(&resultado[0], resultado.size());
+        else encriptarEscalar(&resultado[0], resultado.size());
+        g_sumidero += static_cast<unsigned char>(resultado[tamano / 2]);
+        return true;
+    };
+    kernels.push_back(k);
+
+    // SHA-256: la implementacion detectada y la portable
+    for (int portable = 0; portable < 2; ++portable) {
+        k.shaPortable = portable != 0;
+        k.nombre = portable ? "sha256 portable" : string("sha256 ") + detectarImplementacionSha256().nombre;
+        k.ejecutar = [](char* datos, size_t tamano) {
+            uint8_t digest[32];
+            Sha256 ctx;
+            ctx.update(datos, tamano);
+            ctx.final(digest);
+            g_sumidero += digest[0];
+            return true;
+        };
+        kernels.push_back(k);
+    }
+    k.shaPortable = false;
+    // FileProcessor::sha256 de main_simple: digest en hex en un string
+    k.nombre = "sha256Hex";
+    k.ejecutar = [](char* datos, size_t tamano) {
+        g_sumidero += static_cast<unsigned char>(sha256Hex(datos, tamano)[0]);
+        return true;
+    };
+    kernels.push_back(k);
+    // Motor multi-buffer: el buffer partido en un mensaje por carril
+    k.nombre = string("sha256Multiple ") + motorSha256Multiple().nombre;
+    k.ejecutar = [](char* datos, size_t tamano) {
+        const size_t carriles = motorSha256Multiple().carriles;
+        TrabajoSha256 trabajos[SHA256_MAX_CARRILES];
+        uint8_t digests[SHA256_MAX_CARRILES][32];
+        const size_t parte = tamano / carriles;
+        for (size_t i = 0; i < carriles; ++i) {
+            trabajos[i].datos = datos + i * parte;
+            trabajos[i].longitud = i + 1 < carriles ? parte : tamano - i * parte;
+            trabajos[i].digest = digests[i];
+        }
+        sha256Multiple(trabajos, carriles);
+        g_sumidero += digests[0][0];
+        return true;
+    };
+    kernels.push_back(k);
+
+    // Escritura: stream con el buffer del hilo y O_DIRECT (escritura_directa.h)
+    k.nombre = "escribir stream";
+    k.ejecutar = [](char* datos, size_t tamano) {
+        if (!escribirArchivoBench(datos, tamano)) {
+            throw runtime_error(string("No se pudo escribir ") + ARCHIVO_BENCH);
+        }
+        return true;
+    };
+    kernels.push_back(k);
+    k.nombre = "escribir O_DIRECT";
+    k.ejecutar = [](char* datos, size_t tamano) {
+        return escribirArchivoDirecto(ARCHIVO_BENCH, datos, tamano);
+    };
+    kernels.push_back(k);
+
+    // Lectura y copia de ARCHIVO_BENCH
+    k.leeArchivo = true;
+    k.nombre = "leer stream";
+    k.ejecutar = [](char*, size_t tamano) {
+        ifstream archivo;
+        archivo.rdbuf()->pubsetbuf(bufferIoDelHilo(), tamanoBufferIo());
+        archivo.open(ARCHIVO_BENCH, ios::binary);
+        string contenido;
+        contenido.resize(tamano);
+        archivo.read(&contenido[0], tamano);
+        if (archivo.gcount() != static_cast<streamsize>(tamano)) {
+            throw runtime_error(string("No se pudo leer ") + ARCHIVO_BENCH);
+        }
+        g_sumidero += static_cast<unsigned char>(contenido[tamano / 2]);
+        return true;
+    };
+    kernels.push_back(k);
+    k.nombre = "leer mmap";
+    k.ejecutar = [](char*, size_t) {
+        ArchivoMapeado mapa(ARCHIVO_BENCH, MAPEO_LECTURA, LECTURA_MMAP);
+        unsigned long long suma = 0;
+        for (size_t i = 0; i < mapa.tamano(); i += PAGINA) {
+            suma += static_cast<unsigned char>(mapa.datos()[i]);
+        }
+        g_sumidero += suma;
+        return true;
+    };
+    kernels.push_back(k);
+    k.nombre = "copiarArchivo";
+    k.ejecutar = [](char*, size_t) {
+        copiarArchivo(ARCHIVO_BENCH, ARCHIVO_COPIA);
+        return true;
+    };
+    kernels.push_back(k);
+    return kernels;
+}
+
+static double mediana(vector<double>& valores) {
+    sort(valores.begin(), valores.end());
+    const size_t n = valores.size();
+    return n % 2 != 0 ? valores[n / 2] : (valores[n / 2 - 1] + valores[n / 2]) / 2;
+}
+
+static Medicion medir(const Kernel& kernel, char* datos, size_t tamano, Cache cache) {
+    Medicion m;
+    m.kernel = kernel.nombre;
+    m.tamano = tamano;
+    m.cache = cache;
+    m.ns = 0;
+    m.ticks = 0;
+    usarSha256Portable(kernel.shaPortable);
+    if (kernel.leeArchivo && !escribirArchivoBench(datos, tamano)) {
+        throw runtime_error(string("No se pudo escribir ") + ARCHIVO_BENCH);
+    }
+
+    // Primera llamada fuera de la medicion: paginas tocadas, kernel en la
+    // cache de instrucciones y, con entrada caliente, los datos en cache
+    m.soportado = kernel.ejecutar(datos, tamano);
+    if (!m.soportado) return m;
+
+    size_t lote = 1;
+    if (cache == CACHE_CALIENTE) {
+        const double inicio = ahoraNs();
+        kernel.ejecutar(datos, tamano);
+        const double una = max(ahoraNs() - inicio, 1.0);
+        lote = static_cast<size_t>(max(1.0, TIEMPO_MUESTRA_NS / una));
+    }
+
+    vector<double> ns, ticks;
+    double total = 0;
+    while (ns.size() < MIN_MUESTRAS || (total < TIEMPO_OBJETIVO_NS && ns.size() < MAX_MUESTRAS)) {
+        if (cache == CACHE_FRIA) {
+            if (kernel.leeArchivo) vaciarCacheArchivo(ARCHIVO_BENCH);
+            else vaciarCacheBuffer(datos, tamano);
+        }
+        const double inicio = ahoraNs();
+        const unsigned long long t0 = leerTicks();
+        for (size_t i = 0; i < lote; ++i) {
+            kernel.ejecutar(datos, tamano);
+        }
+        const unsigned long long t1 = leerTicks();
+        const double duracion = ahoraNs() - inicio;
+        total += duracion;
+        ns.push_back(duracion / lote);
+        ticks.push_back(static_cast<double>(t1 - t0) / lote);
+    }
+    m.ns = mediana(ns);
+    m.ticks = mediana(ticks);
+    return m;
+}
+
+static string textoTamano(size_t bytes) {
+    static const char* const UNIDADES[] = {"B", "KB", "MB", "GB"};
+    int u = 0;
+    while (u < 3 && bytes >= 1024 && bytes % 1024 == 0) {
+        bytes /= 1024;
+        ++u;
+    }
+    return to_string(bytes) + " " + UNIDADES[u];
+}
+
+// "64", "4K", "16M", "1G"
+static size_t parsearTamano(const string& texto) {
+    char* fin = NULL;
+    unsigned long long valor = strtoull(texto.c_str(), &fin, 10);
+    string sufijo(fin);
+    if (fin == texto.c_str() || valor == 0) throw runtime_error("Tamano invalido: " + texto);
+    if (sufijo == "K" || sufijo == "k") valor *= 1024ULL;
+    else if (sufijo == "M" || sufijo == "m") valor *= 1024ULL * 1024;
+    else if (sufijo == "G" || sufijo == "g") valor *= 1024ULL * 1024 * 1024;
+    else if (!sufijo.empty()) throw runtime_error("Tamano invalido: " + texto);
+    return static_cast<size_t>(valor);
+}
+
+static void mostrarMedicion(const Medicion& m) {
+    cout << left << setw(30) << m.kernel << right << setw(8) << textoTamano(m.tamano) << "  " << left << setw(9)
+         << (m.cache == CACHE_FRIA ? "fria" : "caliente") << right;
+    if (!m.soportado) {
+        cout << "  no soportado\n";
+        return;
+    }
+    cout << fixed << setprecision(1) << setw(14) << m.ns;
+    if (m.ticks > 0) cout << setprecision(3) << setw(11) << m.ticks / m.tamano;
+    else cout << setw(11) << "-";
+    cout << setprecision(2) << setw(9) << m.tamano / m.ns << "\n";
+}
+
+static void escribirCsv(const string& ruta, const vector<Medicion>& mediciones) {
+    ofstream csv(ruta);
+    if (!csv) throw runtime_error("No se pudo crear " + ruta);
+    csv << "kernel,bytes,cache,soportado,ns_por_llamada,ciclos_por_byte,gb_s\n";
+    for (size_t i = 0; i < mediciones.size(); ++i) {
+        const Medicion& m = mediciones[i];
+        csv << m.kernel << ',' << m.tamano << ',' << (m.cache == CACHE_FRIA ? "fria" : "caliente") << ','
+            << (m.soportado ? 1 : 0) << ',' << fixed << setprecision(1) << m.ns << ',' << setprecision(4)
+            << (m.soportado && m.ticks > 0 ? m.ticks / m.tamano : 0.0) << ',' << setprecision(3)
+            << (m.soportado ? m.tamano / m.ns : 0.0) << '\n';
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t minimo = TAM_MINIMO, maximo = TAM_MAXIMO;
+    string filtro, rutaCsv;
+    bool caliente = true, fria = true;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            string arg = argv[i];
+            size_t igual = arg.find('=');
+            string nombre = arg.substr(0, igual);
+            string valor = igual == string::npos ? "" : arg.substr(igual + 1);
+            if (nombre == "--min") minimo = parsearTamano(valor);
+            else if (nombre == "--max") maximo = parsearTamano(valor);
+            else if (nombre == "--filtro") filtro = valor;
+            else if (nombre == "--csv") rutaCsv = valor;
+            else if (nombre == "--cache" && (valor == "ambas" || valor == "caliente" || valor == "fria")) {
+                caliente = valor != "fria";
+                fria = valor != "caliente";
+            } else {
+                cout << "Uso: " << argv[0]
+                     << " [--min=64] [--max=1G] [--filtro=texto] [--cache=ambas|caliente|fria] [--csv=ruta]\n";
+                return 1;
+            }
+        }
+        if (minimo > maximo) throw runtime_error("--min mayor que --max");
+
+        // encriptar(string) usa el kernel activo, como main_simple
+        inicializarCifradoSimd(encriptarEscalar, desencriptarEscalar);
+        vector<Kernel> kernels = crearKernels();
+        vector<char> entrada(maximo);
+        llenarEntrada(entrada);
+
+        cout << "Cifrado SIMD: hasta " << nombreNivelSimd(nivelSimdDisponible()) << "  SHA-256: "
+             << detectarImplementacionSha256().nombre << "  multi-buffer: " << motorSha256Multiple().nombre << " x"
+             << motorSha256Multiple().carriles << "\n";
+        cout << "Mediana por llamada; ciclos = ticks del TSC; GB/s = 1e9 bytes/s\n\n";
+        cout << left << setw(30) << "Kernel" << right << setw(8) << "Tamano" << "  " << left << setw(9) << "Cache"
+             << right << setw(14) << "ns/llamada" << setw(11) << "ciclos/B" << setw(9) << "GB/s" << "\n";
+
+        vector<Medicion> mediciones;
+        for (size_t k = 0; k < kernels.size(); ++k) {
+            if (!filtro.empty() && kernels[k].nombre.find(filtro) == string::npos) continue;
+            for (size_t tamano = minimo; tamano <= maximo; tamano *= FACTOR_TAMANO) {
+                for (int c = CACHE_CALIENTE; c <= CACHE_FRIA; ++c) {
+                    if (c == CACHE_CALIENTE ? !caliente : !fria) continue;
+                    mediciones.push_back(medir(kernels[k], &entrada[0], tamano, static_cast<Cache>(c)));
+                    mostrarMedicion(mediciones.back());
+                }
+            }
+            cout << "\n";
+        }
+        usarSha256Portable(false);
+        remove(ARCHIVO_BENCH);
+        remove(ARCHIVO_COPIA);
+
+        if (!rutaCsv.empty()) {
+            escribirCsv(rutaCsv, mediciones);
+            cout << "CSV: " << rutaCsv << "\n";
+        }
+    } catch (const exception& e) {
+        remove(ARCHIVO_BENCH);
+        remove(ARCHIVO_COPIA);
+        cout << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,245 @@
+// Memoria en paginas grandes para los buffers grandes (--paginas=grandes):
+// el original, el bloque de la arena de cada hilo, los buffers de I/O y
+// las copias por nodo. Con paginas de 4 KB el cifrado y el hash recorren
+// cientos de MB fallando en la TLB a cada paso; con paginas de 2 MB una
+// entrada cubre 512 veces mas.
+//
+// Se intenta primero MAP_HUGETLB (paginas reservadas por el administrador
+// en vm.nr_hugepages: 2 MB seguras). Si no hay, se mapea alineado a 2 MB y
+// se pide MADV_HUGEPAGE: el kernel usa paginas grandes transparentes (THP)
+// donde puede, y cuantas logro lo dice AnonHugePages en
+// /proc/self/smaps_rollup. Si tampoco, quedan las de 4 KB. En Windows
+// MEM_LARGE_PAGES (necesita el privilegio SeLockMemoryPrivilege).
+//
+// El modo se fija antes de reservar nada y no cambia despues.
+#ifndef PAGINAS_GRANDES_H
+#define PAGINAS_GRANDES_H
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+static const size_t TAMANO_PAGINA_GRANDE = 2 * 1024 * 1024;
+
+enum TipoPagina {
+    PAGINA_NORMAL,          // 4 KB
+    PAGINA_THP,             // MADV_HUGEPAGE aceptado: grandes donde el kernel pueda
+    PAGINA_HUGETLB,         // MAP_HUGETLB / MEM_LARGE_PAGES: 2 MB seguras
+    NUM_TIPOS_PAGINA
+};
+
+static inline const char* nombreTipoPagina(TipoPagina tipo) {
+    switch (tipo) {
+        case PAGINA_HUGETLB: return "2 MB hugetlb";
+        case PAGINA_THP: return "THP";
+        default: return "4 KB";
+    }
+}
+
+static inline bool& banderaPaginasGrandes() {
+    static bool activas = false;
+    return activas;
+}
+
+static inline bool paginasGrandesActivas() {
+    return banderaPaginasGrandes();
+}
+
+// Solo vale la pena desde una pagina grande: lo chico queda como estaba
+static inline bool usarPaginasGrandes(size_t bytes) {
+    return paginasGrandesActivas() && bytes >= TAMANO_PAGINA_GRANDE;
+}
+
+// Bloques y bytes en uso de cada tipo
+static inline std::atomic<long long>* contadoresPaginas() {
+    static std::atomic<long long> contadores[2 * NUM_TIPOS_PAGINA];
+    return contadores;
+}
+
+// Bloque de memoria propio, mapeado aparte del heap
+class BloqueGrande {
+public:
+    BloqueGrande() : datos_(NULL), mapeado(0), tipo_(PAGINA_NORMAL) {}
+    ~BloqueGrande() {
+        liberar();
+    }
+
+    // Con usarPaginasGrandes(bytes) prueba hugetlb y luego THP; si no,
+    // paginas normales. Lanza bad_alloc si no hay memoria.
+    char* reservar(size_t bytes) {
+        liberar();
+        bool grandes = usarPaginasGrandes(bytes);
+        size_t tamano = grandes ? (bytes + TAMANO_PAGINA_GRANDE - 1) / TAMANO_PAGINA_GRANDE * TAMANO_PAGINA_GRANDE
+                                : (bytes > 0 ? bytes : 1);
+        TipoPagina tipo = PAGINA_NORMAL;
+        char* p = NULL;
+#ifdef _WIN32
+        if (grandes) {
+            SIZE_T minimo = GetLargePageMinimum();
+            if (minimo > 0 && tamano % minimo == 0) {
+                p = static_cast<char*>(
+                    VirtualAlloc(NULL, tamano, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+                if (p != NULL) tipo = PAGINA_HUGETLB;
+            }
+        }
+        if (p == NULL) {
+            p = static_cast<char*>(VirtualAlloc(NULL, tamano, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+        }
+#else
+#ifdef MAP_HUGETLB
+        if (grandes) {
+            void* h = mmap(NULL, tamano, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (h != MAP_FAILED) {
+                p = static_cast<char*>(h);
+                tipo = PAGINA_HUGETLB;
+            }
+        }
+#endif
+        if (p == NULL && grandes) {
+            // THP solo usa extensiones alineadas a 2 MB: se mapea de mas y
+            // se recortan las puntas
+            void* bruto = mmap(NULL, tamano + TAMANO_PAGINA_GRANDE, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (bruto != MAP_FAILED) {
+                uintptr_t inicio = reinterpret_cast<uintptr_t>(bruto);
+                uintptr_t alineado = (inicio + TAMANO_PAGINA_GRANDE - 1) & ~static_cast<uintptr_t>(TAMANO_PAGINA_GRANDE - 1);
+                if (alineado > inicio) munmap(bruto, alineado - inicio);
+                size_t cola = TAMANO_PAGINA_GRANDE - (alineado - inicio);
+                if (cola > 0) munmap(reinterpret_cast<void*>(alineado + tamano), cola);
+                p = reinterpret_cast<char*>(alineado);
+#ifdef MADV_HUGEPAGE
+                if (madvise(p, tamano, MADV_HUGEPAGE) == 0) tipo = PAGINA_THP;
+#endif
+            }
+        }
+        if (p == NULL) {
+            void* n = mmap(NULL, tamano, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (n != MAP_FAILED) p = static_cast<char*>(n);
+        }
+#endif
+        if (p == NULL) throw std::bad_alloc();
+        datos_ = p;
+        mapeado = tamano;
+        tipo_ = tipo;
+        contadoresPaginas()[tipo] += 1;
+        contadoresPaginas()[NUM_TIPOS_PAGINA + tipo] += static_cast<long long>(tamano);
+        return datos_;
+    }
+
+    void liberar() {
+        if (datos_ == NULL) return;
+#ifdef _WIN32
+        VirtualFree(datos_, 0, MEM_RELEASE);
+#else
+        munmap(datos_, mapeado);
+#endif
+        contadoresPaginas()[tipo_] -= 1;
+        contadoresPaginas()[NUM_TIPOS_PAGINA + tipo_] -= static_cast<long long>(mapeado);
+        datos_ = NULL;
+        mapeado = 0;
+        tipo_ = PAGINA_NORMAL;
+    }
+
+    char* datos() const {
+        return datos_;
+    }
+
+    TipoPagina tipo() const {
+        return tipo_;
+    }
+
+private:
+    char* datos_;
+    size_t mapeado;
+    TipoPagina tipo_;
+
+    BloqueGrande(const BloqueGrande&);
+    BloqueGrande& operator=(const BloqueGrande&);
+};
+
+// Valor en kB de una linea "Clave:   N kB" de un archivo de /proc; -1 si
+// no esta
+static inline long long leerKbProc(const char* ruta, const std::string& clave) {
+    std::ifstream archivo(ruta);
+    std::string linea;
+    while (std::getline(archivo, linea)) {
+        if (linea.compare(0, clave.size(), clave) == 0 && linea.size() > clave.size() && linea[clave.size()] == ':') {
+            long long kb = -1;
+            sscanf(linea.c_str() + clave.size() + 1, "%lld", &kb);
+            return kb;
+        }
+    }
+    return -1;
+}
+
+struct EstadisticasPaginas {
+    long long bloques[NUM_TIPOS_PAGINA];    // en uso
+    long long bytes[NUM_TIPOS_PAGINA];
+    long long kbThp;                        // AnonHugePages del proceso, -1 si no se sabe
+};
+
+// Tomarla con los buffers todavia reservados
+static inline EstadisticasPaginas estadisticasPaginas() {
+    EstadisticasPaginas e;
+    for (int t = 0; t < NUM_TIPOS_PAGINA; ++t) {
+        e.bloques[t] = contadoresPaginas()[t].load();
+        e.bytes[t] = contadoresPaginas()[NUM_TIPOS_PAGINA + t].load();
+    }
+#ifdef __linux__
+    e.kbThp = leerKbProc("/proc/self/smaps_rollup", "AnonHugePages");
+#else
+    e.kbThp = -1;
+#endif
+    return e;
+}
+
+// "2 MB hugetlb: 3 (48.0 MB), THP: 0, 4 KB: 1 (0.1 MB); AnonHugePages 0.0 MB"
+static inline std::string resumenPaginas(const EstadisticasPaginas& e) {
+    std::ostringstream linea;
+    linea.setf(std::ios::fixed);
+    linea.precision(1);
+    static const TipoPagina ORDEN[] = {PAGINA_HUGETLB, PAGINA_THP, PAGINA_NORMAL};
+    for (int i = 0; i < NUM_TIPOS_PAGINA; ++i) {
+        TipoPagina t = ORDEN[i];
+        linea << (i > 0 ? ", " : "") << nombreTipoPagina(t) << ": " << e.bloques[t];
+        if (e.bloques[t] > 0) linea << " (" << static_cast<double>(e.bytes[t]) / (1024.0 * 1024.0) << " MB)";
+    }
+    if (e.kbThp >= 0) linea << "; AnonHugePages " << static_cast<double>(e.kbThp) / 1024.0 << " MB";
+    return linea.str();
+}
+
+// Activa el modo y devuelve la linea del encabezado con lo que ofrece el
+// sistema
+static inline std::string activarPaginasGrandes() {
+    banderaPaginasGrandes() = true;
+    std::ostringstream linea;
+    linea << "grandes";
+#ifdef __linux__
+    long long libres = leerKbProc("/proc/meminfo", "HugePages_Free");
+    long long tamano = leerKbProc("/proc/meminfo", "Hugepagesize");
+    std::ifstream thp("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string modos;
+    std::getline(thp, modos);
+    size_t abre = modos.find('[');
+    size_t cierra = modos.find(']');
+    linea << " (hugetlb: " << (libres >= 0 ? libres : 0) << " libres de " << (tamano >= 0 ? tamano : 0)
+          << " KB, THP: " << (abre != std::string::npos && cierra > abre ? modos.substr(abre + 1, cierra - abre - 1)
+                                                                           : std::string("no disponible"))
+          << ")";
+#elif defined(_WIN32)
+    linea << " (MEM_LARGE_PAGES de " << GetLargePageMinimum() / 1024 << " KB)";
+#endif
+    return linea.str();
+}
+
+#endif
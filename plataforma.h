@@ -0,0 +1,164 @@
+// Capa de plataforma de main_pro.cpp: reloj monotono de alta resolucion,
+// hora local, prioridad y afinidad, pausas y borrado de archivos. En
+// Windows usa la API de siempre (QueryPerformanceCounter, SetPriorityClass,
+// SetProcessAffinityMask, Sleep, DeleteFileA, GetLocalTime); en POSIX
+// clock_gettime, setpriority, sched_setaffinity (solo Linux), nanosleep y
+// unlink. Los hilos son std::thread (pthreads en POSIX), ver pool_hilos.h.
+//
+// Las funciones de prioridad y afinidad devuelven false si el sistema no
+// lo permite (sin privilegios para bajar el nice, por ejemplo) y el
+// llamador sigue igual: son una optimizacion, no un requisito.
+#ifndef PLATAFORMA_H
+#define PLATAFORMA_H
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <ctime>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+// Ticks del reloj monotono; frecuenciaReloj() dice cuantos por segundo
+static inline int64_t marcaTiempo() {
+#ifdef _WIN32
+    LARGE_INTEGER ahora;
+    QueryPerformanceCounter(&ahora);
+    return ahora.QuadPart;
+#else
+    struct timespec ahora;
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    return static_cast<int64_t>(ahora.tv_sec) * 1000000000LL + ahora.tv_nsec;
+#endif
+}
+
+// Fija desde el arranque: se consulta una sola vez
+static inline int64_t frecuenciaReloj() {
+#ifdef _WIN32
+    static const int64_t frecuencia = [] {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        return static_cast<int64_t>(f.QuadPart);
+    }();
+    return frecuencia;
+#else
+    return 1000000000LL;
+#endif
+}
+
+struct HoraLocal {
+    int hora;
+    int minuto;
+    int segundo;
+    int milisegundo;
+};
+
+static inline HoraLocal horaLocal() {
+    HoraLocal h;
+#ifdef _WIN32
+    SYSTEMTIME st;
+    GetLocalTime(&st);
+    h.hora = st.wHour;
+    h.minuto = st.wMinute;
+    h.segundo = st.wSecond;
+    h.milisegundo = st.wMilliseconds;
+#else
+    struct timespec ahora;
+    clock_gettime(CLOCK_REALTIME, &ahora);
+    time_t segundos = ahora.tv_sec;
+    struct tm local;
+    localtime_r(&segundos, &local);
+    h.hora = local.tm_hour;
+    h.minuto = local.tm_min;
+    h.segundo = local.tm_sec;
+    h.milisegundo = static_cast<int>(ahora.tv_nsec / 1000000);
+#endif
+    return h;
+}
+
+static inline unsigned numeroProcesadores() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? static_cast<unsigned>(n) : 1;
+#endif
+}
+
+// Prioridad alta para el proceso. En POSIX baja el nice del hilo que
+// llama: los hilos que se creen despues lo heredan.
+static inline bool subirPrioridadProceso() {
+#ifdef _WIN32
+    return SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS) != 0;
+#else
+    return setpriority(PRIO_PROCESS, 0, -10) == 0;
+#endif
+}
+
+// Un escalon por encima del proceso para el hilo que llama
+static inline bool subirPrioridadHilo() {
+#ifdef _WIN32
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL) != 0;
+#elif defined(__linux__)
+    // En Linux el nice es de cada hilo: se cambia el del tid
+    id_t hilo = static_cast<id_t>(syscall(SYS_gettid));
+    errno = 0;
+    int actual = getpriority(PRIO_PROCESS, hilo);
+    if (errno != 0) return false;
+    return setpriority(PRIO_PROCESS, hilo, actual - 1) == 0;
+#else
+    return false;
+#endif
+}
+
+// Permite correr en todos los procesadores (los hilos creados despues
+// heredan la mascara)
+static inline bool usarTodosLosProcesadores() {
+    unsigned n = numeroProcesadores();
+#ifdef _WIN32
+    DWORD_PTR mascara = n >= sizeof(DWORD_PTR) * 8 ? ~static_cast<DWORD_PTR>(0)
+                                                    : (static_cast<DWORD_PTR>(1) << n) - 1;
+    return SetProcessAffinityMask(GetCurrentProcess(), mascara) != 0;
+#elif defined(__linux__)
+    cpu_set_t mascara;
+    CPU_ZERO(&mascara);
+    for (unsigned i = 0; i < n && i < CPU_SETSIZE; ++i) {
+        CPU_SET(i, &mascara);
+    }
+    return sched_setaffinity(0, sizeof(mascara), &mascara) == 0;
+#else
+    (void)n;
+    return false;
+#endif
+}
+
+static inline void dormirMs(unsigned ms) {
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec pausa;
+    pausa.tv_sec = ms / 1000;
+    pausa.tv_nsec = static_cast<long>(ms % 1000) * 1000000L;
+    while (nanosleep(&pausa, &pausa) != 0 && errno == EINTR) {
+    }
+#endif
+}
+
+static inline bool borrarArchivo(const char* ruta) {
+#ifdef _WIN32
+    return DeleteFileA(ruta) != 0;
+#else
+    return unlink(ruta) == 0;
+#endif
+}
+
+#endif
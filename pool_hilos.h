@@ -0,0 +1,181 @@
+// Pool de hilos persistente con robo de trabajo (work stealing).
+// Cada hilo tiene su propia cola doble: toma sus tareas por el final (LIFO,
+// datos recientes en cache) y cuando se queda sin trabajo roba por el
+// principio de la cola de otro hilo (FIFO, las tareas mas antiguas). Asi un
+// archivo lento no retiene el resto de archivos de una particion estatica.
+#ifndef POOL_HILOS_H
+#define POOL_HILOS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PoolHilos {
+public:
+    typedef std::function<void()> Tarea;
+    typedef std::function<void(size_t)> InicioHilo;
+
+    // numHilos = 0 usa std::thread::hardware_concurrency(). alIniciar se
+    // ejecuta en cada hilo al arrancar (prioridad, afinidad...)
+    explicit PoolHilos(size_t numHilos = 0, InicioHilo alIniciar = InicioHilo())
+        : colas(hilosEfectivos(numHilos)), encoladas(0), pendientes(0), siguiente(0), detener(false) {
+        for (size_t i = 0; i < colas.size(); ++i) {
+            colas[i] = new ColaTrabajo();
+        }
+        for (size_t i = 0; i < colas.size(); ++i) {
+            hilos.push_back(std::thread(&PoolHilos::bucleHilo, this, i, alIniciar));
+        }
+    }
+
+    ~PoolHilos() {
+        {
+            std::lock_guard<std::mutex> lock(mutexSueno);
+            detener = true;
+        }
+        cvTrabajo.notify_all();
+        for (size_t i = 0; i < hilos.size(); ++i) {
+            hilos[i].join();
+        }
+        for (size_t i = 0; i < colas.size(); ++i) {
+            delete colas[i];
+        }
+    }
+
+    size_t numHilos() const {
+        return colas.size();
+    }
+
+    // Desde un hilo del pool la tarea va a su propia cola; desde fuera se
+    // reparte en round-robin. La tarea debe capturar sus excepciones.
+    void enviar(const Tarea& tarea) {
+        int actual = indiceHiloActual();
+        size_t destino = (actual >= 0 && esDeEstePool())
+            ? static_cast<size_t>(actual)
+            : siguiente.fetch_add(1) % colas.size();
+
+        pendientes.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(colas[destino]->mutex);
+            colas[destino]->tareas.push_back(tarea);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutexSueno);
+            encoladas.fetch_add(1);
+        }
+        cvTrabajo.notify_one();
+    }
+
+    // Bloquea hasta que terminan todas las tareas enviadas
+    void esperar() {
+        std::unique_lock<std::mutex> lock(mutexFin);
+        while (pendientes.load() != 0) {
+            cvFin.wait(lock);
+        }
+    }
+
+    // Indice del hilo del pool que ejecuta la llamada, -1 fuera del pool
+    static int indiceHiloActual() {
+        return indiceHilo();
+    }
+
+    // Numero de hilos que usara un pool creado con numHilos = pedidos
+    static size_t hilosEfectivos(size_t pedidos) {
+        if (pedidos > 0) return pedidos;
+        size_t hw = std::thread::hardware_concurrency();
+        return hw > 0 ? hw : 1;
+    }
+
+private:
+    struct ColaTrabajo {
+        std::mutex mutex;
+        std::deque<Tarea> tareas;
+    };
+
+    static int& indiceHilo() {
+        static thread_local int indice = -1;
+        return indice;
+    }
+
+    static PoolHilos*& poolDelHilo() {
+        static thread_local PoolHilos* pool = NULL;
+        return pool;
+    }
+
+    bool esDeEstePool() const {
+        return poolDelHilo() == this;
+    }
+
+    bool tomarTarea(size_t propio, Tarea& tarea) {
+        // Propia cola por el final
+        {
+            ColaTrabajo& cola = *colas[propio];
+            std::lock_guard<std::mutex> lock(cola.mutex);
+            if (!cola.tareas.empty()) {
+                tarea.swap(cola.tareas.back());
+                cola.tareas.pop_back();
+                return true;
+            }
+        }
+        // Robar por el principio de las demas
+        for (size_t k = 1; k < colas.size(); ++k) {
+            ColaTrabajo& victima = *colas[(propio + k) % colas.size()];
+            std::lock_guard<std::mutex> lock(victima.mutex);
+            if (!victima.tareas.empty()) {
+                tarea.swap(victima.tareas.front());
+                victima.tareas.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void bucleHilo(size_t indice, InicioHilo alIniciar) {
+        indiceHilo() = static_cast<int>(indice);
+        poolDelHilo() = this;
+        if (alIniciar) {
+            alIniciar(indice);
+        }
+
+        while (true) {
+            Tarea tarea;
+            if (tomarTarea(indice, tarea)) {
+                encoladas.fetch_sub(1);
+                tarea();
+                if (pendientes.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(mutexFin);
+                    cvFin.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutexSueno);
+            while (!detener && encoladas.load() <= 0) {
+                cvTrabajo.wait(lock);
+            }
+            if (detener && encoladas.load() <= 0) {
+                return;
+            }
+        }
+    }
+
+    std::vector<ColaTrabajo*> colas;
+    std::vector<std::thread> hilos;
+    std::atomic<long> encoladas;     // tareas en alguna cola sin tomar
+    std::atomic<long> pendientes;    // tareas enviadas sin terminar
+    std::atomic<size_t> siguiente;
+    bool detener;
+
+    std::mutex mutexSueno;
+    std::condition_variable cvTrabajo;
+    std::mutex mutexFin;
+    std::condition_variable cvFin;
+
+    PoolHilos(const PoolHilos&);
+    PoolHilos& operator=(const PoolHilos&);
+};
+
+#endif
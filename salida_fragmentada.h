@@ -0,0 +1,312 @@
+// Salida fragmentada para muchas copias (--escala).
+// Las copias van en un arbol raiz/xx/ (o raiz/xx/yy/ con mas de 256
+// fragmentos) con a lo sumo ARCHIVOS_POR_FRAGMENTO numeros por directorio
+// hoja: cada directorio se mantiene chico y buscar o crear una entrada
+// cuesta lo mismo con mil copias que con millones. El fragmento sale de un
+// hash del numero, asi los archivos consecutivos (que varios hilos procesan
+// a la vez) caen en directorios distintos y no compiten por el mismo lock.
+// En POSIX cada hoja se abre una sola vez (O_DIRECTORY) y los archivos se
+// crean con openat relativo a ese descriptor; en Windows se usa la ruta.
+// Compartido por main_pro.cpp y main_simple.cpp.
+#ifndef SALIDA_FRAGMENTADA_H
+#define SALIDA_FRAGMENTADA_H
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+static const unsigned long long ARCHIVOS_POR_FRAGMENTO = 1024;
+static const unsigned FRAGMENTOS_POR_NIVEL = 256;
+static const unsigned MAX_FRAGMENTOS = FRAGMENTOS_POR_NIVEL * FRAGMENTOS_POR_NIVEL;
+// "raiz/xx/yy/" + numero + sufijo
+static const size_t TAM_RUTA_FRAGMENTADA = 256;
+
+// I/O por descriptor comun a POSIX y Windows (CRT)
+static inline bool escribirCompletoFd(int fd, const char* datos, size_t tamano) {
+    while (tamano > 0) {
+#ifdef _WIN32
+        unsigned n = static_cast<unsigned>(tamano < (1u << 30) ? tamano : (1u << 30));
+        int r = _write(fd, datos, n);
+#else
+        ssize_t r = ::write(fd, datos, tamano);
+        if (r < 0 && errno == EINTR) continue;
+#endif
+        if (r <= 0) return false;
+        datos += r;
+        tamano -= static_cast<size_t>(r);
+    }
+    return true;
+}
+
+// Lee hasta llenar `capacidad` o llegar al final; devuelve los bytes leidos
+static inline size_t leerCompletoFd(int fd, char* destino, size_t capacidad) {
+    size_t leidos = 0;
+    while (leidos < capacidad) {
+#ifdef _WIN32
+        size_t resto = capacidad - leidos;
+        int r = _read(fd, destino + leidos, static_cast<unsigned>(resto < (1u << 30) ? resto : (1u << 30)));
+#else
+        ssize_t r = ::read(fd, destino + leidos, capacidad - leidos);
+        if (r < 0 && errno == EINTR) continue;
+#endif
+        if (r <= 0) break;
+        leidos += static_cast<size_t>(r);
+    }
+    return leidos;
+}
+
+// Mueve la posicion del descriptor a `desplazamiento` desde el inicio
+static inline bool posicionarFd(int fd, unsigned long long desplazamiento) {
+#ifdef _WIN32
+    return _lseeki64(fd, static_cast<__int64>(desplazamiento), SEEK_SET) == static_cast<__int64>(desplazamiento);
+#else
+    return ::lseek(fd, static_cast<off_t>(desplazamiento), SEEK_SET) == static_cast<off_t>(desplazamiento);
+#endif
+}
+
+static inline bool rebobinarFd(int fd) {
+    return posicionarFd(fd, 0);
+}
+
+// open(2) por ruta (binario en Windows); -1 si falla
+static inline int abrirArchivoFd(const char* ruta, int flags) {
+#ifdef _WIN32
+    return _open(ruta, flags | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int fd;
+    do {
+        fd = ::open(ruta, flags | O_CLOEXEC, 0644);
+    } while (fd < 0 && errno == EINTR);
+    return fd;
+#endif
+}
+
+static inline void cerrarFd(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+class SalidaFragmentada {
+public:
+    // Crea raiz/ y los fragmentos para `numArchivos` numeros
+    SalidaFragmentada(const std::string& raiz, unsigned long long numArchivos)
+        : raiz(raiz), numArchivos(numArchivos), fragmentos(1), descriptoresEnCache(0) {
+        while (fragmentos < MAX_FRAGMENTOS &&
+               static_cast<unsigned long long>(fragmentos) * ARCHIVOS_POR_FRAGMENTO < numArchivos) {
+            fragmentos *= 2;
+        }
+        crearDirectorio(raiz.c_str());
+        char ruta[TAM_RUTA_FRAGMENTADA];
+        if (fragmentos > FRAGMENTOS_POR_NIVEL) {
+            for (unsigned i = 0; i < FRAGMENTOS_POR_NIVEL; ++i) {
+                snprintf(ruta, sizeof(ruta), "%s/%02x", raiz.c_str(), i);
+                crearDirectorio(ruta);
+            }
+        }
+#ifndef _WIN32
+        const unsigned maxEnCache = descriptoresCacheables();
+        descriptores.assign(fragmentos, -1);
+#endif
+        for (unsigned f = 0; f < fragmentos; ++f) {
+            rutaFragmento(ruta, sizeof(ruta), f);
+            crearDirectorio(ruta);
+#ifndef _WIN32
+            // Pasado el limite, los fragmentos restantes se abren por ruta
+            if (descriptoresEnCache < maxEnCache) {
+                descriptores[f] = ::open(ruta, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                if (descriptores[f] >= 0) ++descriptoresEnCache;
+            }
+#endif
+        }
+    }
+
+    ~SalidaFragmentada() {
+        cerrarDescriptores();
+    }
+
+    unsigned numFragmentos() const {
+        return fragmentos;
+    }
+
+    // Fragmentos con el descriptor del directorio abierto (openat)
+    unsigned numDescriptoresEnCache() const {
+        return descriptoresEnCache;
+    }
+
+    unsigned fragmento(unsigned long long numero) const {
+        // Finalizador de splitmix64: numeros vecinos quedan dispersos
+        unsigned long long x = numero;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return static_cast<unsigned>(x & (fragmentos - 1));
+    }
+
+    // "copias/3f/123.txt"
+    void ruta(char* destino, size_t capacidad, unsigned long long numero, const char* sufijo) const {
+        rutaFragmento(destino, capacidad, fragmento(numero));
+        size_t largo = strlen(destino);
+        snprintf(destino + largo, capacidad - largo, "/%llu%s", numero, sufijo);
+    }
+
+    std::string ruta(unsigned long long numero, const char* sufijo) const {
+        char destino[TAM_RUTA_FRAGMENTADA];
+        ruta(destino, sizeof(destino), numero, sufijo);
+        return destino;
+    }
+
+    // open(2) de numero+sufijo en su fragmento; lanza runtime_error si falla
+    int abrir(unsigned long long numero, const char* sufijo, int flags) const {
+        int fd;
+#ifdef _WIN32
+        char completa[TAM_RUTA_FRAGMENTADA];
+        ruta(completa, sizeof(completa), numero, sufijo);
+        fd = abrirArchivoFd(completa, flags);
+#else
+        int dir = descriptores[fragmento(numero)];
+        char nombre[TAM_RUTA_FRAGMENTADA];
+        if (dir >= 0) {
+            snprintf(nombre, sizeof(nombre), "%llu%s", numero, sufijo);
+        } else {
+            ruta(nombre, sizeof(nombre), numero, sufijo);
+            dir = AT_FDCWD;
+        }
+        do {
+            fd = ::openat(dir, nombre, flags | O_CLOEXEC, 0644);
+        } while (fd < 0 && errno == EINTR);
+#endif
+        if (fd < 0) {
+            throw std::runtime_error("No se pudo abrir " + ruta(numero, sufijo) + ": " + strerror(errno));
+        }
+        return fd;
+    }
+
+    // unlink(2) de numero+sufijo en su fragmento; no falla si no existe
+    void borrar(unsigned long long numero, const char* sufijo) const {
+#ifdef _WIN32
+        char completa[TAM_RUTA_FRAGMENTADA];
+        ruta(completa, sizeof(completa), numero, sufijo);
+        remove(completa);
+#else
+        char nombre[TAM_RUTA_FRAGMENTADA];
+        int dir = descriptores[fragmento(numero)];
+        if (dir >= 0) {
+            snprintf(nombre, sizeof(nombre), "%llu%s", numero, sufijo);
+        } else {
+            ruta(nombre, sizeof(nombre), numero, sufijo);
+            dir = AT_FDCWD;
+        }
+        ::unlinkat(dir, nombre, 0);
+#endif
+    }
+
+    // Borra los archivos 1..numArchivos con cada sufijo y despues el arbol
+    void eliminar(const char* const* sufijos, size_t numSufijos) {
+        for (unsigned long long n = 1; n <= numArchivos; ++n) {
+            for (size_t s = 0; s < numSufijos; ++s) {
+                borrar(n, sufijos[s]);
+            }
+        }
+        cerrarDescriptores();
+        char dir[TAM_RUTA_FRAGMENTADA];
+        for (unsigned f = 0; f < fragmentos; ++f) {
+            rutaFragmento(dir, sizeof(dir), f);
+            borrarDirectorio(dir);
+        }
+        if (fragmentos > FRAGMENTOS_POR_NIVEL) {
+            for (unsigned i = 0; i < FRAGMENTOS_POR_NIVEL; ++i) {
+                snprintf(dir, sizeof(dir), "%s/%02x", raiz.c_str(), i);
+                borrarDirectorio(dir);
+            }
+        }
+        borrarDirectorio(raiz.c_str());
+    }
+
+private:
+    // Con un nivel: raiz/ff; con dos: raiz/ff/ff (byte bajo y byte alto)
+    void rutaFragmento(char* destino, size_t capacidad, unsigned f) const {
+        if (fragmentos > FRAGMENTOS_POR_NIVEL) {
+            snprintf(destino, capacidad, "%s/%02x/%02x", raiz.c_str(), f % FRAGMENTOS_POR_NIVEL,
+                     f / FRAGMENTOS_POR_NIVEL);
+        } else {
+            snprintf(destino, capacidad, "%s/%02x", raiz.c_str(), f);
+        }
+    }
+
+    static void crearDirectorio(const char* ruta) {
+#ifdef _WIN32
+        int r = _mkdir(ruta);
+#else
+        int r = ::mkdir(ruta, 0755);
+#endif
+        if (r != 0 && errno != EEXIST) {
+            throw std::runtime_error(std::string("No se pudo crear el directorio ") + ruta + ": " + strerror(errno));
+        }
+    }
+
+    static void borrarDirectorio(const char* ruta) {
+#ifdef _WIN32
+        _rmdir(ruta);
+#else
+        ::rmdir(ruta);
+#endif
+    }
+
+#ifndef _WIN32
+    // El limite blando suele ser 1024 descriptores: se sube hasta el duro y
+    // se dejan libres los que necesitan los hilos para sus archivos
+    static unsigned descriptoresCacheables() {
+        struct rlimit limite;
+        if (getrlimit(RLIMIT_NOFILE, &limite) != 0) return 0;
+        if (limite.rlim_cur < limite.rlim_max) {
+            struct rlimit ampliado = limite;
+            ampliado.rlim_cur = limite.rlim_max;
+            if (setrlimit(RLIMIT_NOFILE, &ampliado) == 0) limite = ampliado;
+        }
+        const rlim_t reserva = 256;
+        if (limite.rlim_cur == RLIM_INFINITY || limite.rlim_cur > MAX_FRAGMENTOS + reserva) return MAX_FRAGMENTOS;
+        return limite.rlim_cur > 2 * reserva ? static_cast<unsigned>(limite.rlim_cur - reserva)
+                                             : static_cast<unsigned>(limite.rlim_cur / 2);
+    }
+#endif
+
+    void cerrarDescriptores() {
+#ifndef _WIN32
+        for (size_t f = 0; f < descriptores.size(); ++f) {
+            if (descriptores[f] >= 0) ::close(descriptores[f]);
+        }
+        descriptores.clear();
+#endif
+        descriptoresEnCache = 0;
+    }
+
+    std::string raiz;
+    unsigned long long numArchivos;
+    unsigned fragmentos;                // potencia de 2
+    unsigned descriptoresEnCache;
+#ifndef _WIN32
+    std::vector<int> descriptores;      // uno por fragmento, -1 sin cache
+#endif
+
+    SalidaFragmentada(const SalidaFragmentada&);
+    SalidaFragmentada& operator=(const SalidaFragmentada&);
+};
+
+#endif
@@ -0,0 +1,335 @@
+// SHA-256 incremental (init/update/final) compartido por main_pro.cpp y
+// main_simple.cpp. Solo se guarda el ultimo bloque parcial de 64 bytes:
+// el resto de la entrada se comprime directamente desde el buffer del
+// llamador, sin copia con padding ni memoria proporcional al archivo.
+// La compresion usa SHA-NI cuando el CPU lo soporta (CPUID) y la version
+// portable en caso contrario.
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <stdint.h>
+#include "deteccion_cpu.h"
+
+// Constantes SHA256 (primeros 32 bits de las raices cubicas de los primeros 64 primos)
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t SHA256_H0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+// Funciones auxiliares SHA256
+static inline uint32_t sha256Rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static inline uint32_t sha256Ch(uint32_t x, uint32_t y, uint32_t z) {
+    return (x & y) ^ (~x & z);
+}
+
+static inline uint32_t sha256Maj(uint32_t x, uint32_t y, uint32_t z) {
+    return (x & y) ^ (x & z) ^ (y & z);
+}
+
+static inline uint32_t sha256Sig0(uint32_t x) {
+    return sha256Rotr(x, 2) ^ sha256Rotr(x, 13) ^ sha256Rotr(x, 22);
+}
+
+static inline uint32_t sha256Sig1(uint32_t x) {
+    return sha256Rotr(x, 6) ^ sha256Rotr(x, 11) ^ sha256Rotr(x, 25);
+}
+
+static inline uint32_t sha256Gamma0(uint32_t x) {
+    return sha256Rotr(x, 7) ^ sha256Rotr(x, 18) ^ (x >> 3);
+}
+
+static inline uint32_t sha256Gamma1(uint32_t x) {
+    return sha256Rotr(x, 17) ^ sha256Rotr(x, 19) ^ (x >> 10);
+}
+
+// Compresion portable: procesa numBloques bloques consecutivos de 64 bytes
+static inline void sha256ComprimirEscalar(uint32_t estado[8], const uint8_t* bloques, size_t numBloques) {
+    for (size_t b = 0; b < numBloques; ++b) {
+        const uint8_t* bloque = bloques + b * 64;
+        uint32_t w[64];
+
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (static_cast<uint32_t>(bloque[i * 4]) << 24) |
+                   (static_cast<uint32_t>(bloque[i * 4 + 1]) << 16) |
+                   (static_cast<uint32_t>(bloque[i * 4 + 2]) << 8) |
+                   (static_cast<uint32_t>(bloque[i * 4 + 3]));
+        }
+
+        for (int i = 16; i < 64; ++i) {
+            w[i] = sha256Gamma1(w[i - 2]) + w[i - 7] + sha256Gamma0(w[i - 15]) + w[i - 16];
+        }
+
+        uint32_t a = estado[0], b2 = estado[1], c = estado[2], d = estado[3];
+        uint32_t e = estado[4], f = estado[5], g = estado[6], h = estado[7];
+
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + sha256Sig1(e) + sha256Ch(e, f, g) + SHA256_K[i] + w[i];
+            uint32_t t2 = sha256Sig0(a) + sha256Maj(a, b2, c);
+
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b2; b2 = a; a = t1 + t2;
+        }
+
+        estado[0] += a; estado[1] += b2; estado[2] += c; estado[3] += d;
+        estado[4] += e; estado[5] += f; estado[6] += g; estado[7] += h;
+    }
+}
+
+#ifdef SO_X86_GNU
+// Compresion con las extensiones SHA de x86 (sha256rnds2/msg1/msg2).
+// El estado se reordena a ABEF/CDGH, que es el formato de sha256rnds2;
+// cada grupo g de 4 rondas usa las palabras M[g % 4] del mensaje y va
+// expandiendo las siguientes con msg1/msg2.
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha256ComprimirShaNi(uint32_t estado[8], const uint8_t* bloques, size_t numBloques) {
+    const __m128i MASCARA_BSWAP = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&estado[0])), 0xB1);
+    __m128i estado1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&estado[4])), 0x1B);
+    __m128i estado0 = _mm_alignr_epi8(tmp, estado1, 8);    // ABEF
+    estado1 = _mm_blend_epi16(estado1, tmp, 0xF0);          // CDGH
+
+    for (size_t b = 0; b < numBloques; ++b) {
+        const uint8_t* bloque = bloques + b * 64;
+        const __m128i abefPrevio = estado0;
+        const __m128i cdghPrevio = estado1;
+        __m128i m[4];
+
+#pragma GCC unroll 16
+        for (int g = 0; g < 16; ++g) {
+            if (g < 4) {
+                m[g] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bloque + g * 16)),
+                                        MASCARA_BSWAP);
+            }
+            __m128i msg = _mm_add_epi32(m[g & 3], _mm_loadu_si128(reinterpret_cast<const __m128i*>(&SHA256_K[g * 4])));
+            estado1 = _mm_sha256rnds2_epu32(estado1, estado0, msg);
+            if (g >= 3 && g <= 14) {
+                __m128i t = _mm_alignr_epi8(m[g & 3], m[(g - 1) & 3], 4);
+                m[(g + 1) & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(m[(g + 1) & 3], t), m[g & 3]);
+            }
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            estado0 = _mm_sha256rnds2_epu32(estado0, estado1, msg);
+            if (g >= 1 && g <= 12) {
+                m[(g - 1) & 3] = _mm_sha256msg1_epu32(m[(g - 1) & 3], m[g & 3]);
+            }
+        }
+
+        estado0 = _mm_add_epi32(estado0, abefPrevio);
+        estado1 = _mm_add_epi32(estado1, cdghPrevio);
+    }
+
+    tmp = _mm_shuffle_epi32(estado0, 0x1B);                // FEBA
+    estado1 = _mm_shuffle_epi32(estado1, 0xB1);            // DCHG
+    estado0 = _mm_blend_epi16(tmp, estado1, 0xF0);         // DCBA
+    estado1 = _mm_alignr_epi8(estado1, tmp, 8);            // HGFE
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&estado[0]), estado0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&estado[4]), estado1);
+}
+#endif // SO_X86_GNU
+
+typedef void (*FuncionComprimirSha256)(uint32_t estado[8], const uint8_t* bloques, size_t numBloques);
+
+struct ImplementacionSha256 {
+    const char* nombre;
+    FuncionComprimirSha256 comprimir;
+};
+
+// Comprueba una implementacion contra la portable con 3 bloques de prueba
+static inline bool verificarComprimirSha256(FuncionComprimirSha256 comprimir) {
+    uint8_t bloques[3 * 64];
+    for (size_t i = 0; i < sizeof(bloques); ++i) {
+        bloques[i] = static_cast<uint8_t>(i * 151 + 7);
+    }
+    uint32_t esperado[8];
+    uint32_t obtenido[8];
+    memcpy(esperado, SHA256_H0, sizeof(esperado));
+    memcpy(obtenido, SHA256_H0, sizeof(obtenido));
+    sha256ComprimirEscalar(esperado, bloques, 3);
+    comprimir(obtenido, bloques, 3);
+    return memcmp(esperado, obtenido, sizeof(esperado)) == 0;
+}
+
+static inline ImplementacionSha256 detectarImplementacionSha256() {
+    ImplementacionSha256 impl = {"portable", sha256ComprimirEscalar};
+#ifdef SO_X86_GNU
+    const CaracteristicasCpu& cpu = caracteristicasCpu();
+    if (cpu.sha && cpu.sse41 && cpu.ssse3 && verificarComprimirSha256(sha256ComprimirShaNi)) {
+        impl.nombre = "SHA-NI";
+        impl.comprimir = sha256ComprimirShaNi;
+    }
+#endif
+    return impl;
+}
+
+// Implementacion activa: se elige por CPUID la primera vez que se usa
+static inline ImplementacionSha256& implementacionSha256() {
+    static ImplementacionSha256 impl = detectarImplementacionSha256();
+    return impl;
+}
+
+// Permite desactivar SHA-NI (comparaciones de rendimiento)
+static inline void usarSha256Portable(bool portable) {
+    if (portable) {
+        ImplementacionSha256 escalar = {"portable", sha256ComprimirEscalar};
+        implementacionSha256() = escalar;
+    } else {
+        implementacionSha256() = detectarImplementacionSha256();
+    }
+}
+
+// Digest binario a 64 caracteres hexadecimales (solo al escribir el .sha)
+// Escribe los 64 caracteres hex y el terminador en `hex` (65 bytes)
+static inline void digestAHex(const uint8_t digest[32], char hex[65]) {
+    static const char HEX[] = "0123456789abcdef";
+    for (int i = 0; i < 32; ++i) {
+        hex[i * 2] = HEX[digest[i] >> 4];
+        hex[i * 2 + 1] = HEX[digest[i] & 0x0F];
+    }
+    hex[64] = '\0';
+}
+
+static inline std::string digestAHex(const uint8_t digest[32]) {
+    char hex[65];
+    digestAHex(digest, hex);
+    return std::string(hex, 64);
+}
+
+static inline int valorHex(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Inverso de digestAHex: false si `hex` no tiene 64 digitos hex validos
+static inline bool hexADigest(const char* hex, size_t longitud, uint8_t digest[32]) {
+    if (longitud != 64) return false;
+    for (int i = 0; i < 32; ++i) {
+        int alto = valorHex(hex[i * 2]);
+        int bajo = valorHex(hex[i * 2 + 1]);
+        if (alto < 0 || bajo < 0) return false;
+        digest[i] = static_cast<uint8_t>((alto << 4) | bajo);
+    }
+    return true;
+}
+
+class Sha256 {
+public:
+    static const size_t TAMANO_BLOQUE = 64;
+    static const size_t TAMANO_DIGEST = 32;
+
+    Sha256() {
+        reiniciar();
+    }
+
+    void reiniciar() {
+        comprimir = implementacionSha256().comprimir;
+        memcpy(estado, SHA256_H0, sizeof(estado));
+        totalBytes = 0;
+        pendientes = 0;
+    }
+
+    // Continua desde un estado intermedio tras bytesProcesados bytes (multiplo
+    // de 64), p.ej. los bloques completos ya comprimidos en sha256_multibuffer.h
+    void reanudar(const uint32_t estadoIntermedio[8], uint64_t bytesProcesados) {
+        comprimir = implementacionSha256().comprimir;
+        memcpy(estado, estadoIntermedio, sizeof(estado));
+        totalBytes = bytesProcesados;
+        pendientes = 0;
+    }
+
+    void update(const void* datos, size_t len) {
+        const uint8_t* p = static_cast<const uint8_t*>(datos);
+        totalBytes += len;
+
+        // Completar el bloque parcial de la llamada anterior
+        if (pendientes > 0) {
+            size_t faltan = TAMANO_BLOQUE - pendientes;
+            size_t n = len < faltan ? len : faltan;
+            memcpy(bloque + pendientes, p, n);
+            pendientes += n;
+            p += n;
+            len -= n;
+            if (pendientes < TAMANO_BLOQUE) return;
+            comprimir(estado, bloque, 1);
+            pendientes = 0;
+        }
+
+        // Bloques completos directamente desde la entrada
+        size_t completos = len / TAMANO_BLOQUE;
+        if (completos > 0) {
+            comprimir(estado, p, completos);
+            p += completos * TAMANO_BLOQUE;
+            len -= completos * TAMANO_BLOQUE;
+        }
+
+        if (len > 0) {
+            memcpy(bloque, p, len);
+            pendientes = len;
+        }
+    }
+
+    void final(uint8_t digest[TAMANO_DIGEST]) {
+        uint64_t bitLength = totalBytes * 8;
+
+        // Padding: 0x80, ceros hasta 56 mod 64 y longitud big-endian
+        bloque[pendientes++] = 0x80;
+        if (pendientes > 56) {
+            memset(bloque + pendientes, 0, TAMANO_BLOQUE - pendientes);
+            comprimir(estado, bloque, 1);
+            pendientes = 0;
+        }
+        memset(bloque + pendientes, 0, 56 - pendientes);
+        for (int i = 0; i < 8; ++i) {
+            bloque[56 + i] = static_cast<uint8_t>(bitLength >> ((7 - i) * 8));
+        }
+        comprimir(estado, bloque, 1);
+
+        for (int i = 0; i < 8; ++i) {
+            digest[i * 4] = static_cast<uint8_t>(estado[i] >> 24);
+            digest[i * 4 + 1] = static_cast<uint8_t>(estado[i] >> 16);
+            digest[i * 4 + 2] = static_cast<uint8_t>(estado[i] >> 8);
+            digest[i * 4 + 3] = static_cast<uint8_t>(estado[i]);
+        }
+        reiniciar();
+    }
+
+    std::string finalHex() {
+        uint8_t digest[TAMANO_DIGEST];
+        final(digest);
+        return digestAHex(digest);
+    }
+
+private:
+    FuncionComprimirSha256 comprimir;
+    uint32_t estado[8];
+    uint64_t totalBytes;
+    uint8_t bloque[TAMANO_BLOQUE];
+    size_t pendientes;
+};
+
+// Hash de un buffer completo en una sola llamada
+static inline std::string sha256Hex(const void* datos, size_t len) {
+    Sha256 ctx;
+    ctx.update(datos, len);
+    return ctx.finalHex();
+}
+
+#endif
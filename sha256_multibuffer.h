@@ -0,0 +1,384 @@
+// SHA-256 multi-buffer: calcula el hash de varios mensajes independientes
+// a la vez, uno por carril SIMD (4 con SSE2, 8 con AVX2, 16 con AVX-512).
+// Pensado para CPUs sin SHA-NI, donde la compresion escalar deja libres
+// casi todos los carriles; con SHA-NI se hashea cada mensaje por separado.
+//
+// Uso: PlanificadorHashes acumula los trabajos pendientes (por ejemplo los
+// archivos de un lote) y al ejecutar los agrupa por longitud para que los
+// carriles de cada pasada compartan el mayor numero de bloques.
+#ifndef SHA256_MULTIBUFFER_H
+#define SHA256_MULTIBUFFER_H
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+#include "sha256.h"
+
+static const int SIN_PREFIJO = -1;
+
+// Con prefijo se hashea ese byte antes de los datos (el 0x00 de las hojas
+// Merkle) sin copiar el mensaje
+struct TrabajoSha256 {
+    const void* datos;
+    size_t longitud;
+    uint8_t* digest;    // destino de 32 bytes
+    int prefijo;        // byte previo a los datos, o SIN_PREFIJO
+};
+
+// Bytes que entran al hash: el prefijo mas los datos
+static inline size_t longitudHasheada(const TrabajoSha256& t) {
+    return t.longitud + (t.prefijo != SIN_PREFIJO ? 1 : 0);
+}
+
+// Copia los bytes [desde, desde + n) del mensaje con su prefijo
+static inline void copiarMensajeSha256(const TrabajoSha256& t, size_t desde, size_t n, uint8_t* destino) {
+    const uint8_t* datos = static_cast<const uint8_t*>(t.datos);
+    if (t.prefijo == SIN_PREFIJO) {
+        memcpy(destino, datos + desde, n);
+    } else if (n > 0 && desde == 0) {
+        destino[0] = static_cast<uint8_t>(t.prefijo);
+        memcpy(destino + 1, datos, n - 1);
+    } else if (n > 0) {
+        memcpy(destino, datos + desde - 1, n);
+    }
+}
+
+// Hashea en `ctx` el mensaje desde el byte `desde` hasta el final
+static inline void actualizarSha256(Sha256& ctx, const TrabajoSha256& t, size_t desde) {
+    const uint8_t* datos = static_cast<const uint8_t*>(t.datos);
+    if (t.prefijo == SIN_PREFIJO) {
+        ctx.update(datos + desde, t.longitud - desde);
+    } else if (desde == 0) {
+        const uint8_t prefijo = static_cast<uint8_t>(t.prefijo);
+        ctx.update(&prefijo, 1);
+        ctx.update(datos, t.longitud);
+    } else {
+        ctx.update(datos + desde - 1, t.longitud + 1 - desde);
+    }
+}
+
+// estado: 8 palabras x N carriles (transpuesto: estado[palabra * N + carril])
+typedef void (*KernelSha256Multiple)(uint32_t* estado, const uint8_t* const* mensajes, size_t numBloques);
+
+#ifdef SO_X86_GNU
+
+typedef uint32_t VectorSha4 __attribute__((vector_size(16)));
+typedef uint32_t VectorSha8 __attribute__((vector_size(32)));
+typedef uint32_t VectorSha16 __attribute__((vector_size(64)));
+
+// Macros (y no funciones) para no pasar vectores por valor entre funciones
+// con distinto target, que cambiaria la ABI
+#define SHA_MB_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define SHA_MB_SIG0(x) (SHA_MB_ROTR(x, 2) ^ SHA_MB_ROTR(x, 13) ^ SHA_MB_ROTR(x, 22))
+#define SHA_MB_SIG1(x) (SHA_MB_ROTR(x, 6) ^ SHA_MB_ROTR(x, 11) ^ SHA_MB_ROTR(x, 25))
+#define SHA_MB_GAMMA0(x) (SHA_MB_ROTR(x, 7) ^ SHA_MB_ROTR(x, 18) ^ ((x) >> 3))
+#define SHA_MB_GAMMA1(x) (SHA_MB_ROTR(x, 17) ^ SHA_MB_ROTR(x, 19) ^ ((x) >> 10))
+
+// Cuerpo comun: se instancia dentro de cada wrapper con su target, asi el
+// compilador genera SSE2, AVX2 o AVX-512 a partir del mismo codigo
+template <typename V, int N>
+static inline __attribute__((always_inline))
+void sha256ComprimirCarriles(uint32_t* estadoTranspuesto, const uint8_t* const* mensajes, size_t numBloques) {
+    V s[8];
+    for (int i = 0; i < 8; ++i) {
+        memcpy(&s[i], estadoTranspuesto + i * N, sizeof(V));
+    }
+
+    for (size_t b = 0; b < numBloques; ++b) {
+        V w[16];
+        for (int i = 0; i < 16; ++i) {
+            uint32_t palabras[N];
+            for (int l = 0; l < N; ++l) {
+                uint32_t x;
+                memcpy(&x, mensajes[l] + b * 64 + i * 4, 4);
+                palabras[l] = __builtin_bswap32(x);
+            }
+            memcpy(&w[i], palabras, sizeof(V));
+        }
+
+        V a = s[0], bb = s[1], c = s[2], d = s[3];
+        V e = s[4], f = s[5], g = s[6], h = s[7];
+
+        for (int i = 0; i < 64; ++i) {
+            if (i >= 16) {
+                w[i & 15] += SHA_MB_GAMMA1(w[(i - 2) & 15]) + w[(i - 7) & 15] + SHA_MB_GAMMA0(w[(i - 15) & 15]);
+            }
+            V t1 = h + SHA_MB_SIG1(e) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i & 15];
+            V t2 = SHA_MB_SIG0(a) + ((a & bb) ^ (a & c) ^ (bb & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = bb; bb = a; a = t1 + t2;
+        }
+
+        s[0] += a; s[1] += bb; s[2] += c; s[3] += d;
+        s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        memcpy(estadoTranspuesto + i * N, &s[i], sizeof(V));
+    }
+}
+
+#undef SHA_MB_GAMMA1
+#undef SHA_MB_GAMMA0
+#undef SHA_MB_SIG1
+#undef SHA_MB_SIG0
+#undef SHA_MB_ROTR
+
+__attribute__((target("sse2")))
+static void sha256Multiple4Sse2(uint32_t* estado, const uint8_t* const* mensajes, size_t numBloques) {
+    sha256ComprimirCarriles<VectorSha4, 4>(estado, mensajes, numBloques);
+}
+
+__attribute__((target("avx2")))
+static void sha256Multiple8Avx2(uint32_t* estado, const uint8_t* const* mensajes, size_t numBloques) {
+    sha256ComprimirCarriles<VectorSha8, 8>(estado, mensajes, numBloques);
+}
+
+__attribute__((target("avx512f")))
+static void sha256Multiple16Avx512(uint32_t* estado, const uint8_t* const* mensajes, size_t numBloques) {
+    sha256ComprimirCarriles<VectorSha16, 16>(estado, mensajes, numBloques);
+}
+
+#endif // SO_X86_GNU
+
+static const size_t SHA256_MAX_CARRILES = 16;
+
+struct MotorSha256Multiple {
+    const char* nombre;
+    size_t carriles;               // 1 => un mensaje a la vez (Sha256)
+    KernelSha256Multiple kernel;
+};
+
+// Procesa hasta 'carriles' trabajos en una pasada. Los carriles sobrantes
+// repiten el primer trabajo y su resultado se descarta.
+static inline void sha256ProcesarGrupo(const MotorSha256Multiple& motor, TrabajoSha256* const* grupo, size_t k) {
+    const size_t N = motor.carriles;
+    uint32_t estado[8 * SHA256_MAX_CARRILES] = {0};
+    const uint8_t* mensajes[SHA256_MAX_CARRILES] = {NULL};
+
+    size_t minLongitud = longitudHasheada(*grupo[0]);
+    bool mismaLongitud = true;
+    bool conPrefijo = grupo[0]->prefijo != SIN_PREFIJO;
+    for (size_t l = 1; l < k; ++l) {
+        minLongitud = std::min(minLongitud, longitudHasheada(*grupo[l]));
+        mismaLongitud = mismaLongitud && longitudHasheada(*grupo[l]) == longitudHasheada(*grupo[0]);
+        conPrefijo = conPrefijo || grupo[l]->prefijo != SIN_PREFIJO;
+    }
+    const size_t bloquesComunes = minLongitud / 64;
+
+    for (size_t l = 0; l < N; ++l) {
+        for (int i = 0; i < 8; ++i) {
+            estado[i * N + l] = SHA256_H0[i];
+        }
+    }
+
+    // Con prefijo el primer bloque se arma aparte y los demas se leen de
+    // los datos corridos un byte
+    size_t hechos = 0;
+    if (conPrefijo && bloquesComunes > 0) {
+        uint8_t primero[SHA256_MAX_CARRILES][64];
+        for (size_t l = 0; l < N; ++l) {
+            copiarMensajeSha256(*grupo[l < k ? l : 0], 0, 64, primero[l]);
+            mensajes[l] = primero[l];
+        }
+        motor.kernel(estado, mensajes, 1);
+        hechos = 1;
+    }
+    for (size_t l = 0; l < N; ++l) {
+        const TrabajoSha256& t = *grupo[l < k ? l : 0];
+        size_t corrimiento = hechos > 0 && t.prefijo != SIN_PREFIJO ? 1 : 0;
+        mensajes[l] = static_cast<const uint8_t*>(t.datos) + hechos * 64 - corrimiento;
+    }
+    motor.kernel(estado, mensajes, bloquesComunes - hechos);
+
+    if (mismaLongitud) {
+        // Misma cola en todos los carriles: padding en lanes tambien
+        const size_t resto = minLongitud - bloquesComunes * 64;
+        const size_t bloquesCola = (resto + 9 <= 64) ? 1 : 2;
+        const uint64_t bitLength = static_cast<uint64_t>(minLongitud) * 8;
+        uint8_t cola[SHA256_MAX_CARRILES][128];
+        for (size_t l = 0; l < N; ++l) {
+            memset(cola[l], 0, bloquesCola * 64);
+            copiarMensajeSha256(*grupo[l < k ? l : 0], bloquesComunes * 64, resto, cola[l]);
+            cola[l][resto] = 0x80;
+            for (int i = 0; i < 8; ++i) {
+                cola[l][bloquesCola * 64 - 1 - i] = static_cast<uint8_t>(bitLength >> (i * 8));
+            }
+            mensajes[l] = cola[l];
+        }
+        motor.kernel(estado, mensajes, bloquesCola);
+
+        for (size_t l = 0; l < k; ++l) {
+            for (int i = 0; i < 8; ++i) {
+                uint32_t x = estado[i * N + l];
+                grupo[l]->digest[i * 4] = static_cast<uint8_t>(x >> 24);
+                grupo[l]->digest[i * 4 + 1] = static_cast<uint8_t>(x >> 16);
+                grupo[l]->digest[i * 4 + 2] = static_cast<uint8_t>(x >> 8);
+                grupo[l]->digest[i * 4 + 3] = static_cast<uint8_t>(x);
+            }
+        }
+        return;
+    }
+
+    // Longitudes distintas: cada carril termina por su cuenta
+    for (size_t l = 0; l < k; ++l) {
+        uint32_t parcial[8];
+        for (int i = 0; i < 8; ++i) {
+            parcial[i] = estado[i * N + l];
+        }
+        Sha256 ctx;
+        ctx.reanudar(parcial, static_cast<uint64_t>(bloquesComunes) * 64);
+        actualizarSha256(ctx, *grupo[l], bloquesComunes * 64);
+        ctx.final(grupo[l]->digest);
+    }
+}
+
+// Compara un motor contra Sha256 con longitudes que ejercitan cola de 1 y
+// 2 bloques, grupos de igual y distinta longitud, carriles sobrantes y
+// grupos con y sin prefijo
+static inline bool verificarMotorSha256Multiple(const MotorSha256Multiple& motor) {
+    const size_t longitudes[] = {0, 55, 56, 64, 119, 200, 200, 200, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000};
+    const size_t n = sizeof(longitudes) / sizeof(longitudes[0]);
+    std::vector<uint8_t> datos(1000 + SHA256_MAX_CARRILES);
+    for (size_t i = 0; i < datos.size(); ++i) {
+        datos[i] = static_cast<uint8_t>(i * 31 + 5);
+    }
+
+    for (size_t inicio = 0; inicio < n; inicio += motor.carriles) {
+        size_t k = std::min(motor.carriles, n - inicio);
+        std::vector<TrabajoSha256> trabajos(k);
+        std::vector<TrabajoSha256*> grupo(k);
+        std::vector<uint8_t> digests(k * 32);
+        for (size_t l = 0; l < k; ++l) {
+            int prefijo = (inicio / motor.carriles) % 2 == 1 || l == 1 ? 0x00 : SIN_PREFIJO;
+            TrabajoSha256 t = {&datos[l], longitudes[inicio + l], &digests[l * 32], prefijo};
+            trabajos[l] = t;
+            grupo[l] = &trabajos[l];
+        }
+        sha256ProcesarGrupo(motor, &grupo[0], k);
+        for (size_t l = 0; l < k; ++l) {
+            Sha256 ctx;
+            uint8_t esperado[32];
+            if (trabajos[l].prefijo != SIN_PREFIJO) {
+                const uint8_t prefijo = static_cast<uint8_t>(trabajos[l].prefijo);
+                ctx.update(&prefijo, 1);
+            }
+            ctx.update(trabajos[l].datos, trabajos[l].longitud);
+            ctx.final(esperado);
+            if (memcmp(esperado, trabajos[l].digest, 32) != 0) return false;
+        }
+    }
+    return true;
+}
+
+static inline MotorSha256Multiple detectarMotorSha256Multiple() {
+    MotorSha256Multiple motor = {"secuencial", 1, NULL};
+#ifdef SO_X86_GNU
+    const CaracteristicasCpu& cpu = caracteristicasCpu();
+    MotorSha256Multiple candidatos[3] = {
+        {"AVX-512 x16", 16, sha256Multiple16Avx512},
+        {"AVX2 x8", 8, sha256Multiple8Avx2},
+        {"SSE2 x4", 4, sha256Multiple4Sse2}
+    };
+    bool soportado[3] = {cpu.avx512bw, cpu.avx2, cpu.sse2};
+    for (int i = 0; i < 3; ++i) {
+        if (soportado[i] && verificarMotorSha256Multiple(candidatos[i])) {
+            return candidatos[i];
+        }
+    }
+#endif
+    return motor;
+}
+
+// Motor de carriles disponible en este CPU (se detecta una sola vez)
+static inline const MotorSha256Multiple& motorSha256Carriles() {
+    static const MotorSha256Multiple motor = detectarMotorSha256Multiple();
+    return motor;
+}
+
+// Motor que se usa realmente: con SHA-NI activo un mensaje a la vez es mas
+// rapido que los carriles, asi que los carriles solo se usan sin SHA-NI
+static inline MotorSha256Multiple motorSha256Multiple() {
+    if (implementacionSha256().comprimir != sha256ComprimirEscalar) {
+        MotorSha256Multiple secuencial = {implementacionSha256().nombre, 1, NULL};
+        return secuencial;
+    }
+    return motorSha256Carriles();
+}
+
+static inline bool compararPorLongitud(const TrabajoSha256* a, const TrabajoSha256* b) {
+    return longitudHasheada(*a) < longitudHasheada(*b);
+}
+
+static const size_t MAX_TRABAJOS_SIN_HEAP = 64;
+
+// Calcula todos los trabajos, agrupandolos por longitud en pasadas de
+// 'carriles' mensajes
+static inline void sha256Multiple(TrabajoSha256* trabajos, size_t n) {
+    const MotorSha256Multiple motor = motorSha256Multiple();
+    if (motor.carriles <= 1 || n == 1) {
+        for (size_t i = 0; i < n; ++i) {
+            Sha256 ctx;
+            actualizarSha256(ctx, trabajos[i], 0);
+            ctx.final(trabajos[i].digest);
+        }
+        return;
+    }
+
+    // Lotes chicos (lo normal: un lote por hilo): orden en la pila con
+    // insercion estable, sin tocar el heap ni el buffer de stable_sort
+    TrabajoSha256* ordenLocal[MAX_TRABAJOS_SIN_HEAP];
+    std::vector<TrabajoSha256*> ordenHeap;
+    TrabajoSha256** orden = ordenLocal;
+    if (n > MAX_TRABAJOS_SIN_HEAP) {
+        ordenHeap.resize(n);
+        orden = &ordenHeap[0];
+    }
+    for (size_t i = 0; i < n; ++i) {
+        orden[i] = &trabajos[i];
+    }
+    if (n > MAX_TRABAJOS_SIN_HEAP) {
+        std::stable_sort(orden, orden + n, compararPorLongitud);
+    } else {
+        for (size_t i = 1; i < n; ++i) {
+            TrabajoSha256* t = orden[i];
+            size_t j = i;
+            for (; j > 0 && compararPorLongitud(t, orden[j - 1]); --j) {
+                orden[j] = orden[j - 1];
+            }
+            orden[j] = t;
+        }
+    }
+
+    for (size_t inicio = 0; inicio < n; inicio += motor.carriles) {
+        sha256ProcesarGrupo(motor, &orden[inicio], std::min(motor.carriles, n - inicio));
+    }
+}
+
+// Acumula hashes pendientes y los resuelve juntos
+class PlanificadorHashes {
+public:
+    void agregar(const void* datos, size_t longitud, uint8_t* digest, int prefijo = SIN_PREFIJO) {
+        TrabajoSha256 t = {datos, longitud, digest, prefijo};
+        pendientes.push_back(t);
+    }
+
+    size_t numPendientes() const {
+        return pendientes.size();
+    }
+
+    // La capacidad de `pendientes` se conserva entre llamadas: un
+    // planificador reutilizado no vuelve a reservar memoria
+    void ejecutar() {
+        if (!pendientes.empty()) {
+            sha256Multiple(&pendientes[0], pendientes.size());
+            pendientes.clear();
+        }
+    }
+
+private:
+    std::vector<TrabajoSha256> pendientes;
+};
+
+#endif
@@ -0,0 +1,402 @@
+// Topologia de CPUs y colocacion de los hilos de trabajo (--colocacion).
+// En Linux se lee de /sys: CPUs en linea (y permitidas al proceso), nucleo
+// fisico de cada una (las hermanas SMT lo comparten) y nodo NUMA. Con una
+// colocacion activa cada hilo del pool se fija a una CPU al arrancar: primero
+// una por nucleo fisico y solo despues las hermanas SMT. "compacta" llena
+// un nodo antes de pasar al siguiente; "dispersa" alterna nodos para
+// sumar el ancho de banda de memoria de todos.
+//
+// Lo que un hilo fijado reserva y toca primero (su buffer de I/O, su arena,
+// sus bloques) queda en su nodo por la politica de primer toque del kernel.
+// El original compartido se replica con ReplicasNuma, una copia por nodo
+// con hilos, para no leerlo cruzando nodos.
+//
+// Fuera de Linux la topologia es una CPU por nucleo en un solo nodo; en
+// Windows los hilos igual se fijan con SetThreadAffinityMask.
+#ifndef TOPOLOGIA_H
+#define TOPOLOGIA_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "paginas_grandes.h"
+#include "plataforma.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+enum ColocacionHilos {
+    COLOCACION_NINGUNA,     // los hilos flotan, como siempre
+    COLOCACION_COMPACTA,
+    COLOCACION_DISPERSA
+};
+
+static inline const char* nombreColocacion(ColocacionHilos modo) {
+    switch (modo) {
+        case COLOCACION_COMPACTA: return "compacta";
+        case COLOCACION_DISPERSA: return "dispersa";
+        default: return "ninguna";
+    }
+}
+
+static inline bool parsearColocacion(const std::string& nombre, ColocacionHilos& modo) {
+    if (nombre == "ninguna") modo = COLOCACION_NINGUNA;
+    else if (nombre == "compacta") modo = COLOCACION_COMPACTA;
+    else if (nombre == "dispersa") modo = COLOCACION_DISPERSA;
+    else return false;
+    return true;
+}
+
+struct CpuLogica {
+    int id;         // numero de CPU del sistema
+    int nucleo;     // nucleo fisico; las hermanas SMT comparten el valor
+    int hermana;    // 0 la primera CPU del nucleo, 1 la segunda...
+    int nodo;       // nodo NUMA
+};
+
+struct TopologiaCpu {
+    std::vector<CpuLogica> cpus;    // por id, solo las que el proceso puede usar
+    int numNucleos;
+    int numNodos;
+    bool deSistema;                 // leida de /sys; si no, valores por defecto
+};
+
+// Lista de CPUs del kernel: "0-3,8-11"
+static inline std::vector<int> parsearListaCpus(const std::string& texto) {
+    std::vector<int> cpus;
+    std::stringstream lista(texto);
+    std::string rango;
+    while (std::getline(lista, rango, ',')) {
+        int desde = 0;
+        int hasta = 0;
+        int leidos = sscanf(rango.c_str(), "%d-%d", &desde, &hasta);
+        if (leidos < 1) continue;
+        if (leidos == 1) hasta = desde;
+        for (int c = desde; c <= hasta; ++c) {
+            cpus.push_back(c);
+        }
+    }
+    return cpus;
+}
+
+// Primera linea del archivo, vacia si no existe
+static inline std::string leerLineaSistema(const std::string& ruta) {
+    std::ifstream archivo(ruta.c_str());
+    std::string linea;
+    std::getline(archivo, linea);
+    return linea;
+}
+
+// Una CPU por nucleo en un solo nodo
+static inline TopologiaCpu topologiaPorDefecto() {
+    TopologiaCpu topo;
+    unsigned n = numeroProcesadores();
+    for (unsigned i = 0; i < n; ++i) {
+        CpuLogica cpu;
+        cpu.id = static_cast<int>(i);
+        cpu.nucleo = static_cast<int>(i);
+        cpu.hermana = 0;
+        cpu.nodo = 0;
+        topo.cpus.push_back(cpu);
+    }
+    topo.numNucleos = static_cast<int>(n);
+    topo.numNodos = 1;
+    topo.deSistema = false;
+    return topo;
+}
+
+static inline TopologiaCpu descubrirTopologia() {
+#ifdef __linux__
+    std::vector<int> enLinea = parsearListaCpus(leerLineaSistema("/sys/devices/system/cpu/online"));
+    if (enLinea.empty()) return topologiaPorDefecto();
+    cpu_set_t permitidas;
+    bool conMascara = sched_getaffinity(0, sizeof(permitidas), &permitidas) == 0;
+
+    std::map<int, int> nodoDeCpu;
+    std::vector<int> nodos = parsearListaCpus(leerLineaSistema("/sys/devices/system/node/online"));
+    for (size_t i = 0; i < nodos.size(); ++i) {
+        std::vector<int> cpusNodo = parsearListaCpus(
+            leerLineaSistema("/sys/devices/system/node/node" + std::to_string(nodos[i]) + "/cpulist"));
+        for (size_t c = 0; c < cpusNodo.size(); ++c) {
+            nodoDeCpu[cpusNodo[c]] = nodos[i];
+        }
+    }
+
+    // El nucleo se identifica por la primera de sus hermanas SMT
+    TopologiaCpu topo;
+    std::map<int, int> nucleoDePrimera;
+    std::map<int, int> hermanasVistas;
+    std::map<int, bool> nodosVistos;
+    for (size_t i = 0; i < enLinea.size(); ++i) {
+        int id = enLinea[i];
+        if (conMascara && (id >= CPU_SETSIZE || !CPU_ISSET(id, &permitidas))) continue;
+        std::vector<int> hermanas = parsearListaCpus(leerLineaSistema(
+            "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/thread_siblings_list"));
+        int primera = hermanas.empty() ? id : *std::min_element(hermanas.begin(), hermanas.end());
+        if (nucleoDePrimera.find(primera) == nucleoDePrimera.end()) {
+            int siguiente = static_cast<int>(nucleoDePrimera.size());
+            nucleoDePrimera[primera] = siguiente;
+        }
+        CpuLogica cpu;
+        cpu.id = id;
+        cpu.nucleo = nucleoDePrimera[primera];
+        cpu.hermana = hermanasVistas[cpu.nucleo]++;
+        std::map<int, int>::const_iterator nodo = nodoDeCpu.find(id);
+        cpu.nodo = nodo != nodoDeCpu.end() ? nodo->second : 0;
+        nodosVistos[cpu.nodo] = true;
+        topo.cpus.push_back(cpu);
+    }
+    if (topo.cpus.empty()) return topologiaPorDefecto();
+    topo.numNucleos = static_cast<int>(nucleoDePrimera.size());
+    topo.numNodos = static_cast<int>(nodosVistos.size());
+    topo.deSistema = true;
+    return topo;
+#else
+    return topologiaPorDefecto();
+#endif
+}
+
+// Orden en que los hilos toman CPUs: todas las primeras hermanas antes que
+// cualquier segunda. Dentro de cada vuelta, compacta va nodo por nodo y
+// dispersa alterna una CPU de cada nodo.
+static inline std::vector<int> ordenColocacion(const TopologiaCpu& topo, ColocacionHilos modo) {
+    std::vector<int> orden;
+    if (modo == COLOCACION_NINGUNA) return orden;
+    int maxHermana = 0;
+    for (size_t i = 0; i < topo.cpus.size(); ++i) {
+        maxHermana = std::max(maxHermana, topo.cpus[i].hermana);
+    }
+    for (int vuelta = 0; vuelta <= maxHermana; ++vuelta) {
+        std::map<int, std::vector<int> > porNodo;
+        for (size_t i = 0; i < topo.cpus.size(); ++i) {
+            if (topo.cpus[i].hermana == vuelta) porNodo[topo.cpus[i].nodo].push_back(topo.cpus[i].id);
+        }
+        if (modo == COLOCACION_COMPACTA) {
+            for (std::map<int, std::vector<int> >::const_iterator n = porNodo.begin(); n != porNodo.end(); ++n) {
+                orden.insert(orden.end(), n->second.begin(), n->second.end());
+            }
+        } else {
+            for (size_t k = 0;; ++k) {
+                bool quedan = false;
+                for (std::map<int, std::vector<int> >::const_iterator n = porNodo.begin(); n != porNodo.end(); ++n) {
+                    if (k < n->second.size()) {
+                        orden.push_back(n->second[k]);
+                        quedan = true;
+                    }
+                }
+                if (!quedan) break;
+            }
+        }
+    }
+    return orden;
+}
+
+// ESTADO GLOBAL: se fija antes de crear el pool y no cambia despues
+struct EstadoColocacion {
+    ColocacionHilos modo;
+    TopologiaCpu topologia;
+    std::vector<int> orden;         // CPU de cada hilo (modulo su tamano)
+};
+
+static inline EstadoColocacion& estadoColocacion() {
+    static EstadoColocacion estado;
+    return estado;
+}
+
+// Nodo NUMA del hilo que llama; -1 si no esta fijado
+static inline int& nodoNumaDelHilo() {
+    static thread_local int nodo = -1;
+    return nodo;
+}
+
+static inline int nodoDeCpu(const TopologiaCpu& topo, int id) {
+    for (size_t i = 0; i < topo.cpus.size(); ++i) {
+        if (topo.cpus[i].id == id) return topo.cpus[i].nodo;
+    }
+    return 0;
+}
+
+// CPU del hilo `indice` del pool, -1 sin colocacion
+static inline int cpuDeHilo(size_t indice) {
+    const std::vector<int>& orden = estadoColocacion().orden;
+    return orden.empty() ? -1 : orden[indice % orden.size()];
+}
+
+// Nodos con algun hilo de un pool de numHilos, sin repetir
+static inline std::vector<int> nodosConHilos(size_t numHilos) {
+    std::vector<int> nodos;
+    for (size_t i = 0; i < numHilos && !estadoColocacion().orden.empty(); ++i) {
+        int nodo = nodoDeCpu(estadoColocacion().topologia, cpuDeHilo(i));
+        if (std::find(nodos.begin(), nodos.end(), nodo) == nodos.end()) nodos.push_back(nodo);
+    }
+    return nodos;
+}
+
+// Mascara de afinidad del hilo que llama
+#ifdef __linux__
+typedef cpu_set_t MascaraAfinidad;
+#elif defined(_WIN32)
+typedef DWORD_PTR MascaraAfinidad;
+#else
+typedef int MascaraAfinidad;
+#endif
+
+static inline bool leerAfinidadHilo(MascaraAfinidad& mascara) {
+#ifdef __linux__
+    return sched_getaffinity(0, sizeof(mascara), &mascara) == 0;
+#elif defined(_WIN32)
+    // Windows no da la del hilo: se usa la del proceso
+    DWORD_PTR proceso = 0;
+    DWORD_PTR sistema = 0;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &proceso, &sistema)) return false;
+    mascara = proceso;
+    return true;
+#else
+    (void)mascara;
+    return false;
+#endif
+}
+
+static inline bool fijarAfinidadHilo(const MascaraAfinidad& mascara) {
+#ifdef __linux__
+    return sched_setaffinity(0, sizeof(mascara), &mascara) == 0;
+#elif defined(_WIN32)
+    return SetThreadAffinityMask(GetCurrentThread(), mascara) != 0;
+#else
+    (void)mascara;
+    return false;
+#endif
+}
+
+static inline bool fijarHiloEnCpu(int id) {
+    if (id < 0) return false;
+    MascaraAfinidad mascara;
+#ifdef __linux__
+    if (id >= CPU_SETSIZE) return false;
+    CPU_ZERO(&mascara);
+    CPU_SET(id, &mascara);
+#elif defined(_WIN32)
+    if (id >= static_cast<int>(sizeof(DWORD_PTR) * 8)) return false;
+    mascara = static_cast<DWORD_PTR>(1) << id;
+#else
+    mascara = 0;
+#endif
+    return fijarAfinidadHilo(mascara);
+}
+
+// Llamar al arrancar cada hilo del pool, antes de que reserve nada
+static inline void fijarHiloTrabajador(size_t indice) {
+    int cpu = cpuDeHilo(indice);
+    if (cpu >= 0 && fijarHiloEnCpu(cpu)) {
+        nodoNumaDelHilo() = nodoDeCpu(estadoColocacion().topologia, cpu);
+    }
+}
+
+// Descubre la topologia y fija la colocacion de los pools que se creen
+// despues. Devuelve la linea para el encabezado.
+static inline std::string activarColocacion(ColocacionHilos modo) {
+    EstadoColocacion& estado = estadoColocacion();
+    estado.modo = modo;
+    estado.topologia = descubrirTopologia();
+    estado.orden = ordenColocacion(estado.topologia, modo);
+    const TopologiaCpu& topo = estado.topologia;
+    std::ostringstream linea;
+    linea << nombreColocacion(modo) << " (" << topo.numNodos << (topo.numNodos == 1 ? " nodo NUMA, " : " nodos NUMA, ")
+          << topo.numNucleos << (topo.numNucleos == 1 ? " nucleo, " : " nucleos, ") << topo.cpus.size()
+          << (topo.cpus.size() == 1 ? " CPU logica" : " CPUs logicas") << (topo.deSistema ? "" : " supuestas")
+          << ")";
+    if (!estado.orden.empty()) {
+        linea << ", CPUs:";
+        for (size_t i = 0; i < estado.orden.size() && i < 16; ++i) {
+            linea << (i > 0 ? "," : " ") << estado.orden[i];
+        }
+        if (estado.orden.size() > 16) linea << ",...";
+    }
+    return linea.str();
+}
+
+// COPIAS DEL ORIGINAL POR NODO
+// Cada copia se reserva y se escribe con el hilo que llama fijado en una
+// CPU del nodo, asi el primer toque deja sus paginas ahi; despues se le
+// devuelve su afinidad. Solo en Linux y con mas de un nodo: en un nodo
+// solo el original ya es local. Con --paginas=grandes las copias tambien
+// van en paginas de 2 MB.
+class ReplicasNuma {
+public:
+    ReplicasNuma() {}
+    ~ReplicasNuma() {
+        liberar();
+    }
+
+    // Devuelve cuantas copias hizo
+    size_t crear(const char* datos, size_t bytes, size_t numHilos) {
+        liberar();
+        const EstadoColocacion& estado = estadoColocacion();
+        if (datos == NULL || bytes == 0 || estado.topologia.numNodos < 2) return 0;
+#ifdef __linux__
+        MascaraAfinidad anterior;
+        if (!leerAfinidadHilo(anterior)) return 0;
+        std::vector<int> nodos = nodosConHilos(numHilos);
+        for (size_t n = 0; n < nodos.size(); ++n) {
+            if (!fijarHiloEnCpu(primeraCpuDelNodo(nodos[n]))) continue;
+            BloqueGrande* copia = new BloqueGrande();
+            try {
+                memcpy(copia->reservar(bytes), datos, bytes);
+            } catch (const std::bad_alloc&) {
+                delete copia;
+                continue;
+            }
+            if (copias.size() <= static_cast<size_t>(nodos[n])) copias.resize(nodos[n] + 1, NULL);
+            copias[nodos[n]] = copia;
+        }
+        fijarAfinidadHilo(anterior);
+#else
+        (void)numHilos;
+#endif
+        return numCopias();
+    }
+
+    // Copia del nodo, NULL si no tiene
+    const char* deNodo(int nodo) const {
+        if (nodo < 0 || static_cast<size_t>(nodo) >= copias.size()) return NULL;
+        return copias[nodo] != NULL ? copias[nodo]->datos() : NULL;
+    }
+
+    size_t numCopias() const {
+        size_t n = 0;
+        for (size_t i = 0; i < copias.size(); ++i) {
+            if (copias[i] != NULL) ++n;
+        }
+        return n;
+    }
+
+    void liberar() {
+        for (size_t i = 0; i < copias.size(); ++i) {
+            delete copias[i];
+        }
+        copias.clear();
+    }
+
+private:
+    std::vector<BloqueGrande*> copias;      // por numero de nodo
+
+    static int primeraCpuDelNodo(int nodo) {
+        const TopologiaCpu& topo = estadoColocacion().topologia;
+        for (size_t i = 0; i < topo.cpus.size(); ++i) {
+            if (topo.cpus[i].nodo == nodo) return topo.cpus[i].id;
+        }
+        return -1;
+    }
+
+    ReplicasNuma(const ReplicasNuma&);
+    ReplicasNuma& operator=(const ReplicasNuma&);
+};
+
+#endif
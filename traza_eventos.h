@@ -0,0 +1,191 @@
+// Linea de tiempo de los hilos en formato Chrome trace-event (--trace=ruta).
+// Cada hilo anota tramos (inicio, fin, nombre y archivo) en un buffer
+// circular propio: sin cerrojos ni reservas despues del primero, y si se
+// llena se pisan los mas viejos. escribirTraza() junta los buffers al
+// final en un JSON que abren chrome://tracing y ui.perfetto.dev: una fila
+// por hilo, donde se ven los huecos ociosos y el archivo que llega tarde
+// que el promedio de TPPA esconde.
+//
+// Sin trazaActiva() las funciones vuelven enseguida, sin leer el reloj.
+#ifndef TRAZA_EVENTOS_H
+#define TRAZA_EVENTOS_H
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+// Eventos por hilo antes de empezar a pisar los mas viejos (32 B cada uno)
+static const size_t CAPACIDAD_TRAZA = 1 << 16;
+
+struct EventoTraza {
+    const char* nombre;     // literal o nombreEtapa(): no se copia
+    int primero;            // archivo (o primero del lote), -1 si no aplica
+    int ultimo;
+    uint64_t inicioNs;
+    uint64_t finNs;
+};
+
+struct BufferTraza {
+    std::string nombreHilo;
+    std::vector<EventoTraza> eventos;   // circular, CAPACIDAD_TRAZA
+    uint64_t escritos;
+};
+
+struct EstadoTraza {
+    uint64_t origenNs;      // ts 0 del JSON
+    std::mutex cerrojo;
+    // Duenos de los buffers: sobreviven al hilo y se liberan al salir
+    std::vector<std::unique_ptr<BufferTraza> > registro;
+};
+
+static inline EstadoTraza& estadoTraza() {
+    static EstadoTraza estado;
+    return estado;
+}
+
+// Se fija antes de crear los hilos de trabajo y no cambia despues
+static inline bool& banderaTraza() {
+    static bool activa = false;
+    return activa;
+}
+
+static inline bool trazaActiva() {
+    return banderaTraza();
+}
+
+static inline uint64_t nsTraza() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+static inline BufferTraza*& bufferTrazaPropio() {
+    static thread_local BufferTraza* buffer = NULL;
+    return buffer;
+}
+
+// Buffer del hilo que llama; el primero lo reserva y lo registra
+static inline BufferTraza& bufferTrazaDelHilo() {
+    BufferTraza*& buffer = bufferTrazaPropio();
+    if (buffer == NULL) {
+        std::unique_ptr<BufferTraza> nuevo(new BufferTraza());
+        nuevo->eventos.resize(CAPACIDAD_TRAZA);
+        nuevo->escritos = 0;
+        EstadoTraza& estado = estadoTraza();
+        std::lock_guard<std::mutex> lock(estado.cerrojo);
+        nuevo->nombreHilo = "hilo " + std::to_string(estado.registro.size());
+        estado.registro.push_back(std::move(nuevo));
+        buffer = estado.registro.back().get();
+    }
+    return *buffer;
+}
+
+// Nombre de la fila del hilo que llama. Llamarlo al arrancar el hilo
+// tambien deja el buffer reservado antes de la primera tarea.
+static inline void nombrarHiloTraza(const std::string& nombre) {
+    if (!trazaActiva()) return;
+    BufferTraza& buffer = bufferTrazaDelHilo();
+    std::lock_guard<std::mutex> lock(estadoTraza().cerrojo);
+    buffer.nombreHilo = nombre;
+}
+
+// Activa la traza; el hilo que llama queda como "principal"
+static inline void activarTraza() {
+    estadoTraza().origenNs = nsTraza();
+    banderaTraza() = true;
+    nombrarHiloTraza("principal");
+}
+
+static inline void registrarTramoTraza(const char* nombre, uint64_t inicioNs, uint64_t finNs, int primero = -1,
+                                       int ultimo = -1) {
+    BufferTraza& buffer = bufferTrazaDelHilo();
+    EventoTraza& evento = buffer.eventos[buffer.escritos % CAPACIDAD_TRAZA];
+    evento.nombre = nombre;
+    evento.primero = primero;
+    evento.ultimo = ultimo < 0 ? primero : ultimo;
+    evento.inicioNs = inicioNs;
+    evento.finNs = finNs;
+    ++buffer.escritos;
+}
+
+// Tramo del alcance: desde la construccion hasta el destructor
+class TramoTraza {
+public:
+    explicit TramoTraza(const char* nombreTramo, int primeroTramo = -1, int ultimoTramo = -1)
+        : nombre(nombreTramo), primero(primeroTramo), ultimo(ultimoTramo), inicio(trazaActiva() ? nsTraza() : 0) {}
+
+    ~TramoTraza() {
+        if (trazaActiva()) registrarTramoTraza(nombre, inicio, nsTraza(), primero, ultimo);
+    }
+
+private:
+    const char* nombre;
+    int primero;
+    int ultimo;
+    uint64_t inicio;
+
+    TramoTraza(const TramoTraza&);
+    TramoTraza& operator=(const TramoTraza&);
+};
+
+// Escribe todos los buffers como eventos completos ("ph": "X") con ts y
+// dur en microsegundos, mas el nombre de cada hilo. Llamar con los hilos
+// de trabajo parados u ociosos. Devuelve los eventos escritos; `perdidos`
+// cuenta los que se pisaron por buffer lleno.
+static inline size_t escribirTraza(const std::string& ruta, uint64_t& perdidos) {
+    std::ofstream out(ruta.c_str());
+    if (!out.is_open()) {
+        throw std::runtime_error("Cannot create file: " + ruta);
+    }
+    EstadoTraza& estado = estadoTraza();
+    std::lock_guard<std::mutex> lock(estado.cerrojo);
+    char linea[256];
+    size_t escritos = 0;
+    perdidos = 0;
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    for (size_t h = 0; h < estado.registro.size(); ++h) {
+        const BufferTraza& buffer = *estado.registro[h];
+        snprintf(linea, sizeof(linea),
+                 "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+                 h > 0 ? ",\n" : "", static_cast<unsigned>(h), buffer.nombreHilo.c_str());
+        out << linea;
+        uint64_t desde = buffer.escritos > CAPACIDAD_TRAZA ? buffer.escritos - CAPACIDAD_TRAZA : 0;
+        perdidos += desde;
+        for (uint64_t i = desde; i < buffer.escritos; ++i) {
+            const EventoTraza& e = buffer.eventos[i % CAPACIDAD_TRAZA];
+            double ts = static_cast<double>(e.inicioNs - estado.origenNs) / 1e3;
+            double dur = static_cast<double>(e.finNs - e.inicioNs) / 1e3;
+            if (e.primero < 0) {
+                snprintf(linea, sizeof(linea),
+                         ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                         e.nombre, static_cast<unsigned>(h), ts, dur);
+            } else if (e.ultimo == e.primero) {
+                snprintf(linea, sizeof(linea),
+                         ",\n{\"name\": \"%s %d\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, "
+                         "\"dur\": %.3f, \"args\": {\"archivo\": %d}}",
+                         e.nombre, e.primero, static_cast<unsigned>(h), ts, dur, e.primero);
+            } else {
+                snprintf(linea, sizeof(linea),
+                         ",\n{\"name\": \"%s %d-%d\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, "
+                         "\"dur\": %.3f, \"args\": {\"primero\": %d, \"ultimo\": %d}}",
+                         e.nombre, e.primero, e.ultimo, static_cast<unsigned>(h), ts, dur, e.primero, e.ultimo);
+            }
+            out << linea;
+            ++escritos;
+        }
+    }
+    out << "\n]}\n";
+    if (!out) {
+        throw std::runtime_error("Cannot write file: " + ruta);
+    }
+    return escritos;
+}
+
+#endif